@@ -0,0 +1,1037 @@
+// Benchmarks of the PyFR filters on synthetic data.
+//
+// Usage: pyfr_benchmark <benchmark> [-e elements per axis] [-n nodes per
+//                       edge] [-i isovalues] [-s steps] [-r repeats]
+//
+// Each benchmark builds a SyntheticCatalystData of high-order hexahedra and
+// times the filters on it with the device adapter the libraries were built
+// for. Run without arguments to list the benchmarks.
+
+#define BOOST_SP_DISABLE_THREADS
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <vtkm/cont/CellSetSingleType.h>
+#include <vtkm/cont/DeviceAdapterAlgorithm.h>
+#include <vtkm/cont/Timer.h>
+#include <vtkm/worklet/DispatcherMapField.h>
+#include <vtkm/worklet/DispatcherMapTopology.h>
+#include <vtkm/worklet/MarchingCubesDataTables.h>
+#include <vtkm/worklet/WorkletMapField.h>
+#include <vtkm/worklet/WorkletMapTopology.h>
+
+#include "PyFRDeviceAdapter.h"
+#include "IsosurfaceFunctors.h"
+#include "IsosurfaceHexahedra.h"
+#include "MarchingCubesTables.h"
+#include "PyFRContourData.h"
+#include "PyFRContourFilter.h"
+#include "PyFRCrinkleClipFilter.h"
+#include "PyFRData.h"
+#include "PyFRParallelSliceFilter.h"
+
+#include "SyntheticCatalystData.h"
+
+namespace
+{
+typedef vtkm::cont::Timer< ::PyFRDeviceAdapter> Timer;
+typedef vtkm::worklet::IsosurfaceFilterHexahedra<FPType, ::PyFRDeviceAdapter>
+  IsosurfaceFilter;
+typedef std::vector<vtkm::cont::ArrayHandle<vtkm::Vec<FPType,3> > >
+  Vec3HandleVec;
+typedef vtkm::cont::DynamicArrayHandleBase<PyFRData::FieldTypeList,
+  PyFRData::FieldStorageList> FieldArrayHandle;
+
+const int DENSITY = 0;
+
+struct Options
+{
+  Options() : ElementsPerAxis(24), NodesPerEdge(5), NumberOfIsovalues(1),
+              NumberOfSteps(10), NumberOfRepeats(5) {}
+
+  int ElementsPerAxis;
+  int NodesPerEdge;
+  int NumberOfIsovalues;
+  int NumberOfSteps;
+  int NumberOfRepeats;
+};
+
+// The process's peak resident set size, in megabytes
+double PeakResidentMegabytes()
+{
+  struct rusage usage;
+  getrusage(RUSAGE_SELF,&usage);
+#ifdef __APPLE__
+  return usage.ru_maxrss/(1024.*1024.);
+#else
+  return usage.ru_maxrss/1024.;
+#endif
+}
+
+#ifdef PYFR_DEVICE_ADAPTER_CUDA
+// The device memory in use by every process, which is sampled at each
+// step, since the device has no peak counter
+double DeviceUsedMegabytes()
+{
+  std::size_t freeBytes = 0;
+  std::size_t totalBytes = 0;
+  cudaMemGetInfo(&freeBytes,&totalBytes);
+  return (totalBytes - freeBytes)/(1024.*1024.);
+}
+#endif
+
+// Isovalues spread evenly over the range of the synthetic density
+std::vector<FPType> Isovalues(int n)
+{
+  std::vector<FPType> isovalues;
+  for (int i=0;i<n;i++)
+    isovalues.push_back(0.8 + 0.4*(i + 1)/(n + 1));
+  return isovalues;
+}
+
+FieldArrayHandle GetDensity(const PyFRData& data)
+{
+  return data.GetField(0,DENSITY).GetData()
+    .ResetTypeList(PyFRData::FieldTypeList())
+    .ResetStorageList(PyFRData::FieldStorageList());
+}
+
+// Contour the density of a data set with the marching cubes filter, repeats
+// times, and return the time spent in each phase per run
+template<typename CellSetType>
+vtkm::worklet::IsosurfaceTimings TimeIsosurface(const PyFRData& data,
+                                               const CellSetType& cellSet,
+                                               const Options& options)
+{
+  const std::vector<FPType> isovalues = Isovalues(options.NumberOfIsovalues);
+  Vec3HandleVec vertices;
+  Vec3HandleVec normals;
+  IsosurfaceFilter filter;
+  RunIsosurfaceFunctor<IsosurfaceFilter,CellSetType,Vec3HandleVec>
+    run(&filter,isovalues,cellSet,data.GetDataSet(0).GetCoordinateSystem(),
+        vertices,normals);
+
+  // The first run allocates the filter's arrays, and is not timed
+  GetDensity(data).CastAndCall(run);
+  filter.ResetTimings();
+  for (int r=0;r<options.NumberOfRepeats;r++)
+    GetDensity(data).CastAndCall(run);
+
+  vtkm::worklet::IsosurfaceTimings timings = filter.GetTimings();
+  timings.Classify /= options.NumberOfRepeats;
+  timings.Scan /= options.NumberOfRepeats;
+  timings.Generate /= options.NumberOfRepeats;
+  return timings;
+}
+
+// Run the contour filter as the pipeline does, returning the elapsed time and
+// adding the time spent in each marching cubes phase to timings
+double RunContourFilter(PyFRContourFilter& filter, PyFRData& data,
+                        PyFRContourData& output,
+                        vtkm::worklet::IsosurfaceTimings& timings)
+{
+  Timer timer;
+  filter(&data,&output);
+  const double seconds = timer.GetElapsedTime();
+  timings += filter.GetTimings();
+  return seconds;
+}
+
+void PrintTimings(const vtkm::worklet::IsosurfaceTimings& timings,
+                  double total)
+{
+  const double phases[3] =
+    { timings.Classify, timings.Scan, timings.Generate };
+  const char* names[3] = { "classify", "scan", "generate" };
+  for (int i=0;i<3;i++)
+    std::cout << "  " << std::left << std::setw(10) << names[i] << std::right
+              << std::fixed << std::setprecision(4) << phases[i] << " s ("
+              << std::setprecision(1)
+              << (total > 0. ? 100.*phases[i]/total : 0.) << "%)"
+              << std::endl;
+  const double other = total - phases[0] - phases[1] - phases[2];
+  std::cout << "  " << std::left << std::setw(10) << "other" << std::right
+            << std::setprecision(4) << other << " s (" << std::setprecision(1)
+            << (total > 0. ? 100.*other/total : 0.) << "%)" << std::endl;
+}
+
+// Counts the last-level cache misses of the calling thread, where the kernel
+// exposes the hardware counter (Linux only). Kernels run by other threads,
+// e.g. TBB's workers, are not counted: run the Serial build, or the whole
+// driver under "perf stat", to count them.
+class CacheMissCounter
+{
+public:
+  CacheMissCounter() : Descriptor(-1)
+  {
+#ifdef __linux__
+    struct perf_event_attr attr;
+    memset(&attr,0,sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    this->Descriptor = syscall(__NR_perf_event_open,&attr,0,-1,-1,0);
+#endif
+  }
+
+  ~CacheMissCounter()
+  {
+    if (this->Descriptor >= 0)
+      close(this->Descriptor);
+  }
+
+  bool IsAvailable() const { return this->Descriptor >= 0; }
+
+  void Start()
+  {
+#ifdef __linux__
+    if (this->Descriptor < 0)
+      return;
+    ioctl(this->Descriptor,PERF_EVENT_IOC_RESET,0);
+    ioctl(this->Descriptor,PERF_EVENT_IOC_ENABLE,0);
+#endif
+  }
+
+  long long Stop()
+  {
+    long long count = 0;
+#ifdef __linux__
+    if (this->Descriptor < 0)
+      return 0;
+    ioctl(this->Descriptor,PERF_EVENT_IOC_DISABLE,0);
+    if (read(this->Descriptor,&count,sizeof(count)) != sizeof(count))
+      count = 0;
+#endif
+    return count;
+  }
+
+private:
+  CacheMissCounter(const CacheMissCounter&); // Not implemented
+  void operator=(const CacheMissCounter&); // Not implemented
+
+  int Descriptor;
+};
+
+// Millions of cells processed per second
+double Throughput(vtkm::Id nCells, double seconds)
+{
+  return seconds > 0. ? nCells/seconds*1.e-6 : 0.;
+}
+
+// Run a functor in a child process, so that the peak memory it reports is
+// its own rather than the highest of the benchmark's runs
+template<typename Functor>
+void RunInChildProcess(const Functor& functor)
+{
+  std::cout.flush();
+  const pid_t pid = fork();
+  if (pid == 0)
+    {
+    functor();
+    std::cout.flush();
+    _exit(0);
+    }
+  int status;
+  waitpid(pid,&status,0);
+}
+
+//----------------------------------------------------------------------------
+// The peak memory of building the mesh, with its vertex and connectivity
+// arrays wrapped in place or copied
+struct BuildMesh
+{
+  BuildMesh(const Options& options, bool zeroCopy) : Opts(options),
+                                                     ZeroCopy(zeroCopy) {}
+
+  void operator()() const
+  {
+    SyntheticCatalystData synthetic(this->Opts.ElementsPerAxis,
+                                    this->Opts.NodesPerEdge);
+    const double before = PeakResidentMegabytes();
+#ifdef PYFR_DEVICE_ADAPTER_CUDA
+    const double deviceBefore = DeviceUsedMegabytes();
+#endif
+
+    Timer timer;
+    PyFRData data;
+    data.SetZeroCopyMesh(this->ZeroCopy);
+    data.Init(synthetic.GetCatalystData());
+    const double seconds = timer.GetElapsedTime();
+
+    std::cout << "  zero copy " << (this->ZeroCopy ? "on " : "off")
+              << ": peak RSS " << std::fixed << std::setprecision(1)
+              << PeakResidentMegabytes() << " MB, "
+              << PeakResidentMegabytes() - before << " MB above the solver's"
+              << " arrays; init " << std::setprecision(3) << seconds
+              << " s" << std::endl;
+
+#ifdef PYFR_DEVICE_ADAPTER_CUDA
+    // The wrapped host arrays are only transferred when first used, so
+    // contour once to bring the whole mesh onto the device
+    double deviceHighWater = DeviceUsedMegabytes();
+    PyFRContourFilter contour;
+    contour.SetContourField(DENSITY);
+    contour.AddContourValue(Isovalues(1)[0]);
+    PyFRContourData output;
+    contour(&data,&output);
+    deviceHighWater = std::max(deviceHighWater,DeviceUsedMegabytes());
+    std::cout << "    device high-water mark " << std::setprecision(1)
+              << deviceHighWater << " MB, " << deviceHighWater - deviceBefore
+              << " MB above the solver's arrays" << std::endl;
+#endif
+  }
+
+  const Options& Opts;
+  bool ZeroCopy;
+};
+
+int BenchmarkMesh(const Options& options)
+{
+  SyntheticCatalystData synthetic(options.ElementsPerAxis,
+                                  options.NodesPerEdge);
+  std::cout << "Mesh of " << synthetic.GetNumberOfElements() << " elements, "
+            << synthetic.GetNumberOfCells() << " cells and "
+            << synthetic.GetNumberOfPoints() << " points" << std::endl;
+#ifdef PYFR_DEVICE_ADAPTER_CUDA
+  std::cout << "  (the device's memory is sampled after the mesh is built"
+            << " and after contouring it once)" << std::endl;
+#endif
+  RunInChildProcess(BuildMesh(options,false));
+  RunInChildProcess(BuildMesh(options,true));
+  return 0;
+}
+
+//----------------------------------------------------------------------------
+// Classification and generation over the solver's 32-bit connectivity, as
+// PyFRData holds it, and over a 64-bit copy of it, as vtkm::Id connectivity
+// would be held
+int BenchmarkConnectivity(const Options& options)
+{
+  SyntheticCatalystData synthetic(options.ElementsPerAxis,
+                                  options.NodesPerEdge);
+  PyFRData data;
+  data.Init(synthetic.GetCatalystData());
+
+  PyFRData::CellSet narrowCellSet =
+    data.GetDataSet(0).GetCellSet().CastTo(PyFRData::CellSet());
+
+  const std::vector<vtkm::Int32>& connectivity = synthetic.GetConnectivity();
+  const std::vector<vtkm::Id> wideConnectivity(connectivity.begin(),
+                                               connectivity.end());
+  vtkm::cont::ArrayHandle<vtkm::Id> wideConnectivityHandle;
+  vtkm::cont::DeviceAdapterAlgorithm< ::PyFRDeviceAdapter>().Copy(
+    vtkm::cont::make_ArrayHandle(wideConnectivity),wideConnectivityHandle);
+  vtkm::cont::CellSetSingleType<> wideCellSet(vtkm::CellShapeTagHexahedron(),
+                                              "cells");
+  wideCellSet.Fill(wideConnectivityHandle);
+
+  const vtkm::Id nCells = synthetic.GetNumberOfCells();
+  std::cout << nCells << " cells, " << options.NumberOfIsovalues
+            << " isovalue(s)" << std::endl;
+  for (int wide=0;wide<2;wide++)
+    {
+    const vtkm::worklet::IsosurfaceTimings timings =
+      (wide ? TimeIsosurface(data,wideCellSet,options) :
+       TimeIsosurface(data,narrowCellSet,options));
+    const std::size_t bytes =
+      connectivity.size()*(wide ? sizeof(vtkm::Id) : sizeof(vtkm::Int32));
+    std::cout << "  " << (wide ? "64" : "32") << "-bit connectivity ("
+              << std::fixed << std::setprecision(1) << bytes/(1024.*1024.)
+              << " MB): classify " << std::setprecision(4) << timings.Classify
+              << " s (" << std::setprecision(1)
+              << Throughput(nCells,timings.Classify) << " Mcells/s), generate "
+              << std::setprecision(4) << timings.Generate << " s" << std::endl;
+    }
+  return 0;
+}
+
+//----------------------------------------------------------------------------
+// Contouring the density read in place from the solution, through the
+// implicit index arrays, and from a contiguous copy made on each update, for
+// a single isovalue and for several
+int BenchmarkFields(const Options& options)
+{
+  SyntheticCatalystData synthetic(options.ElementsPerAxis,
+                                  options.NodesPerEdge);
+  const vtkm::Id nCells = synthetic.GetNumberOfCells();
+  std::cout << nCells << " cells" << std::endl;
+
+  const int isovalueCounts[2] =
+    { 1, options.NumberOfIsovalues > 1 ? options.NumberOfIsovalues : 4 };
+  for (int materialize=0;materialize<2;materialize++)
+    {
+    PyFRData data;
+    data.SetMaterializeFields(materialize == 1);
+    data.Init(synthetic.GetCatalystData());
+    // Only the density is bound, so that the materialized runs copy the
+    // contoured field alone
+    data.SetRequestedFields(
+      std::vector<std::string>(1,data.GetFieldName(DENSITY)));
+
+    Timer timer;
+    for (int r=0;r<options.NumberOfRepeats;r++)
+      data.Update();
+    const double update = timer.GetElapsedTime()/options.NumberOfRepeats;
+
+    PyFRData::CellSet cellSet =
+      data.GetDataSet(0).GetCellSet().CastTo(PyFRData::CellSet());
+    for (int c=0;c<2;c++)
+      {
+      Options counted(options);
+      counted.NumberOfIsovalues = isovalueCounts[c];
+      const vtkm::worklet::IsosurfaceTimings timings =
+        TimeIsosurface(data,cellSet,counted);
+      const double contour =
+        timings.Classify + timings.Scan + timings.Generate;
+      std::cout << "  " << (materialize ? "materialized" : "implicit    ")
+                << " fields, " << isovalueCounts[c] << " isovalue(s): update "
+                << std::fixed << std::setprecision(4) << update
+                << " s, classify " << timings.Classify << " s ("
+                << std::setprecision(1) << Throughput(nCells,timings.Classify)
+                << " Mcells/s), contour " << std::setprecision(4) << contour
+                << " s, step " << update + contour << " s" << std::endl;
+      }
+    }
+  return 0;
+}
+
+//----------------------------------------------------------------------------
+// The time spent in each phase of the contour filter, per run, with the
+// remainder (gathering the triangle indices and appending cell types) as
+// "other"
+int BenchmarkPhases(const Options& options)
+{
+  SyntheticCatalystData synthetic(options.ElementsPerAxis,
+                                  options.NodesPerEdge);
+  PyFRData data;
+  data.Init(synthetic.GetCatalystData());
+
+  PyFRContourFilter filter;
+  filter.SetContourField(DENSITY);
+  const std::vector<FPType> isovalues = Isovalues(options.NumberOfIsovalues);
+  for (std::size_t i=0;i<isovalues.size();i++)
+    filter.AddContourValue(isovalues[i]);
+  PyFRContourData output;
+
+  vtkm::worklet::IsosurfaceTimings timings;
+  RunContourFilter(filter,data,output,timings);
+  timings = vtkm::worklet::IsosurfaceTimings();
+  double total = 0.;
+  for (int r=0;r<options.NumberOfRepeats;r++)
+    total += RunContourFilter(filter,data,output,timings);
+
+  timings.Classify /= options.NumberOfRepeats;
+  timings.Scan /= options.NumberOfRepeats;
+  timings.Generate /= options.NumberOfRepeats;
+  total /= options.NumberOfRepeats;
+  std::cout << synthetic.GetNumberOfCells() << " cells, "
+            << options.NumberOfIsovalues << " isovalue(s): "
+            << std::fixed << std::setprecision(4) << total << " s per run"
+            << std::endl;
+  PrintTimings(timings,total);
+  return 0;
+}
+
+//----------------------------------------------------------------------------
+// The marching cubes case of each cell
+class CellCase : public vtkm::worklet::WorkletMapPointToCell
+{
+public:
+  typedef void ControlSignature(FieldInFrom<Scalar> scalars,
+                                TopologyIn topology,
+                                FieldOut<IdType> caseNumber);
+  typedef void ExecutionSignature(_1, _3);
+  typedef _2 InputDomain;
+
+  FPType Isovalue;
+
+  VTKM_CONT_EXPORT
+  CellCase(FPType isovalue) : Isovalue(isovalue) {}
+
+  template<typename ScalarsVecType>
+  VTKM_EXEC_EXPORT
+  void operator()(const ScalarsVecType& scalars, vtkm::Id& caseNumber) const
+  {
+    FPType corners[8];
+    for (vtkm::IdComponent i = 0; i < 8; ++i)
+      corners[i] = static_cast<FPType>(scalars[i]);
+    caseNumber = vtkm::worklet::HexahedronCase(corners, this->Isovalue);
+  }
+};
+
+struct CellCaseFunctor
+{
+  CellCaseFunctor(FPType isovalue, const PyFRData::CellSet& cellSet,
+                  vtkm::cont::ArrayHandle<vtkm::Id>& cases) :
+    Isovalue(isovalue), CellSet(cellSet), Cases(cases) {}
+
+  template<typename StorageTag>
+  void operator()(const vtkm::cont::ArrayHandle<FPType,StorageTag>& field) const
+  {
+    vtkm::worklet::DispatcherMapTopology<CellCase, ::PyFRDeviceAdapter>(
+      CellCase(this->Isovalue)).Invoke(field,this->CellSet,this->Cases);
+  }
+
+  FPType Isovalue;
+  const PyFRData::CellSet& CellSet;
+  vtkm::cont::ArrayHandle<vtkm::Id>& Cases;
+};
+
+// The table reads of triangle generation, without the interpolation: each
+// cell looks up its triangle count and the edges of its triangles. The count
+// table holds vertices per case in VTK-m's tables and triangles in the byte
+// tables, hence VerticesPerTriangle.
+template<typename TablePortalType>
+class TriangleEdges : public vtkm::worklet::WorkletMapField
+{
+public:
+  typedef void ControlSignature(FieldIn<IdType> caseNumber,
+                                FieldOut<IdType> edgeSum);
+  typedef void ExecutionSignature(_1, _2);
+  typedef _1 InputDomain;
+
+  TablePortalType NumTrianglesTable;
+  TablePortalType TriangleTable;
+  vtkm::Id VerticesPerTriangle;
+
+  VTKM_CONT_EXPORT
+  TriangleEdges(TablePortalType numTrianglesTable,
+                TablePortalType triangleTable,
+                vtkm::Id verticesPerTriangle) :
+    NumTrianglesTable(numTrianglesTable),
+    TriangleTable(triangleTable),
+    VerticesPerTriangle(verticesPerTriangle) {}
+
+  VTKM_EXEC_EXPORT
+  void operator()(const vtkm::Id& caseNumber, vtkm::Id& edgeSum) const
+  {
+    const vtkm::Id nVertices = 3*(this->NumTrianglesTable.Get(caseNumber)/
+                                  this->VerticesPerTriangle);
+    edgeSum = 0;
+    for (vtkm::Id v = 0; v < nVertices; v++)
+      edgeSum += this->TriangleTable.Get(caseNumber*16 + v);
+  }
+};
+
+// The table reads of triangle generation with VTK-m's 64-bit tables, wrapped
+// and transferred to the device on every call as they were before
+// MarchingCubesTables, and with the byte tables kept on the device
+int BenchmarkTables(const Options& options)
+{
+  typedef ::PyFRDeviceAdapter DeviceAdapter;
+  typedef vtkm::cont::ArrayHandle<vtkm::Id> IdHandle;
+  typedef IdHandle::ExecutionTypes<DeviceAdapter>::PortalConst IdPortalType;
+  typedef vtkm::worklet::MarchingCubesTables<DeviceAdapter> ByteTables;
+
+  SyntheticCatalystData synthetic(options.ElementsPerAxis,
+                                  options.NodesPerEdge);
+  PyFRData data;
+  data.Init(synthetic.GetCatalystData());
+  PyFRData::CellSet cellSet =
+    data.GetDataSet(0).GetCellSet().CastTo(PyFRData::CellSet());
+
+  IdHandle cases;
+  GetDensity(data).CastAndCall(CellCaseFunctor(FPType(1.),cellSet,cases));
+  const vtkm::Id nCells = cases.GetNumberOfValues();
+
+  // The byte tables' first use, which transfers them, is not timed
+  ByteTables::Get().GetTriangleTable();
+
+  IdHandle edgeSums;
+  double seconds[2] = { 0., 0. };
+  for (int r=0;r<options.NumberOfRepeats;r++)
+    {
+    Timer timer;
+    IdHandle numVerticesTable =
+      vtkm::cont::make_ArrayHandle(vtkm::worklet::internal::numVerticesTable,
+                                   256);
+    IdHandle triangleTable =
+      vtkm::cont::make_ArrayHandle(vtkm::worklet::internal::triTable,256*16);
+    vtkm::worklet::DispatcherMapField<TriangleEdges<IdPortalType>,
+      DeviceAdapter>(TriangleEdges<IdPortalType>(
+        numVerticesTable.PrepareForInput(DeviceAdapter()),
+        triangleTable.PrepareForInput(DeviceAdapter()),3))
+      .Invoke(cases,edgeSums);
+    seconds[0] += timer.GetElapsedTime();
+
+    timer.Reset();
+    ByteTables& tables = ByteTables::Get();
+    vtkm::worklet::DispatcherMapField<TriangleEdges<ByteTables::PortalType>,
+      DeviceAdapter>(TriangleEdges<ByteTables::PortalType>(
+        tables.GetNumTrianglesTable(),tables.GetTriangleTable(),1))
+      .Invoke(cases,edgeSums);
+    seconds[1] += timer.GetElapsedTime();
+    }
+
+  std::cout << nCells << " cells" << std::endl;
+  const char* names[2] = { "64-bit tables, uploaded per call",
+                           "byte tables, kept on the device" };
+  for (int i=0;i<2;i++)
+    {
+    const double perRun = seconds[i]/options.NumberOfRepeats;
+    std::cout << "  " << names[i] << ": " << std::fixed
+              << std::setprecision(5) << perRun << " s ("
+              << std::setprecision(1) << Throughput(nCells,perRun)
+              << " Mcells/s)" << std::endl;
+    }
+  return 0;
+}
+
+//----------------------------------------------------------------------------
+// The triangle counts of each cell for a batch of NumberOfIsovalues, with a
+// thread per cell and in tiles of cells, without and with a clip plane
+template<vtkm::IdComponent NumberOfIsovalues>
+struct ClassifyFunctor
+{
+  typedef vtkm::worklet::internal::IsosurfaceFilterHexahedra<FPType,
+    ::PyFRDeviceAdapter,NumberOfIsovalues> Filter;
+  typedef vtkm::cont::ArrayHandle<vtkm::Vec<vtkm::Id,NumberOfIsovalues> >
+    CountHandle;
+
+  ClassifyFunctor(const Options& options,
+                  const PyFRData::CellSet& cellSet,
+                  const vtkm::cont::CoordinateSystem& coords,
+                  const vtkm::worklet::IsosurfaceClipPlane<FPType>& clipPlane,
+                  double* seconds,
+                  bool& tiled,
+                  bool& same) : Opts(options), CellSet(cellSet),
+                                Coords(coords), ClipPlane(clipPlane),
+                                Seconds(seconds), Tiled(tiled), Same(same) {}
+
+  template<typename StorageTag>
+  void operator()(const vtkm::cont::ArrayHandle<FPType,StorageTag>& field) const
+  {
+    const std::vector<FPType> isovalues = Isovalues(NumberOfIsovalues);
+
+    CountHandle counts[2];
+    this->Seconds[0] = this->Seconds[1] = 0.;
+    // The first run of each, which transfers the tables, is not timed
+    for (int r=0;r<=this->Opts.NumberOfRepeats;r++)
+      {
+      Timer timer;
+      Filter::CountTrianglesPerCell(isovalues,this->CellSet,this->Coords,
+                                    field,this->ClipPlane,counts[0]);
+      if (r > 0)
+        this->Seconds[0] += timer.GetElapsedTime();
+
+      timer.Reset();
+      this->Tiled = Filter::CountTrianglesTiled(isovalues,this->CellSet,
+                                                this->Coords,field,
+                                                this->ClipPlane,counts[1]);
+      if (r > 0)
+        this->Seconds[1] += timer.GetElapsedTime();
+      }
+    this->Seconds[0] /= this->Opts.NumberOfRepeats;
+    this->Seconds[1] /= this->Opts.NumberOfRepeats;
+
+    this->Same = true;
+    if (!this->Tiled)
+      return;
+    typename CountHandle::PortalConstControl perCell =
+      counts[0].GetPortalConstControl();
+    typename CountHandle::PortalConstControl tiles =
+      counts[1].GetPortalConstControl();
+    this->Same = (perCell.GetNumberOfValues() == tiles.GetNumberOfValues());
+    for (vtkm::Id i=0;this->Same && i<perCell.GetNumberOfValues();i++)
+      this->Same = (perCell.Get(i) == tiles.Get(i));
+  }
+
+  const Options& Opts;
+  const PyFRData::CellSet& CellSet;
+  const vtkm::cont::CoordinateSystem& Coords;
+  const vtkm::worklet::IsosurfaceClipPlane<FPType>& ClipPlane;
+  double* Seconds;
+  bool& Tiled;
+  bool& Same;
+};
+
+// Cell classification with a thread per cell and in tiles of cells, for
+// batches of one and six isovalues, without and with a clip plane through
+// the middle of the mesh (as when the clip is deferred to the contour
+// filter). The tiles are only used on the CPU adapters, and are compared
+// against the per cell counts.
+int BenchmarkClassify(const Options& options)
+{
+  SyntheticCatalystData synthetic(options.ElementsPerAxis,
+                                  options.NodesPerEdge);
+  PyFRData data;
+  data.Init(synthetic.GetCatalystData());
+  PyFRData::CellSet cellSet =
+    data.GetDataSet(0).GetCellSet().CastTo(PyFRData::CellSet());
+  const vtkm::cont::CoordinateSystem& coords =
+    data.GetDataSet(0).GetCoordinateSystem();
+  const vtkm::Id nCells = synthetic.GetNumberOfCells();
+
+  std::cout << nCells << " cells, tiles of "
+            << vtkm::worklet::HexahedronTileSize << " cells";
+#ifdef PYFR_SIMD_CLASSIFY
+  std::cout << " with wide compares";
+#endif
+  std::cout << std::endl;
+
+  for (int clip=0;clip<2;clip++)
+    {
+    vtkm::worklet::IsosurfaceClipPlane<FPType> clipPlane;
+    if (clip == 1)
+      {
+      clipPlane.Enabled = true;
+      clipPlane.Origin =
+        vtkm::Vec<FPType,3>(FPType(0.5*options.ElementsPerAxis),0.,0.);
+      clipPlane.Normal = vtkm::Vec<FPType,3>(1.,0.,0.);
+      }
+    std::cout << "  " << (clip == 1 ? "clip plane:" : "no clip plane:")
+              << std::endl;
+
+    for (int batch=0;batch<2;batch++)
+      {
+      const int nIsovalues = (batch == 0 ? 1 : 6);
+      double seconds[2];
+      bool tiled = false;
+      bool same = false;
+      if (nIsovalues == 1)
+        GetDensity(data).CastAndCall(
+          ClassifyFunctor<1>(options,cellSet,coords,clipPlane,seconds,tiled,
+                             same));
+      else
+        GetDensity(data).CastAndCall(
+          ClassifyFunctor<6>(options,cellSet,coords,clipPlane,seconds,tiled,
+                             same));
+
+      std::cout << "    " << nIsovalues << " isovalue(s): per cell "
+                << std::fixed << std::setprecision(5) << seconds[0] << " s ("
+                << std::setprecision(1) << Throughput(nCells,seconds[0])
+                << " Mcells/s)";
+      if (tiled)
+        std::cout << ", tiled " << std::setprecision(5) << seconds[1]
+                  << " s (" << std::setprecision(1)
+                  << Throughput(nCells,seconds[1]) << " Mcells/s), "
+                  << std::setprecision(2)
+                  << (seconds[1] > 0. ? seconds[0]/seconds[1] : 0.) << "x"
+                  << (same ? "" : ", COUNTS DIFFER");
+      else
+        std::cout << ", tiles are not used on this device adapter";
+      std::cout << std::endl;
+      }
+    }
+  return 0;
+}
+
+//----------------------------------------------------------------------------
+// Run a filter repeats times after an untimed first run, reporting the time
+// and cache misses per run
+template<typename Filter>
+void TimeFilter(const char* name, Filter& filter, PyFRData& data,
+                const Options& options, vtkm::Id nCells)
+{
+  PyFRContourData output;
+  filter(&data,&output);
+
+  CacheMissCounter counter;
+  counter.Start();
+  Timer timer;
+  for (int r=0;r<options.NumberOfRepeats;r++)
+    filter(&data,&output);
+  const double seconds = timer.GetElapsedTime()/options.NumberOfRepeats;
+  const long long misses = counter.Stop()/options.NumberOfRepeats;
+
+  std::cout << "    " << std::left << std::setw(8) << name << std::right
+            << std::fixed << std::setprecision(4) << seconds << " s ("
+            << std::setprecision(1) << Throughput(nCells,seconds)
+            << " Mcells/s)";
+  if (counter.IsAvailable())
+    std::cout << ", " << misses << " cache misses";
+  std::cout << std::endl;
+}
+
+// Contouring and slicing a mesh whose elements are stored in a random
+// order, as a partitioned mesh's are, with ReorderCells off and on
+int BenchmarkReorder(const Options& options)
+{
+  SyntheticCatalystData synthetic(options.ElementsPerAxis,
+                                  options.NodesPerEdge,true);
+  const vtkm::Id nCells = synthetic.GetNumberOfCells();
+  std::cout << nCells << " cells in shuffled elements, "
+            << options.NumberOfIsovalues << " isovalue(s) and plane(s)"
+            << std::endl;
+#ifdef PYFR_DEVICE_ADAPTER_CUDA
+  std::cout << "  (the cache misses are the host's, not the device's)"
+            << std::endl;
+#endif
+  if (!CacheMissCounter().IsAvailable())
+    std::cout << "  (cache miss counter unavailable)" << std::endl;
+
+  const std::vector<FPType> isovalues = Isovalues(options.NumberOfIsovalues);
+  for (int reorder=0;reorder<2;reorder++)
+    {
+    PyFRData data;
+    data.SetReorderCells(reorder == 1);
+    Timer timer;
+    data.Init(synthetic.GetCatalystData());
+    std::cout << "  reorder " << (reorder ? "on" : "off") << ": init "
+              << std::fixed << std::setprecision(4) << timer.GetElapsedTime()
+              << " s" << std::endl;
+
+    PyFRContourFilter contour;
+    contour.SetContourField(DENSITY);
+    for (std::size_t i=0;i<isovalues.size();i++)
+      contour.AddContourValue(isovalues[i]);
+    TimeFilter("contour",contour,data,options,nCells);
+
+    // Planes through the cube's diagonal, spread along it
+    const FPType centre = FPType(0.5)*options.ElementsPerAxis;
+    PyFRParallelSliceFilter slice;
+    slice.SetPlane(centre,centre,centre,1.,1.,1.);
+    slice.SetNumberOfPlanes(options.NumberOfIsovalues);
+    slice.SetSpacing(FPType(options.ElementsPerAxis)/
+                     (options.NumberOfIsovalues + 1));
+    TimeFilter("slice",slice,data,options,nCells);
+    }
+  return 0;
+}
+
+//----------------------------------------------------------------------------
+// Flying edges against marching cubes, with and without merged points (which
+// flying edges always produces), for 1, 2, 4, ... isovalues up to -i (at least
+// 8). The first flying edges run, which builds the edge topology, is reported
+// separately.
+int BenchmarkFlyingEdges(const Options& options)
+{
+  SyntheticCatalystData synthetic(options.ElementsPerAxis,
+                                  options.NodesPerEdge);
+  PyFRData data;
+  data.Init(synthetic.GetCatalystData());
+  const vtkm::Id nCells = synthetic.GetNumberOfCells();
+  std::cout << nCells << " cells" << std::endl;
+
+  const int maxIsovalues = std::max(options.NumberOfIsovalues,8);
+  const char* names[3] = { "marching cubes", "merged marching cubes",
+                           "flying edges" };
+  for (int n=1;n<=maxIsovalues;n*=2)
+    {
+    std::cout << "  " << n << " isovalue(s):" << std::endl;
+    const std::vector<FPType> isovalues = Isovalues(n);
+    for (int method=0;method<3;method++)
+      {
+      PyFRContourFilter filter;
+      filter.SetContourField(DENSITY);
+      for (std::size_t i=0;i<isovalues.size();i++)
+        filter.AddContourValue(isovalues[i]);
+      filter.SetMergeDuplicatePoints(method == 1);
+      filter.SetUseFlyingEdges(method == 2);
+
+      PyFRContourData output;
+      Timer timer;
+      filter(&data,&output);
+      const double first = timer.GetElapsedTime();
+      timer.Reset();
+      for (int r=0;r<options.NumberOfRepeats;r++)
+        filter(&data,&output);
+      const double seconds = timer.GetElapsedTime()/options.NumberOfRepeats;
+
+      std::cout << "    " << std::left << std::setw(22) << names[method]
+                << std::right << std::fixed << std::setprecision(4)
+                << seconds << " s (" << std::setprecision(1)
+                << Throughput(nCells,seconds) << " Mcells/s)";
+      if (method == 2)
+        std::cout << ", first run " << std::setprecision(4) << first << " s";
+      std::cout << std::endl;
+      }
+    }
+  return 0;
+}
+
+//----------------------------------------------------------------------------
+// The contour filter's time per step with TemporalCoherence off and on, as
+// the density wave advances a fiftieth of an element per step. The clip is
+// deferred to the filter, as in the pipeline, by a plane beyond the mesh that
+// keeps every cell, so that only the elements whose points crossed an
+// isovalue are classified again.
+int BenchmarkCoherence(const Options& options)
+{
+  const double timeStep = 0.02;
+  const char* pipelines[2] = { "deferred clip", "upstream clip" };
+
+  SyntheticCatalystData synthetic(options.ElementsPerAxis,
+                                  options.NodesPerEdge);
+  PyFRData data;
+  data.Init(synthetic.GetCatalystData());
+
+  // Clip away half of the mesh, either in the contour filter's own
+  // classification pass or as a cell set permutation ahead of it
+  PyFRCrinkleClipFilter clips[2];
+  PyFRData clipped[2];
+  for (int p=0;p<2;p++)
+    {
+    clips[p].SetPlane(FPType(options.ElementsPerAxis)/2,0.,0.,1.,0.,0.);
+    clips[p].SetDeferred(p == 0);
+    }
+
+  const std::vector<FPType> isovalues = Isovalues(options.NumberOfIsovalues);
+  PyFRContourFilter filters[2][2];
+  for (int p=0;p<2;p++)
+    for (int coherence=0;coherence<2;coherence++)
+      {
+      filters[p][coherence].SetContourField(DENSITY);
+      for (std::size_t i=0;i<isovalues.size();i++)
+        filters[p][coherence].AddContourValue(isovalues[i]);
+      filters[p][coherence].SetTemporalCoherence(coherence == 1);
+      }
+  PyFRContourData outputs[2][2];
+
+  std::cout << synthetic.GetNumberOfCells() << " cells, "
+            << options.NumberOfIsovalues << " isovalue(s)" << std::endl;
+  double totals[2][2] = { { 0., 0. }, { 0., 0. } };
+  for (int step=0;step<options.NumberOfSteps;step++)
+    {
+    synthetic.SetTime(step*timeStep);
+    data.Update();
+
+    for (int p=0;p<2;p++)
+      {
+      // Only the first step clips the mesh; the others forward the solution
+      if (step == 0)
+        clips[p](&data,&clipped[p]);
+      else
+        clips[p].MapFields(&data,&clipped[p]);
+
+      double seconds[2];
+      for (int coherence=0;coherence<2;coherence++)
+        {
+        vtkm::worklet::IsosurfaceTimings timings;
+        seconds[coherence] = RunContourFilter(filters[p][coherence],
+                                              clipped[p],
+                                              outputs[p][coherence],timings);
+        }
+      // The first step classifies every cell either way
+      if (step > 0)
+        {
+        totals[p][0] += seconds[0];
+        totals[p][1] += seconds[1];
+        }
+      std::cout << "  " << std::left << std::setw(14) << pipelines[p]
+                << std::right << " step " << std::setw(4) << step
+                << std::fixed << std::setprecision(4) << "  off "
+                << seconds[0] << " s  on " << seconds[1] << " s  "
+                << std::setprecision(2)
+                << (seconds[1] > 0. ? seconds[0]/seconds[1] : 0.) << "x"
+                << std::endl;
+      }
+    }
+  if (options.NumberOfSteps > 1)
+    for (int p=0;p<2;p++)
+      std::cout << "  " << pipelines[p]
+                << " mean speedup after the first step: " << std::fixed
+                << std::setprecision(2)
+                << (totals[p][1] > 0. ? totals[p][0]/totals[p][1] : 0.)
+                << "x" << std::endl;
+  return 0;
+}
+
+//----------------------------------------------------------------------------
+typedef int (*BenchmarkFunction)(const Options&);
+
+struct Benchmark
+{
+  const char* Name;
+  BenchmarkFunction Function;
+  const char* Description;
+};
+
+const Benchmark benchmarks[] =
+{
+  { "mesh", BenchmarkMesh,
+    "peak host and device memory of the mesh, with ZeroCopyMesh off and on" },
+  { "connectivity", BenchmarkConnectivity,
+    "contour throughput with 32-bit and 64-bit connectivity" },
+  { "fields", BenchmarkFields,
+    "contour and update times with implicit and materialized fields" },
+  { "phases", BenchmarkPhases,
+    "time spent in each phase of the contour filter" },
+  { "tables", BenchmarkTables,
+    "triangle table reads with 64-bit per-call and byte resident tables" },
+  { "classify", BenchmarkClassify,
+    "cell classification with a thread per cell and in tiles of cells" },
+  { "reorder", BenchmarkReorder,
+    "contour and slice time and cache misses with ReorderCells off and on" },
+  { "flyingedges", BenchmarkFlyingEdges,
+    "flying edges against marching cubes over isovalue counts" },
+  { "coherence", BenchmarkCoherence,
+    "clipped contour time per step with TemporalCoherence off and on" },
+};
+const int numberOfBenchmarks = sizeof(benchmarks)/sizeof(benchmarks[0]);
+
+void PrintUsage(const char* program)
+{
+  std::cout << "Usage: " << program << " <benchmark> [-e elements per axis]"
+            << " [-n nodes per edge] [-i isovalues] [-s steps]"
+            << " [-r repeats]" << std::endl << std::endl
+            << "Benchmarks:" << std::endl;
+  for (int i=0;i<numberOfBenchmarks;i++)
+    std::cout << "  " << std::left << std::setw(14) << benchmarks[i].Name
+              << benchmarks[i].Description << std::endl;
+}
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  if (argc < 2)
+    {
+    PrintUsage(argv[0]);
+    return 1;
+    }
+
+  Options options;
+  for (int i=2;i + 1<argc;i+=2)
+    {
+    const int value = atoi(argv[i + 1]);
+    if (strcmp(argv[i],"-e") == 0)
+      options.ElementsPerAxis = value;
+    else if (strcmp(argv[i],"-n") == 0)
+      options.NodesPerEdge = value;
+    else if (strcmp(argv[i],"-i") == 0)
+      options.NumberOfIsovalues = value;
+    else if (strcmp(argv[i],"-s") == 0)
+      options.NumberOfSteps = value;
+    else if (strcmp(argv[i],"-r") == 0)
+      options.NumberOfRepeats = value;
+    else
+      {
+      PrintUsage(argv[0]);
+      return 1;
+      }
+    }
+  if (options.ElementsPerAxis < 1 || options.NodesPerEdge < 2 ||
+      options.NumberOfIsovalues < 1 || options.NumberOfSteps < 1 ||
+      options.NumberOfRepeats < 1)
+    {
+    std::cerr << "Every option must be positive, with at least two nodes per"
+              << " edge" << std::endl;
+    return 1;
+    }
+
+  for (int i=0;i<numberOfBenchmarks;i++)
+    if (strcmp(argv[1],benchmarks[i].Name) == 0)
+      return benchmarks[i].Function(options);
+
+  PrintUsage(argv[0]);
+  return 1;
+}
@@ -0,0 +1,185 @@
+#ifndef SYNTHETICCATALYSTDATA_H
+#define SYNTHETICCATALYSTDATA_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+#include "CatalystData.h"
+
+/// \brief A CatalystData of high-order hexahedra with an analytic solution,
+/// for benchmarking the filters without a solver
+///
+/// The elements tile a cube of elementsPerAxis^3 unit cells, each with
+/// nodesPerEdge^3 nodes that it does not share with its neighbours, and are
+/// subdivided into (nodesPerEdge - 1)^3 linear hexahedra, as PyFR passes
+/// them. The solution is laid out as PyFR's, [node][variable][element] with
+/// the element dimension padded, and holds a density wave that travels with
+/// time, so that successive steps move the isosurfaces slightly. Density
+/// ranges over [0.8, 1.2].
+class SyntheticCatalystData
+{
+public:
+  SyntheticCatalystData(int elementsPerAxis, int nodesPerEdge,
+                        bool shuffle = false) :
+    ElementsPerAxis(elementsPerAxis),
+    NodesPerEdge(nodesPerEdge),
+    NumberOfElements(elementsPerAxis*elementsPerAxis*elementsPerAxis),
+    NodesPerElement(nodesPerEdge*nodesPerEdge*nodesPerEdge),
+    CellsPerElement((nodesPerEdge - 1)*(nodesPerEdge - 1)*(nodesPerEdge - 1)),
+    DeviceSolution(NULL)
+  {
+    // The order in which the elements are stored. A partitioned mesh's
+    // elements are not in any spatial order, which shuffling imitates.
+    std::vector<int> position(this->NumberOfElements);
+    for (int e=0;e<this->NumberOfElements;e++)
+      position[e] = e;
+    if (shuffle)
+      {
+      srand(0);
+      for (int e=this->NumberOfElements - 1;e>0;e--)
+        std::swap(position[e],position[rand() % (e + 1)]);
+      }
+
+    const int n = nodesPerEdge;
+    this->Vertices.resize(3*this->NumberOfElements*this->NodesPerElement);
+    for (int e=0;e<this->NumberOfElements;e++)
+      {
+      const int ex = position[e] % elementsPerAxis;
+      const int ey = (position[e]/elementsPerAxis) % elementsPerAxis;
+      const int ez = position[e]/(elementsPerAxis*elementsPerAxis);
+      for (int k=0;k<n;k++)
+        for (int j=0;j<n;j++)
+          for (int i=0;i<n;i++)
+            {
+            SolverFPType* vertex =
+              &this->Vertices[3*(e*this->NodesPerElement + i + j*n + k*n*n)];
+            vertex[0] = ex + i/SolverFPType(n - 1);
+            vertex[1] = ey + j/SolverFPType(n - 1);
+            vertex[2] = ez + k/SolverFPType(n - 1);
+            }
+      }
+
+    // Subdivide each element into linear hexahedra, with the corner ordering
+    // of PyFRData's own subdivision
+    static const int corner[8][3] = { {0,0,0}, {1,0,0}, {1,1,0}, {0,1,0},
+                                      {0,0,1}, {1,0,1}, {1,1,1}, {0,1,1} };
+    const int nSubdividedCells = this->NumberOfElements*this->CellsPerElement;
+    this->Connectivity.resize(8*nSubdividedCells);
+    this->Offsets.resize(nSubdividedCells);
+    this->Types.assign(nSubdividedCells,12);
+    int counter = 0;
+    for (int e=0;e<this->NumberOfElements;e++)
+      for (int k=0;k<n - 1;k++)
+        for (int j=0;j<n - 1;j++)
+          for (int i=0;i<n - 1;i++)
+            {
+            this->Offsets[counter/8] = counter;
+            for (int c=0;c<8;c++)
+              this->Connectivity[counter++] =
+                e*this->NodesPerElement + (i + corner[c][0]) +
+                (j + corner[c][1])*n + (k + corner[c][2])*n*n;
+            }
+
+    this->Mesh.nVerticesPerCell = this->NodesPerElement;
+    this->Mesh.nCells = this->NumberOfElements;
+    this->Mesh.vertices = &this->Vertices[0];
+    this->Mesh.nSubdividedCells = nSubdividedCells;
+    this->Mesh.con = &this->Connectivity[0];
+    this->Mesh.off = &this->Offsets[0];
+    this->Mesh.type = &this->Types[0];
+
+    // Pad the element dimension, as PyFR aligns it
+    this->Solution.lsdim = (this->NumberOfElements + 31)/32*32;
+    this->Solution.ldim = 5*this->Solution.lsdim;
+    this->Solution.nvars = 5;
+    this->SolutionData.resize(this->Solution.ldim*this->NodesPerElement);
+#ifdef PYFR_DEVICE_ADAPTER_CUDA
+    cudaMalloc(&this->DeviceSolution,
+               this->SolutionData.size()*sizeof(SolverFPType));
+    this->Solution.solution = this->DeviceSolution;
+#else
+    this->Solution.solution = &this->SolutionData[0];
+#endif
+    this->SetTime(0.);
+
+    this->Data.nCellTypes = 1;
+    this->Data.meshData = &this->Mesh;
+    this->Data.solutionData = &this->Solution;
+  }
+
+  ~SyntheticCatalystData()
+  {
+#ifdef PYFR_DEVICE_ADAPTER_CUDA
+    cudaFree(this->DeviceSolution);
+#endif
+  }
+
+  /// Fill the solution at time t, at which the density wave has travelled t
+  /// elements along x
+  void SetTime(double t)
+  {
+    const double pi = 3.14159265358979323846;
+    const double gamma = 1.4;
+    const double k = 2.*pi/this->ElementsPerAxis;
+    for (int e=0;e<this->NumberOfElements;e++)
+      for (int v=0;v<this->NodesPerElement;v++)
+        {
+        const SolverFPType* vertex =
+          &this->Vertices[3*(e*this->NodesPerElement + v)];
+        const double rho = 1. + 0.2*std::sin(k*(vertex[0] - t))*
+          std::cos(k*vertex[1])*std::cos(k*vertex[2]);
+        const double u[3] = { 1., 0.5*std::sin(k*vertex[2]), 0.25 };
+        const double p = 1. + 0.1*std::cos(k*(vertex[0] + vertex[1] - t));
+        const double energy = p/(gamma - 1.) +
+          0.5*rho*(u[0]*u[0] + u[1]*u[1] + u[2]*u[2]);
+
+        SolverFPType* node =
+          &this->SolutionData[v*this->Solution.ldim + e];
+        node[0] = rho;
+        node[this->Solution.lsdim] = rho*u[0];
+        node[2*this->Solution.lsdim] = rho*u[1];
+        node[3*this->Solution.lsdim] = rho*u[2];
+        node[4*this->Solution.lsdim] = energy;
+        }
+#ifdef PYFR_DEVICE_ADAPTER_CUDA
+    cudaMemcpy(this->DeviceSolution,&this->SolutionData[0],
+               this->SolutionData.size()*sizeof(SolverFPType),
+               cudaMemcpyHostToDevice);
+#endif
+  }
+
+  CatalystData* GetCatalystData() { return &this->Data; }
+
+  int GetNumberOfElements() const { return this->NumberOfElements; }
+  int GetNumberOfCells() const
+  { return this->NumberOfElements*this->CellsPerElement; }
+  int GetNumberOfPoints() const
+  { return this->NumberOfElements*this->NodesPerElement; }
+  const std::vector<int32_t>& GetConnectivity() const
+  { return this->Connectivity; }
+
+private:
+  SyntheticCatalystData(const SyntheticCatalystData&); // Not implemented
+  void operator=(const SyntheticCatalystData&); // Not implemented
+
+  int ElementsPerAxis;
+  int NodesPerEdge;
+  int NumberOfElements;
+  int NodesPerElement;
+  int CellsPerElement;
+
+  std::vector<SolverFPType> Vertices;
+  std::vector<int32_t> Connectivity;
+  std::vector<int32_t> Offsets;
+  std::vector<uint8_t> Types;
+  std::vector<SolverFPType> SolutionData;
+  void* DeviceSolution;
+
+  MeshDataForCellType Mesh;
+  SolutionDataForCellType Solution;
+  CatalystData Data;
+};
+
+#endif
@@ -0,0 +1,152 @@
+#ifndef APPENDARRAYS_H
+#define APPENDARRAYS_H
+
+#define BOOST_SP_DISABLE_THREADS
+
+#include <vector>
+
+#include <vtkm/cont/ArrayHandle.h>
+#include <vtkm/cont/DeviceAdapter.h>
+#include <vtkm/worklet/DispatcherMapField.h>
+#include <vtkm/worklet/WorkletMapField.h>
+
+namespace vtkm {
+namespace worklet {
+
+/// \brief Concatenate a set of arrays into a single output array
+///
+/// Used to gather the per-cell-type outputs of the contour and slice filters
+/// into the single array per contour that the rest of the pipeline expects.
+template <typename DeviceAdapter>
+class AppendArrays
+{
+public:
+  template <typename ValueType, typename PortalType>
+  class CopyWithOffset : public vtkm::worklet::WorkletMapField
+  {
+  public:
+    typedef void ControlSignature(FieldIn<vtkm::ListTagBase<ValueType> > in);
+    typedef void ExecutionSignature(_1, WorkIndex);
+    typedef _1 InputDomain;
+
+    PortalType Output;
+    vtkm::Id Offset;
+
+    VTKM_CONT_EXPORT
+    CopyWithOffset(PortalType output, vtkm::Id offset) : Output(output),
+                                                         Offset(offset) {}
+
+    VTKM_EXEC_EXPORT
+    void operator()(const ValueType& value, vtkm::Id index) const
+    {
+      this->Output.Set(this->Offset + index, value);
+    }
+  };
+
+  template <typename PortalType>
+  class CopyIndicesWithOffset : public vtkm::worklet::WorkletMapField
+  {
+  public:
+    typedef void ControlSignature(FieldIn<IdType> in);
+    typedef void ExecutionSignature(_1, WorkIndex);
+    typedef _1 InputDomain;
+
+    typedef typename PortalType::ValueType ValueType;
+
+    PortalType Output;
+    vtkm::Id Offset;
+    vtkm::Id IndexOffset;
+
+    VTKM_CONT_EXPORT
+    CopyIndicesWithOffset(PortalType output,
+                          vtkm::Id offset,
+                          vtkm::Id indexOffset) : Output(output),
+                                                  Offset(offset),
+                                                  IndexOffset(indexOffset) {}
+
+    VTKM_EXEC_EXPORT
+    void operator()(const vtkm::Id& value, vtkm::Id index) const
+    {
+      this->Output.Set(this->Offset + index,
+                       static_cast<ValueType>(this->IndexOffset + value));
+    }
+  };
+
+  template<typename ArrayHandleIn, typename ArrayHandleOut>
+  void Run(const std::vector<ArrayHandleIn>& input,
+           ArrayHandleOut& output) const
+  {
+    typedef typename ArrayHandleOut::ValueType ValueType;
+    typedef typename ArrayHandleOut::template ExecutionTypes<DeviceAdapter>
+      ::Portal PortalType;
+    typedef CopyWithOffset<ValueType,PortalType> CopyWorklet;
+
+    vtkm::Id numberOfValues = 0;
+    for (std::size_t i=0;i<input.size();i++)
+      numberOfValues += input[i].GetNumberOfValues();
+
+    if (numberOfValues == 0)
+      {
+      output.Shrink(0);
+      return;
+      }
+
+    PortalType portal = output.PrepareForOutput(numberOfValues,
+                                                DeviceAdapter());
+
+    vtkm::Id offset = 0;
+    for (std::size_t i=0;i<input.size();i++)
+      {
+      if (input[i].GetNumberOfValues() == 0)
+        continue;
+
+      CopyWorklet copy(portal,offset);
+      vtkm::worklet::DispatcherMapField<CopyWorklet,
+        DeviceAdapter>(copy).Invoke(input[i]);
+      offset += input[i].GetNumberOfValues();
+      }
+  }
+
+  /// Concatenate arrays of indices, shifting each input's indices by the
+  /// matching entry of indexOffsets (the number of values preceding the
+  /// array they index into once that array is appended as well)
+  template<typename ArrayHandleIn, typename ArrayHandleOut>
+  void RunIndices(const std::vector<ArrayHandleIn>& input,
+                  const std::vector<vtkm::Id>& indexOffsets,
+                  ArrayHandleOut& output) const
+  {
+    typedef typename ArrayHandleOut::template ExecutionTypes<DeviceAdapter>
+      ::Portal PortalType;
+    typedef CopyIndicesWithOffset<PortalType> CopyWorklet;
+
+    vtkm::Id numberOfValues = 0;
+    for (std::size_t i=0;i<input.size();i++)
+      numberOfValues += input[i].GetNumberOfValues();
+
+    if (numberOfValues == 0)
+      {
+      output.Shrink(0);
+      return;
+      }
+
+    PortalType portal = output.PrepareForOutput(numberOfValues,
+                                                DeviceAdapter());
+
+    vtkm::Id offset = 0;
+    for (std::size_t i=0;i<input.size();i++)
+      {
+      if (input[i].GetNumberOfValues() == 0)
+        continue;
+
+      CopyWorklet copy(portal,offset,indexOffsets[i]);
+      vtkm::worklet::DispatcherMapField<CopyWorklet,
+        DeviceAdapter>(copy).Invoke(input[i]);
+      offset += input[i].GetNumberOfValues();
+      }
+  }
+};
+
+}
+} // namespace vtkm::worklet
+
+#endif
@@ -2,15 +2,29 @@
 #define PYFR_CATALYSTDATA_H
 
 #include <inttypes.h>
+
+/*
+ * The precision of the solver's vertex and solution arrays.  It differs
+ * from FPType, the precision of the visualization pipeline, in mixed
+ * precision builds, where the solver's values are converted as they are
+ * first read.
+ */
+#ifndef SolverFPType
+#define SolverFPType FPType
+#endif
+#ifdef PYFR_DEVICE_ADAPTER_CUDA
 #include <cuda_runtime.h>
+#endif
 
 /*
  * The vertex and solution arrays are three dimensional having a
  * format of [nb][X][na] where X = 3 for the vertex array (x, y, z)
- * and X = 5 for the solution array (rho, rhou, rhov, rhow, E).  The
- * total number of nodes is na*nb.
+ * and X = nvars for the solution array (rho, rhou, rhov, rhow, E,
+ * followed by any additional variables of the solver).  The total number
+ * of nodes is na*nb.
  *
- * The solution array is a device pointer.  To make things more
+ * The solution array is a device pointer (a host pointer when the
+ * filters are built for one of the CPU device adapters).  To make things more
  * interesting it is also padded.  The distance between [i][j][k] and
  * [i + 1][j][k] is ldim elements.  The distance between [i][j][k] and
  * [i][j + 1][k] is lsdim elements.  Fun for the entire family!
@@ -22,6 +36,10 @@
  * associated with the first vertex is therefore con[off[i]].  Care
  * must be taken when looking up this node in vert/soln due to their
  * three dimensional structure.
+ *
+ * When the filters are built for CUDA, the vertex and connectivity arrays
+ * may be either host or device pointers; off and type are always host
+ * pointers.
  */
 struct MeshDataForCellType
 {
@@ -34,11 +52,18 @@ struct MeshDataForCellType
   uint8_t* type;
 };
 
+/*
+ * nvars was added after the other members, which keep their offsets, but it
+ * still grows the struct: solvers must be rebuilt against this header (or
+ * their ctypes definition extended) to pass more than the first cell type's
+ * solution correctly, and must set nvars to at least 5.
+ */
 struct SolutionDataForCellType
 {
   int ldim;
   int lsdim;
   void* solution; /* "soln" in PyFR parlance. */
+  int nvars; /* number of solution variables per node, at least 5 */
 };
 
 struct CatalystData
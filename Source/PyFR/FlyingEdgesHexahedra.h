@@ -0,0 +1,529 @@
+#ifndef FLYINGEDGESHEXAHEDRA_H
+#define FLYINGEDGESHEXAHEDRA_H
+
+#define BOOST_SP_DISABLE_THREADS
+
+#include <vector>
+
+#include <vtkm/cont/ArrayHandle.h>
+#include <vtkm/cont/ArrayHandleCounting.h>
+#include <vtkm/cont/ArrayHandlePermutation.h>
+#include <vtkm/cont/CellSetPermutation.h>
+#include <vtkm/cont/CoordinateSystem.h>
+#include <vtkm/cont/DeviceAdapter.h>
+#include <vtkm/cont/Timer.h>
+#include <vtkm/worklet/DispatcherMapField.h>
+#include <vtkm/worklet/DispatcherMapTopology.h>
+#include <vtkm/worklet/WorkletMapField.h>
+#include <vtkm/worklet/WorkletMapTopology.h>
+
+#include "IsosurfaceHexahedra.h"
+#include "MarchingCubesTables.h"
+
+namespace vtkm {
+namespace worklet {
+
+/// \brief Edge-centric isosurface extraction for hexahedral cell sets
+///
+/// In the spirit of flying edges, each unique edge of the cell set is
+/// classified once per isovalue and owns the single vertex generated on it,
+/// rather than each cell interpolating its own copy of the vertices on its
+/// twelve edges. Cells are still classified by their marching cubes case to
+/// count and place their triangles, but the triangles only index into the
+/// edge vertices, so the output is always welded (see GetIndices()).
+///
+/// Unlike flying edges proper, PyFR's cell sets are unstructured, so the
+/// unique edges are found by sorting the cells' edge keys. This only depends
+/// upon the topology and is kept between runs on a cell set with the same
+/// numbers of cells and points; call ResetTopology() when the cell set
+/// changes otherwise.
+///
+/// The edges cost memory. The filter keeps twelve edge ids per cell, plus
+/// the two points of each unique edge (about three edges per point). With
+/// 64-bit ids that is about 144 bytes per cell, four to five times the 32
+/// bytes of the cell's 32-bit connectivity. Finding the edges also holds
+/// two arrays of twelve 64-bit keys per cell, another 192 bytes per cell,
+/// while they are sorted.
+///
+/// The interpolation arrays, and so field mapping, are those of the
+/// IsosurfaceFilterHexahedra it derives from. Temporal coherence and the
+/// block index are not used.
+template <typename FieldType, typename DeviceAdapter>
+class FlyingEdgesHexahedra :
+    public IsosurfaceFilterHexahedra<FieldType,DeviceAdapter>
+{
+public:
+  typedef IsosurfaceFilterHexahedra<FieldType,DeviceAdapter> Superclass;
+  typedef typename Superclass::IsovalueCount IsovalueCount;
+  typedef typename Superclass::FieldVec FieldVec;
+  typedef typename Superclass::FieldHandleVec FieldHandleVec;
+  typedef typename Superclass::IdHandle IdHandle;
+  typedef typename Superclass::IdHandleVec IdHandleVec;
+
+  typedef typename IdHandle::template ExecutionTypes<DeviceAdapter>::Portal
+    IdPortalType;
+  typedef typename IdHandle::template ExecutionTypes<DeviceAdapter>
+    ::PortalConst IdPortalConstType;
+  typedef typename vtkm::cont::ArrayHandle<FieldType>::template
+    ExecutionTypes<DeviceAdapter>::Portal FieldPortalType;
+  typedef typename MarchingCubesTables<DeviceAdapter>::PortalType
+    TablePortalType;
+
+  /// Key each of a cell's twelve edges by the (unordered) pair of points it
+  /// joins
+  class CellEdgeKeys : public vtkm::worklet::WorkletMapPointToCell
+  {
+  public:
+    typedef void ControlSignature(TopologyIn topology);
+    typedef void ExecutionSignature(WorkIndex, FromIndices);
+    typedef _1 InputDomain;
+
+    IdPortalType EdgeKeys;
+    vtkm::Id NumberOfPoints;
+
+    VTKM_CONT_EXPORT
+    CellEdgeKeys(IdPortalType edgeKeys, vtkm::Id numberOfPoints) :
+      EdgeKeys(edgeKeys), NumberOfPoints(numberOfPoints) {}
+
+    template<typename IdVecType>
+    VTKM_EXEC_EXPORT
+    void operator()(const vtkm::Id cell, const IdVecType& pointIds) const
+    {
+      for (vtkm::IdComponent edge = 0; edge < 12; edge++)
+        {
+        int v0, v1;
+        HexahedronEdgeVertices(edge, v0, v1);
+        const vtkm::Id p0 = pointIds[v0];
+        const vtkm::Id p1 = pointIds[v1];
+        this->EdgeKeys.Set(cell*12 + edge,
+                           (p0 < p1 ? p0*this->NumberOfPoints + p1 :
+                            p1*this->NumberOfPoints + p0));
+        }
+    }
+  };
+
+  /// Recover the points of each unique edge from its key
+  class EdgePoints : public vtkm::worklet::WorkletMapField
+  {
+  public:
+    typedef void ControlSignature(FieldIn<IdType> key,
+                                  FieldOut<IdType> lowId,
+                                  FieldOut<IdType> highId);
+    typedef void ExecutionSignature(_1, _2, _3);
+    typedef _1 InputDomain;
+
+    vtkm::Id NumberOfPoints;
+
+    VTKM_CONT_EXPORT
+    EdgePoints(vtkm::Id numberOfPoints) : NumberOfPoints(numberOfPoints) {}
+
+    VTKM_EXEC_EXPORT
+    void operator()(const vtkm::Id& key,
+                    vtkm::Id& lowId,
+                    vtkm::Id& highId) const
+    {
+      lowId = key / this->NumberOfPoints;
+      highId = key % this->NumberOfPoints;
+    }
+  };
+
+  /// Flag the edges whose points lie on either side of the isovalue
+  class ClassifyEdges : public vtkm::worklet::WorkletMapField
+  {
+  public:
+    typedef void ControlSignature(FieldIn<vtkm::ListTagBase<FieldType> > low,
+                                  FieldIn<vtkm::ListTagBase<FieldType> > high,
+                                  FieldOut<IdType> crossed);
+    typedef void ExecutionSignature(_1, _2, _3);
+    typedef _1 InputDomain;
+
+    FieldType Isovalue;
+
+    VTKM_CONT_EXPORT
+    ClassifyEdges(FieldType isovalue) : Isovalue(isovalue) {}
+
+    VTKM_EXEC_EXPORT
+    void operator()(const FieldType& low,
+                    const FieldType& high,
+                    vtkm::Id& crossed) const
+    {
+      crossed = ((low > this->Isovalue) != (high > this->Isovalue) ? 1 : 0);
+    }
+  };
+
+  /// Count the triangles that each cell generates
+  class ClassifyCell : public vtkm::worklet::WorkletMapPointToCell
+  {
+  public:
+    typedef void ControlSignature(FieldInFrom<Scalar> scalars,
+                                  TopologyIn topology,
+                                  FieldOut<IdType> numTriangles);
+    typedef void ExecutionSignature(_1, _3);
+    typedef _2 InputDomain;
+
+    TablePortalType NumTrianglesTable;
+    FieldType Isovalue;
+
+    VTKM_CONT_EXPORT
+    ClassifyCell(TablePortalType numTrianglesTable, FieldType isovalue) :
+      NumTrianglesTable(numTrianglesTable), Isovalue(isovalue) {}
+
+    template<typename ScalarsVecType>
+    VTKM_EXEC_EXPORT
+    void operator()(const ScalarsVecType& scalars,
+                    vtkm::Id& numTriangles) const
+    {
+      FieldType corners[8];
+      for (vtkm::IdComponent i = 0; i < 8; ++i)
+        corners[i] = static_cast<FieldType>(scalars[i]);
+      numTriangles = this->NumTrianglesTable.Get(
+        HexahedronCase(corners, this->Isovalue));
+    }
+  };
+
+  /// Generate the triangles of the compacted cells as indices into the edge
+  /// vertices, and the vertices on the edges they use. A vertex is written by
+  /// each triangle that uses it; since the edge's points are always taken in
+  /// increasing order, and the normals are interpolated from the gradients at
+  /// the points (see PointGradients), all of them write the same vertex.
+  template<typename CoordinateType,typename PointGradientType>
+  class Generate : public vtkm::worklet::WorkletMapPointToCell
+  {
+  public:
+    typedef void ControlSignature(FieldInFrom<Scalar> scalars,
+                                  FieldInFrom<Vec3> coordinates,
+                                  FieldInTo<IdType> inputLowerBounds,
+                                  FieldInTo<IdType> inputCellId,
+                                  TopologyIn topology);
+    typedef void ExecutionSignature(WorkIndex, _1, _2, _3, _4, FromIndices);
+    typedef _5 InputDomain;
+
+    typedef typename vtkm::cont::ArrayHandle<vtkm::Vec<CoordinateType,3> >
+      ::template ExecutionTypes<DeviceAdapter>::Portal Vec3PortalType;
+
+    FieldType Isovalue;
+    TablePortalType TriTable;
+    IdPortalConstType CellEdgeIds;
+    IdPortalConstType EdgeVertexOffsets;
+    IdPortalType Indices;
+    FieldPortalType InterpolationWeight;
+    IdPortalType InterpolationLowId;
+    IdPortalType InterpolationHighId;
+    Vec3PortalType Vertices;
+    Vec3PortalType Normals;
+    PointGradientType PointGradient;
+
+    VTKM_CONT_EXPORT
+    Generate(FieldType isovalue,
+             TablePortalType triTable,
+             IdPortalConstType cellEdgeIds,
+             IdPortalConstType edgeVertexOffsets,
+             IdPortalType indices,
+             FieldPortalType interpolationWeight,
+             IdPortalType interpolationLowId,
+             IdPortalType interpolationHighId,
+             Vec3PortalType vertices,
+             Vec3PortalType normals,
+             const PointGradientType& pointGradient) :
+      Isovalue(isovalue),
+      TriTable(triTable),
+      CellEdgeIds(cellEdgeIds),
+      EdgeVertexOffsets(edgeVertexOffsets),
+      Indices(indices),
+      InterpolationWeight(interpolationWeight),
+      InterpolationLowId(interpolationLowId),
+      InterpolationHighId(interpolationHighId),
+      Vertices(vertices),
+      Normals(normals),
+      PointGradient(pointGradient) {}
+
+    template<typename ScalarsVecType,typename VectorsVecType,typename IdVecType>
+    VTKM_EXEC_EXPORT
+    void operator()(const vtkm::Id outputCellId,
+                    const ScalarsVecType& scalars,
+                    const VectorsVecType& pointCoords,
+                    const vtkm::Id inputLowerBounds,
+                    const vtkm::Id inputCellId,
+                    const IdVecType& pointIds) const
+    {
+      FieldType corners[8];
+      for (vtkm::IdComponent i = 0; i < 8; ++i)
+        corners[i] = static_cast<FieldType>(scalars[i]);
+      const vtkm::IdComponent cubeindex =
+        HexahedronCase(corners, this->Isovalue);
+
+      const vtkm::Id inputIteration = (outputCellId - inputLowerBounds);
+      const vtkm::Id cellOffset = (static_cast<vtkm::Id>(cubeindex*16) +
+                                   (inputIteration * 3));
+
+      for (vtkm::IdComponent v = 0; v < 3; v++)
+        {
+        const vtkm::IdComponent edge = this->TriTable.Get(cellOffset + v);
+        // The edge offsets are an inclusive scan of the crossed edges
+        const vtkm::Id vertex =
+          this->EdgeVertexOffsets.Get(
+            this->CellEdgeIds.Get(inputCellId*12 + edge)) - 1;
+        this->Indices.Set(outputCellId*3 + v, vertex);
+
+        int v0, v1;
+        HexahedronEdgeVertices(edge, v0, v1);
+        if (pointIds[v1] < pointIds[v0])
+          {
+          const int tmp = v0;
+          v0 = v1;
+          v1 = tmp;
+          }
+
+        const FieldType t = (this->Isovalue - corners[v0]) /
+                            (corners[v1] - corners[v0]);
+        this->Vertices.Set(vertex,
+                           vtkm::Lerp(pointCoords[v0], pointCoords[v1], t));
+        this->InterpolationWeight.Set(vertex, t);
+        this->InterpolationLowId.Set(vertex, pointIds[v0]);
+        this->InterpolationHighId.Set(vertex, pointIds[v1]);
+
+        vtkm::Vec<FieldType,3> normal =
+          vtkm::Lerp(this->PointGradient(pointIds[v0]),
+                     this->PointGradient(pointIds[v1]), t);
+        const FieldType magnitude = vtkm::Magnitude(normal);
+        if (magnitude > FieldType(0))
+          normal = (FieldType(-1)/magnitude)*normal;
+        this->Normals.Set(vertex, normal);
+        }
+    }
+  };
+
+  FlyingEdgesHexahedra() : NumberOfCells(0), NumberOfPoints(0) {}
+
+  /// Discard the unique edges, which are rebuilt on the next run
+  void ResetTopology()
+  {
+    this->NumberOfCells = this->NumberOfPoints = 0;
+    this->CellEdgeIds = IdHandle();
+    this->EdgeLowIds = IdHandle();
+    this->EdgeHighIds = IdHandle();
+  }
+
+  template<class CellSetType,typename StorageTag,typename CoordinateType>
+  void Run(const FieldVec& isovalues,
+           const CellSetType& cellSet,
+           const vtkm::cont::CoordinateSystem& coords,
+           const vtkm::cont::ArrayHandle<FieldType,StorageTag>& isoField,
+           std::vector<vtkm::cont::ArrayHandle<vtkm::Vec<CoordinateType,3> > >& vertices,
+           std::vector<vtkm::cont::ArrayHandle<vtkm::Vec<CoordinateType,3> > >& normals)
+  {
+    typedef typename vtkm::cont::DeviceAdapterAlgorithm<DeviceAdapter>
+      DeviceAlgorithms;
+    typedef vtkm::cont::ArrayHandle<FieldType> FieldHandle;
+    typedef vtkm::cont::ArrayHandle<vtkm::Vec<CoordinateType,3> > CoordHandle;
+    typedef vtkm::cont::ArrayHandle<FieldType,StorageTag> IsoFieldHandle;
+    typedef vtkm::cont::ArrayHandlePermutation<IdHandle,IsoFieldHandle>
+      EdgeFieldHandle;
+
+    const IsovalueCount nIsovalues = isovalues.size();
+    // NB: Cannot call resize to increase the lengths of vectors of array
+    // handles!
+    for (unsigned iso=this->InterpolationWeights.size();iso<nIsovalues;iso++)
+      {
+      this->InterpolationWeights.push_back(FieldHandle());
+      this->InterpolationLowIds.push_back(IdHandle());
+      this->InterpolationHighIds.push_back(IdHandle());
+      }
+    this->InterpolationWeights.resize(nIsovalues);
+    this->InterpolationLowIds.resize(nIsovalues);
+    this->InterpolationHighIds.resize(nIsovalues);
+    for (unsigned iso=this->Indices.size();iso<nIsovalues;iso++)
+      this->Indices.push_back(IdHandle());
+    this->Indices.resize(nIsovalues);
+    for (unsigned iso=vertices.size();iso<nIsovalues;iso++)
+      vertices.push_back(CoordHandle());
+    vertices.resize(nIsovalues);
+    for (unsigned iso=normals.size();iso<nIsovalues;iso++)
+      normals.push_back(CoordHandle());
+    normals.resize(nIsovalues);
+
+    vtkm::cont::Timer<DeviceAdapter> timer;
+
+    this->BuildTopology(cellSet,isoField.GetNumberOfValues());
+    this->Gradients.Update(cellSet,coords,isoField);
+    this->Timings.Scan += timer.GetElapsedTime();
+
+    MarchingCubesTables<DeviceAdapter>& tables =
+      MarchingCubesTables<DeviceAdapter>::Get();
+
+    for (IsovalueCount iso=0;iso<nIsovalues;iso++)
+      {
+      timer.Reset();
+
+      // Classify each unique edge once, and number the vertices on the
+      // crossed edges
+      IdHandle edgeVertexOffsets;
+      vtkm::worklet::DispatcherMapField<ClassifyEdges,DeviceAdapter>(
+        ClassifyEdges(isovalues[iso]))
+        .Invoke(EdgeFieldHandle(this->EdgeLowIds,isoField),
+                EdgeFieldHandle(this->EdgeHighIds,isoField),
+                edgeVertexOffsets);
+
+      // Count the triangles of each cell
+      IdHandle numTrianglesPerCell;
+      vtkm::worklet::DispatcherMapTopology<ClassifyCell,DeviceAdapter>(
+        ClassifyCell(tables.GetNumTrianglesTable(),
+                     isovalues[iso]))
+        .Invoke(isoField,cellSet,numTrianglesPerCell);
+      this->Timings.Classify += timer.GetElapsedTime();
+      timer.Reset();
+
+      vtkm::Id nVertices = 0;
+      vtkm::Id nTriangles = 0;
+      if (edgeVertexOffsets.GetNumberOfValues() > 0)
+        nVertices = DeviceAlgorithms::ScanInclusive(edgeVertexOffsets,
+                                                    edgeVertexOffsets);
+      if (nVertices > 0)
+        nTriangles = DeviceAlgorithms::ScanInclusive(numTrianglesPerCell,
+                                                     numTrianglesPerCell);
+
+      if (nTriangles == 0)
+        {
+        this->InterpolationWeights[iso].Shrink(0);
+        this->InterpolationLowIds[iso].Shrink(0);
+        this->InterpolationHighIds[iso].Shrink(0);
+        this->Indices[iso].Shrink(0);
+        vertices[iso].Shrink(0);
+        normals[iso].Shrink(0);
+        this->Timings.Scan += timer.GetElapsedTime();
+        continue;
+        }
+
+      IdHandle validCellIndices;
+      DeviceAlgorithms::UpperBounds(
+        numTrianglesPerCell,
+        vtkm::cont::ArrayHandleCounting<vtkm::Id>(0, 1, nTriangles),
+        validCellIndices);
+
+      // Compute for each output triangle what iteration of the input cell
+      // generates it
+      IdHandle inputCellIterationNumber;
+      DeviceAlgorithms::LowerBounds(validCellIndices,
+                                    validCellIndices,
+                                    inputCellIterationNumber);
+      this->Timings.Scan += timer.GetElapsedTime();
+      timer.Reset();
+
+      vtkm::cont::CellSetPermutation<IdHandle,CellSetType>
+        cellPermutation(validCellIndices,cellSet);
+
+      if (this->Gradients.UsesBasis())
+        this->GenerateTriangles(iso,isovalues[iso],cellPermutation,coords,
+                                isoField,inputCellIterationNumber,
+                                validCellIndices,edgeVertexOffsets,
+                                nTriangles,nVertices,vertices,normals,
+                                this->Gradients.PrepareBasisGradient(isoField));
+      else
+        this->GenerateTriangles(iso,isovalues[iso],cellPermutation,coords,
+                                isoField,inputCellIterationNumber,
+                                validCellIndices,edgeVertexOffsets,
+                                nTriangles,nVertices,vertices,normals,
+                                this->Gradients.PrepareStoredGradient());
+      this->Timings.Generate += timer.GetElapsedTime();
+      }
+  }
+
+protected:
+  template<class CellSetType,typename StorageTag,typename CoordinateType,
+           typename PointGradientType>
+  void GenerateTriangles(IsovalueCount iso,
+                         FieldType isovalue,
+                         const CellSetType& cellSet,
+                         const vtkm::cont::CoordinateSystem& coords,
+                         const vtkm::cont::ArrayHandle<FieldType,StorageTag>&
+                         isoField,
+                         const IdHandle& inputCellIterationNumber,
+                         const IdHandle& validCellIndices,
+                         const IdHandle& edgeVertexOffsets,
+                         vtkm::Id nTriangles,
+                         vtkm::Id nVertices,
+                         std::vector<vtkm::cont::ArrayHandle<vtkm::Vec<
+                         CoordinateType,3> > >& vertices,
+                         std::vector<vtkm::cont::ArrayHandle<vtkm::Vec<
+                         CoordinateType,3> > >& normals,
+                         const PointGradientType& pointGradient)
+  {
+    MarchingCubesTables<DeviceAdapter>& tables =
+      MarchingCubesTables<DeviceAdapter>::Get();
+
+    typedef Generate<CoordinateType,PointGradientType> GenerateWorklet;
+    GenerateWorklet generate(
+      isovalue,
+      tables.GetTriangleTable(),
+      this->CellEdgeIds.PrepareForInput(DeviceAdapter()),
+      edgeVertexOffsets.PrepareForInput(DeviceAdapter()),
+      this->Indices[iso].PrepareForOutput(nTriangles*3, DeviceAdapter()),
+      this->InterpolationWeights[iso].PrepareForOutput(nVertices,
+                                                       DeviceAdapter()),
+      this->InterpolationLowIds[iso].PrepareForOutput(nVertices,
+                                                      DeviceAdapter()),
+      this->InterpolationHighIds[iso].PrepareForOutput(nVertices,
+                                                       DeviceAdapter()),
+      vertices[iso].PrepareForOutput(nVertices, DeviceAdapter()),
+      normals[iso].PrepareForOutput(nVertices, DeviceAdapter()),
+      pointGradient);
+
+    vtkm::worklet::DispatcherMapTopology<GenerateWorklet,DeviceAdapter>(
+      generate).Invoke(isoField,
+                       coords.GetData(),
+                       inputCellIterationNumber,
+                       validCellIndices,
+                       cellSet);
+  }
+
+  // Find the unique edges of the cell set, and the unique edge on each of
+  // the cells' twelve edges. The key spans the square of the number of
+  // points, which assumes 64-bit ids for large meshes.
+  template<class CellSetType>
+  void BuildTopology(const CellSetType& cellSet, vtkm::Id numberOfPoints)
+  {
+    typedef typename vtkm::cont::DeviceAdapterAlgorithm<DeviceAdapter>
+      DeviceAlgorithms;
+
+    const vtkm::Id nCells = cellSet.GetNumberOfCells();
+    if (nCells == this->NumberOfCells &&
+        numberOfPoints == this->NumberOfPoints)
+      return;
+
+    this->ResetTopology();
+    if (nCells == 0)
+      return;
+
+    IdHandle cellEdgeKeys;
+    vtkm::worklet::DispatcherMapTopology<CellEdgeKeys,DeviceAdapter>(
+      CellEdgeKeys(cellEdgeKeys.PrepareForOutput(nCells*12,DeviceAdapter()),
+                   numberOfPoints)).Invoke(cellSet);
+
+    IdHandle edgeKeys;
+    DeviceAlgorithms::Copy(cellEdgeKeys,edgeKeys);
+    DeviceAlgorithms::Sort(edgeKeys);
+    DeviceAlgorithms::Unique(edgeKeys);
+    DeviceAlgorithms::LowerBounds(edgeKeys,cellEdgeKeys,this->CellEdgeIds);
+
+    vtkm::worklet::DispatcherMapField<EdgePoints,DeviceAdapter>(
+      EdgePoints(numberOfPoints)).Invoke(edgeKeys,
+                                         this->EdgeLowIds,
+                                         this->EdgeHighIds);
+
+    this->NumberOfCells = nCells;
+    this->NumberOfPoints = numberOfPoints;
+  }
+
+  vtkm::Id NumberOfCells;
+  vtkm::Id NumberOfPoints;
+  // The unique edge on each edge of each cell, twelve per cell
+  IdHandle CellEdgeIds;
+  // The points of each unique edge, in increasing order
+  IdHandle EdgeLowIds;
+  IdHandle EdgeHighIds;
+};
+
+}
+} // namespace vtkm::worklet
+
+#endif
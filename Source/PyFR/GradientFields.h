@@ -0,0 +1,298 @@
+#ifndef GRADIENTFIELDS_H
+#define GRADIENTFIELDS_H
+
+#define BOOST_SP_DISABLE_THREADS
+
+#include <vector>
+
+#include <vtkm/Math.h>
+#include <vtkm/VectorAnalysis.h>
+#include <vtkm/cont/ArrayHandle.h>
+#include <vtkm/cont/ArrayHandleCounting.h>
+#include <vtkm/cont/DeviceAdapter.h>
+#include <vtkm/worklet/DispatcherMapField.h>
+#include <vtkm/worklet/WorkletMapField.h>
+
+namespace vtkm {
+namespace worklet {
+
+/// \brief Compute velocity gradient based fields on high-order hexahedra
+///
+/// Each PyFR hexahedron holds n^3 solution points on an equispaced
+/// tensor-product grid (x varying fastest). The velocity gradient at each
+/// point is computed from the derivatives of the element's Lagrange basis,
+/// mapped to physical space with the isoparametric Jacobian, and reduced to
+/// vorticity magnitude, the Q-criterion and lambda2 in the same pass, one
+/// element per thread.
+template <typename FieldType, typename DeviceAdapter>
+class GradientFields
+{
+public:
+  typedef vtkm::Vec<FieldType,3> Vec3;
+  typedef vtkm::Vec<Vec3,3> Matrix3;
+
+  typedef vtkm::cont::ArrayHandle<FieldType> FieldHandle;
+  typedef typename FieldHandle::template ExecutionTypes<DeviceAdapter>
+    ::PortalConst FieldPortalConstType;
+  typedef typename FieldHandle::template ExecutionTypes<DeviceAdapter>
+    ::Portal FieldPortalType;
+  typedef vtkm::cont::ArrayHandle<Vec3> Vec3Handle;
+  typedef typename Vec3Handle::template ExecutionTypes<DeviceAdapter>
+    ::PortalConst Vec3PortalConstType;
+
+  /// Strides of the solver's padded solution array (see CatalystData.h)
+  struct SolutionLayout
+  {
+    vtkm::Id CellStride;
+    vtkm::Id VertexStride;
+  };
+
+  template <typename SolutionPortalType>
+  class ComputeElementGradients : public vtkm::worklet::WorkletMapField
+  {
+  public:
+    typedef void ControlSignature(FieldIn<IdType> element,
+                                  FieldIn<IdType> solutionElement);
+    typedef void ExecutionSignature(_1, _2);
+    typedef _1 InputDomain;
+
+    Vec3PortalConstType Coordinates;
+    SolutionPortalType Solution;
+    FieldPortalConstType Derivative;
+    SolutionLayout Layout;
+    vtkm::Id NodesPerEdge;
+    FieldPortalType VorticityMagnitude;
+    FieldPortalType QCriterion;
+    FieldPortalType Lambda2;
+
+    VTKM_CONT_EXPORT
+    ComputeElementGradients(Vec3PortalConstType coordinates,
+                            SolutionPortalType solution,
+                            FieldPortalConstType derivative,
+                            SolutionLayout layout,
+                            vtkm::Id nodesPerEdge,
+                            FieldPortalType vorticityMagnitude,
+                            FieldPortalType qCriterion,
+                            FieldPortalType lambda2) :
+      Coordinates(coordinates),
+      Solution(solution),
+      Derivative(derivative),
+      Layout(layout),
+      NodesPerEdge(nodesPerEdge),
+      VorticityMagnitude(vorticityMagnitude),
+      QCriterion(qCriterion),
+      Lambda2(lambda2) {}
+
+    VTKM_EXEC_EXPORT
+    Vec3 Velocity(vtkm::Id element, vtkm::Id node) const
+    {
+      const vtkm::Id offset = element + this->Layout.VertexStride*node;
+      const vtkm::Id cellStride = this->Layout.CellStride;
+      const FieldType invRho = 1/this->Solution.Get(offset);
+      return Vec3(invRho*this->Solution.Get(offset + cellStride),
+                  invRho*this->Solution.Get(offset + 2*cellStride),
+                  invRho*this->Solution.Get(offset + 3*cellStride));
+    }
+
+    VTKM_EXEC_EXPORT
+    void operator()(const vtkm::Id& element,
+                    const vtkm::Id& solutionElement) const
+    {
+      const vtkm::Id n = this->NodesPerEdge;
+      const vtkm::Id nNodes = n*n*n;
+      const vtkm::Id stride[3] = { 1, n, n*n };
+
+      for (vtkm::Id node=0;node<nNodes;node++)
+        {
+        const vtkm::Id ijk[3] = { node%n, (node/n)%n, node/(n*n) };
+
+        // Derivatives of position and velocity with respect to the
+        // reference coordinates; row r holds d/dxi_r
+        Matrix3 dXdXi;
+        Matrix3 dUdXi;
+        for (vtkm::IdComponent r=0;r<3;r++)
+          {
+          dXdXi[r] = Vec3(0);
+          dUdXi[r] = Vec3(0);
+          const vtkm::Id line = node - ijk[r]*stride[r];
+          for (vtkm::Id m=0;m<n;m++)
+            {
+            const FieldType d = this->Derivative.Get(ijk[r]*n + m);
+            const vtkm::Id other = line + m*stride[r];
+            dXdXi[r] = dXdXi[r] +
+              d*this->Coordinates.Get(element*nNodes + other);
+            dUdXi[r] = dUdXi[r] + d*this->Velocity(solutionElement,other);
+            }
+          }
+
+        // Invert the Jacobian; row r of the inverse is c_r/det = dxi_r/dx
+        const Vec3 c0 = vtkm::Cross(dXdXi[1],dXdXi[2]);
+        const Vec3 c1 = vtkm::Cross(dXdXi[2],dXdXi[0]);
+        const Vec3 c2 = vtkm::Cross(dXdXi[0],dXdXi[1]);
+        const FieldType invDet = 1/vtkm::dot(dXdXi[0],c0);
+
+        // g[a][b] = du_a/dx_b
+        Matrix3 g;
+        for (vtkm::IdComponent a=0;a<3;a++)
+          for (vtkm::IdComponent b=0;b<3;b++)
+            g[a][b] = invDet*(dUdXi[0][a]*c0[b] +
+                              dUdXi[1][a]*c1[b] +
+                              dUdXi[2][a]*c2[b]);
+
+        const vtkm::Id index = element*nNodes + node;
+        this->VorticityMagnitude.Set(index, vtkm::Magnitude(
+          Vec3(g[2][1] - g[1][2], g[0][2] - g[2][0], g[1][0] - g[0][1])));
+
+        // Strain rate and rotation tensors
+        Matrix3 s, w;
+        FieldType sNorm = 0, wNorm = 0;
+        for (vtkm::IdComponent a=0;a<3;a++)
+          for (vtkm::IdComponent b=0;b<3;b++)
+            {
+            s[a][b] = FieldType(0.5)*(g[a][b] + g[b][a]);
+            w[a][b] = FieldType(0.5)*(g[a][b] - g[b][a]);
+            sNorm += s[a][b]*s[a][b];
+            wNorm += w[a][b]*w[a][b];
+            }
+        this->QCriterion.Set(index, FieldType(0.5)*(wNorm - sNorm));
+
+        // lambda2 is the middle eigenvalue of S^2 + W^2
+        Matrix3 m;
+        for (vtkm::IdComponent a=0;a<3;a++)
+          for (vtkm::IdComponent b=0;b<3;b++)
+            {
+            m[a][b] = 0;
+            for (vtkm::IdComponent k=0;k<3;k++)
+              m[a][b] += s[a][k]*s[k][b] + w[a][k]*w[k][b];
+            }
+        this->Lambda2.Set(index, MiddleEigenvalue(m));
+        }
+    }
+
+    /// Closed-form eigenvalues of a symmetric 3x3 matrix
+    VTKM_EXEC_EXPORT
+    static FieldType MiddleEigenvalue(const Matrix3& m)
+    {
+      const FieldType offDiagonal =
+        m[0][1]*m[0][1] + m[0][2]*m[0][2] + m[1][2]*m[1][2];
+      const FieldType q = (m[0][0] + m[1][1] + m[2][2])/3;
+      const FieldType d[3] = { m[0][0] - q, m[1][1] - q, m[2][2] - q };
+      const FieldType p =
+        vtkm::Sqrt((d[0]*d[0] + d[1]*d[1] + d[2]*d[2] + 2*offDiagonal)/6);
+      if (p == 0)
+        return q;
+
+      // r = det((m - qI)/p)/2, clamped against round-off
+      const FieldType r =
+        (d[0]*(d[1]*d[2] - m[1][2]*m[1][2]) -
+         m[0][1]*(m[0][1]*d[2] - m[1][2]*m[0][2]) +
+         m[0][2]*(m[0][1]*m[1][2] - d[1]*m[0][2]))/(2*p*p*p);
+      const FieldType phi =
+        vtkm::ACos(vtkm::Min(vtkm::Max(r,FieldType(-1)),FieldType(1)))/3;
+
+      const FieldType twoPiOverThree = FieldType(2.0943951023931957);
+      const FieldType largest = q + 2*p*vtkm::Cos(phi);
+      const FieldType smallest = q + 2*p*vtkm::Cos(phi + twoPiOverThree);
+      return 3*q - largest - smallest;
+    }
+  };
+
+  /// Derivatives of the Lagrange polynomials through n equispaced points on
+  /// [-1,1]: D[i*n + j] = l_j'(x_i)
+  static void DerivativeMatrix(vtkm::Id n, FieldHandle& derivative)
+  {
+    std::vector<double> x(n), weight(n, 1.);
+    for (vtkm::Id i=0;i<n;i++)
+      x[i] = -1. + 2.*i/(n - 1);
+    for (vtkm::Id j=0;j<n;j++)
+      for (vtkm::Id k=0;k<n;k++)
+        if (k != j)
+          weight[j] /= (x[j] - x[k]);
+
+    derivative.Allocate(n*n);
+    typename FieldHandle::PortalControl portal =
+      derivative.GetPortalControl();
+    for (vtkm::Id i=0;i<n;i++)
+      {
+      double diagonal = 0.;
+      for (vtkm::Id j=0;j<n;j++)
+        {
+        if (j == i)
+          continue;
+        const double d = (weight[j]/weight[i])/(x[i] - x[j]);
+        portal.Set(i*n + j, static_cast<FieldType>(d));
+        diagonal -= d;
+        }
+      portal.Set(i*n + i, static_cast<FieldType>(diagonal));
+      }
+  }
+
+  /// Compute the gradient fields of nElements hexahedra with n^3 nodes each.
+  /// The coordinates are ordered element by element; the solution is the
+  /// solver's raw (rho, rhou, rhov, rhow, E) array with the given strides.
+  template <typename SolutionHandleType>
+  void Run(vtkm::Id nElements,
+           vtkm::Id nodesPerEdge,
+           const Vec3Handle& coordinates,
+           const SolutionHandleType& solution,
+           SolutionLayout layout,
+           FieldHandle& vorticityMagnitude,
+           FieldHandle& qCriterion,
+           FieldHandle& lambda2) const
+  {
+    this->Run(nElements,
+              nodesPerEdge,
+              coordinates,
+              solution,
+              layout,
+              vtkm::cont::ArrayHandleCounting<vtkm::Id>(0, 1, nElements),
+              vorticityMagnitude,
+              qCriterion,
+              lambda2);
+  }
+
+  /// As above, for elements that were reordered: element e of the
+  /// coordinates and the output is element solutionElements[e] of the
+  /// solution
+  template <typename SolutionHandleType, typename ElementHandleType>
+  void Run(vtkm::Id nElements,
+           vtkm::Id nodesPerEdge,
+           const Vec3Handle& coordinates,
+           const SolutionHandleType& solution,
+           SolutionLayout layout,
+           const ElementHandleType& solutionElements,
+           FieldHandle& vorticityMagnitude,
+           FieldHandle& qCriterion,
+           FieldHandle& lambda2) const
+  {
+    typedef typename SolutionHandleType::template
+      ExecutionTypes<DeviceAdapter>::PortalConst SolutionPortalType;
+    typedef ComputeElementGradients<SolutionPortalType> GradientWorklet;
+
+    const vtkm::Id nPoints = nElements*nodesPerEdge*nodesPerEdge*nodesPerEdge;
+
+    FieldHandle derivative;
+    DerivativeMatrix(nodesPerEdge, derivative);
+
+    GradientWorklet gradients(coordinates.PrepareForInput(DeviceAdapter()),
+                              solution.PrepareForInput(DeviceAdapter()),
+                              derivative.PrepareForInput(DeviceAdapter()),
+                              layout,
+                              nodesPerEdge,
+                              vorticityMagnitude.PrepareForOutput(nPoints,
+                                                          DeviceAdapter()),
+                              qCriterion.PrepareForOutput(nPoints,
+                                                          DeviceAdapter()),
+                              lambda2.PrepareForOutput(nPoints,
+                                                       DeviceAdapter()));
+
+    vtkm::cont::ArrayHandleCounting<vtkm::Id> elements(0, 1, nElements);
+    vtkm::worklet::DispatcherMapField<GradientWorklet,
+      DeviceAdapter>(gradients).Invoke(elements,solutionElements);
+  }
+};
+
+}
+} // namespace vtkm::worklet
+
+#endif
@@ -0,0 +1,142 @@
+#ifndef HEXAHEDRONCASE_H
+#define HEXAHEDRONCASE_H
+
+#define BOOST_SP_DISABLE_THREADS
+
+#include <vtkm/Types.h>
+
+// On the CPU adapters, cells are classified in tiles of consecutive cells
+// (see HexahedronTileCases), and the comparisons are wide compares when the
+// filters are built for AVX2 or AVX-512 (see PYFR_SIMD_INSTRUCTIONS in the
+// top-level CMakeLists.txt). On CUDA, each thread classifies one cell.
+#if !defined(PYFR_DEVICE_ADAPTER_CUDA) && !defined(__CUDACC__)
+#define PYFR_TILED_CLASSIFY
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#define PYFR_SIMD_CLASSIFY
+#endif
+#endif
+
+namespace vtkm {
+namespace worklet {
+
+/// The marching cubes case of a hexahedron, whose bit i is set when the
+/// value at corner i lies above the isovalue
+template<typename FieldType>
+VTKM_EXEC_CONT_EXPORT
+vtkm::IdComponent HexahedronCase(const FieldType* corners, FieldType isovalue)
+{
+  vtkm::IdComponent caseId = 0;
+  for (vtkm::IdComponent i = 0; i < 8; ++i)
+    caseId |= (corners[i] > isovalue) << i;
+  return caseId;
+}
+
+/// The number of cells classified together by HexahedronTileCases
+const vtkm::IdComponent HexahedronTileSize = 8;
+
+/// The marching cubes cases of a tile of hexahedra, given corner by corner:
+/// corners[i][c] is the value at corner i of cell c. Each corner's compares
+/// are independent across the tile, so they are a single wide compare.
+template<typename FieldType>
+VTKM_EXEC_CONT_EXPORT
+void HexahedronTileCases(const FieldType corners[8][HexahedronTileSize],
+                         FieldType isovalue,
+                         vtkm::IdComponent cases[HexahedronTileSize])
+{
+  for (vtkm::IdComponent c = 0; c < HexahedronTileSize; ++c)
+    cases[c] = 0;
+  for (vtkm::IdComponent i = 0; i < 8; ++i)
+    for (vtkm::IdComponent c = 0; c < HexahedronTileSize; ++c)
+      cases[c] |= (corners[i][c] > isovalue) << i;
+}
+
+#ifdef PYFR_SIMD_CLASSIFY
+// The eight corners of a single precision hexahedron fill one 256-bit
+// register, whose sign mask is the case
+inline vtkm::IdComponent HexahedronCase(const vtkm::Float32* corners,
+                                        vtkm::Float32 isovalue)
+{
+  const __m256 above = _mm256_cmp_ps(_mm256_loadu_ps(corners),
+                                     _mm256_set1_ps(isovalue), _CMP_GT_OQ);
+  return _mm256_movemask_ps(above);
+}
+
+inline vtkm::IdComponent HexahedronCase(const vtkm::Float64* corners,
+                                        vtkm::Float64 isovalue)
+{
+#if defined(__AVX512F__)
+  return _mm512_cmp_pd_mask(_mm512_loadu_pd(corners),
+                            _mm512_set1_pd(isovalue), _CMP_GT_OQ);
+#else
+  const __m256d iso = _mm256_set1_pd(isovalue);
+  const __m256d low = _mm256_cmp_pd(_mm256_loadu_pd(corners), iso,
+                                    _CMP_GT_OQ);
+  const __m256d high = _mm256_cmp_pd(_mm256_loadu_pd(corners + 4), iso,
+                                     _CMP_GT_OQ);
+  return _mm256_movemask_pd(low) | (_mm256_movemask_pd(high) << 4);
+#endif
+}
+
+// A corner of a single precision tile fills one 256-bit register. Its
+// compare is all ones in the cells above the isovalue, which selects the
+// corner's bit of their cases.
+inline void HexahedronTileCases(const vtkm::Float32 corners[8][8],
+                                vtkm::Float32 isovalue,
+                                vtkm::IdComponent cases[8])
+{
+  const __m256 iso = _mm256_set1_ps(isovalue);
+  __m256i caseIds = _mm256_setzero_si256();
+  for (int i = 0; i < 8; ++i)
+    {
+    const __m256 above = _mm256_cmp_ps(_mm256_loadu_ps(corners[i]), iso,
+                                       _CMP_GT_OQ);
+    caseIds = _mm256_or_si256(caseIds,
+                              _mm256_and_si256(_mm256_castps_si256(above),
+                                               _mm256_set1_epi32(1 << i)));
+    }
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(cases), caseIds);
+}
+
+inline void HexahedronTileCases(const vtkm::Float64 corners[8][8],
+                                vtkm::Float64 isovalue,
+                                vtkm::IdComponent cases[8])
+{
+#if defined(__AVX512F__)
+  const __m512d iso = _mm512_set1_pd(isovalue);
+  __m512i caseIds = _mm512_setzero_si512();
+  for (int i = 0; i < 8; ++i)
+    caseIds = _mm512_or_si512(
+      caseIds,
+      _mm512_maskz_set1_epi64(
+        _mm512_cmp_pd_mask(_mm512_loadu_pd(corners[i]), iso, _CMP_GT_OQ),
+        1 << i));
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(cases),
+                      _mm512_cvtepi64_epi32(caseIds));
+#else
+  const __m256d iso = _mm256_set1_pd(isovalue);
+  __m256i low = _mm256_setzero_si256();
+  __m256i high = _mm256_setzero_si256();
+  for (int i = 0; i < 8; ++i)
+    {
+    const __m256i bit = _mm256_set1_epi64x(1 << i);
+    low = _mm256_or_si256(low, _mm256_and_si256(
+      _mm256_castpd_si256(_mm256_cmp_pd(_mm256_loadu_pd(corners[i]), iso,
+                                        _CMP_GT_OQ)), bit));
+    high = _mm256_or_si256(high, _mm256_and_si256(
+      _mm256_castpd_si256(_mm256_cmp_pd(_mm256_loadu_pd(corners[i] + 4),
+                                        iso, _CMP_GT_OQ)), bit));
+    }
+  vtkm::Int64 wide[8];
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(wide), low);
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(wide + 4), high);
+  for (int c = 0; c < 8; ++c)
+    cases[c] = static_cast<vtkm::IdComponent>(wide[c]);
+#endif
+}
+#endif
+
+}
+} // namespace vtkm::worklet
+
+#endif
@@ -0,0 +1,333 @@
+#ifndef HIGHORDERREFINEMENT_H
+#define HIGHORDERREFINEMENT_H
+
+#define BOOST_SP_DISABLE_THREADS
+
+#include <vector>
+
+#include <vtkm/cont/ArrayHandle.h>
+#include <vtkm/cont/ArrayHandleCounting.h>
+#include <vtkm/cont/ArrayHandleImplicit.h>
+#include <vtkm/cont/CellSetSingleType.h>
+#include <vtkm/cont/CoordinateSystem.h>
+#include <vtkm/cont/DeviceAdapter.h>
+#include <vtkm/worklet/DispatcherMapField.h>
+#include <vtkm/worklet/DispatcherMapTopology.h>
+#include <vtkm/worklet/WorkletMapField.h>
+#include <vtkm/worklet/WorkletMapTopology.h>
+
+namespace vtkm {
+namespace worklet {
+
+/// \brief Resample the high-order hexahedra that an isosurface crosses
+///
+/// Each PyFR hexahedron holds n^3 nodes on an equispaced tensor-product grid
+/// (x varying fastest), and its points are stored contiguously. Whole
+/// elements are first classified by the nodal min/max of the contour field;
+/// only the elements that some isovalue crosses (and that hold at least one
+/// cell of the given cell set) are resampled with r^3 points through their
+/// Lagrange interpolant and split into (r-1)^3 linear hexahedra for marching
+/// cubes. Fields are mapped by resampling them on the same active elements.
+///
+/// Elements are resampled whole, so if the cell set was clipped, the refined
+/// cells extend past the clipped cells of partially clipped elements; the
+/// caller must apply the clip to the refined cells (e.g. with
+/// IsosurfaceFilterHexahedra::SetClipPlane).
+template <typename FieldType, typename DeviceAdapter>
+class HighOrderRefinement
+{
+public:
+  typedef vtkm::cont::ArrayHandle<vtkm::Id> IdHandle;
+  typedef vtkm::cont::ArrayHandle<FieldType> FieldHandle;
+  typedef vtkm::cont::ArrayHandle<vtkm::Vec<FieldType,3> > Vec3Handle;
+  typedef vtkm::cont::CellSetSingleType<> CellSet;
+
+  typedef typename IdHandle::template ExecutionTypes<DeviceAdapter>::Portal
+    IdPortalType;
+  typedef typename IdHandle::template ExecutionTypes<DeviceAdapter>
+    ::PortalConst IdPortalConstType;
+  typedef typename FieldHandle::template ExecutionTypes<DeviceAdapter>
+    ::PortalConst FieldPortalConstType;
+
+  /// Flag the elements that hold at least one cell of a cell set
+  class MarkElements : public vtkm::worklet::WorkletMapPointToCell
+  {
+  public:
+    typedef void ControlSignature(TopologyIn topology);
+    typedef void ExecutionSignature(FromIndices);
+    typedef _1 InputDomain;
+
+    IdPortalType Present;
+    vtkm::Id NodesPerElement;
+
+    VTKM_CONT_EXPORT
+    MarkElements(IdPortalType present, vtkm::Id nodesPerElement) :
+      Present(present), NodesPerElement(nodesPerElement) {}
+
+    template<typename IndicesVecType>
+    VTKM_EXEC_EXPORT
+    void operator()(const IndicesVecType& indices) const
+    {
+      this->Present.Set(indices[0]/this->NodesPerElement, 1);
+    }
+  };
+
+  /// Flag the present elements whose nodal range contains an isovalue
+  template<typename FieldPortalType>
+  class ClassifyElements : public vtkm::worklet::WorkletMapField
+  {
+  public:
+    typedef void ControlSignature(FieldIn<IdType> present,
+                                  FieldOut<IdType> active);
+    typedef void ExecutionSignature(_1, _2, WorkIndex);
+    typedef _1 InputDomain;
+
+    FieldPortalType Field;
+    FieldPortalConstType Isovalues;
+    vtkm::Id NodesPerElement;
+
+    VTKM_CONT_EXPORT
+    ClassifyElements(FieldPortalType field,
+                     FieldPortalConstType isovalues,
+                     vtkm::Id nodesPerElement) :
+      Field(field), Isovalues(isovalues), NodesPerElement(nodesPerElement) {}
+
+    VTKM_EXEC_EXPORT
+    void operator()(const vtkm::Id& present, vtkm::Id& active,
+                    vtkm::Id element) const
+    {
+      active = 0;
+      if (!present)
+        return;
+
+      const vtkm::Id offset = element*this->NodesPerElement;
+      FieldType minimum = this->Field.Get(offset);
+      FieldType maximum = minimum;
+      for (vtkm::Id i=1;i<this->NodesPerElement;i++)
+        {
+        const FieldType value = this->Field.Get(offset + i);
+        minimum = (value < minimum ? value : minimum);
+        maximum = (value > maximum ? value : maximum);
+        }
+
+      for (vtkm::Id i=0;i<this->Isovalues.GetNumberOfValues();i++)
+        {
+        const FieldType isovalue = this->Isovalues.Get(i);
+        if (minimum <= isovalue && isovalue <= maximum)
+          active = 1;
+        }
+    }
+  };
+
+  /// Evaluate an element's interpolant at its resampled points
+  template<typename ValueType, typename NodalPortalType>
+  class Resample : public vtkm::worklet::WorkletMapField
+  {
+  public:
+    typedef void ControlSignature(FieldIn<IdType> point,
+                                  FieldOut<> value);
+    typedef void ExecutionSignature(_1, _2);
+    typedef _1 InputDomain;
+
+    NodalPortalType Nodal;
+    IdPortalConstType ActiveElements;
+    FieldPortalConstType Basis;
+    vtkm::Id NodesPerEdge;
+    vtkm::Id RefinedNodesPerEdge;
+
+    VTKM_CONT_EXPORT
+    Resample(NodalPortalType nodal,
+             IdPortalConstType activeElements,
+             FieldPortalConstType basis,
+             vtkm::Id nodesPerEdge,
+             vtkm::Id refinedNodesPerEdge) :
+      Nodal(nodal),
+      ActiveElements(activeElements),
+      Basis(basis),
+      NodesPerEdge(nodesPerEdge),
+      RefinedNodesPerEdge(refinedNodesPerEdge) {}
+
+    VTKM_EXEC_EXPORT
+    void operator()(const vtkm::Id& point, ValueType& value) const
+    {
+      const vtkm::Id n = this->NodesPerEdge;
+      const vtkm::Id r = this->RefinedNodesPerEdge;
+      const vtkm::Id local = point%(r*r*r);
+      const vtkm::Id a = local%r;
+      const vtkm::Id b = (local/r)%r;
+      const vtkm::Id c = local/(r*r);
+      const vtkm::Id offset =
+        this->ActiveElements.Get(point/(r*r*r))*n*n*n;
+
+      value = ValueType(0);
+      for (vtkm::Id k=0;k<n;k++)
+        {
+        const FieldType lk = this->Basis.Get(c*n + k);
+        for (vtkm::Id j=0;j<n;j++)
+          {
+          const FieldType ljk = lk*this->Basis.Get(b*n + j);
+          for (vtkm::Id i=0;i<n;i++)
+            value = value + (ljk*this->Basis.Get(a*n + i))*
+              this->Nodal.Get(offset + i + j*n + k*n*n);
+          }
+        }
+    }
+  };
+
+  /// Split each resampled element into (r-1)^3 hexahedra
+  class Connect : public vtkm::worklet::WorkletMapField
+  {
+  public:
+    typedef void ControlSignature(FieldIn<IdType> cell);
+    typedef void ExecutionSignature(_1);
+    typedef _1 InputDomain;
+
+    IdPortalType Connectivity;
+    vtkm::Id RefinedNodesPerEdge;
+
+    VTKM_CONT_EXPORT
+    Connect(IdPortalType connectivity, vtkm::Id refinedNodesPerEdge) :
+      Connectivity(connectivity), RefinedNodesPerEdge(refinedNodesPerEdge) {}
+
+    VTKM_EXEC_EXPORT
+    void operator()(const vtkm::Id& cell) const
+    {
+      const vtkm::Id r = this->RefinedNodesPerEdge;
+      const vtkm::Id m = r - 1;
+      const vtkm::Id local = cell%(m*m*m);
+      const vtkm::Id base = (cell/(m*m*m))*r*r*r +
+        local%m + ((local/m)%m)*r + (local/(m*m))*r*r;
+      const vtkm::Id corner[8] = { 0, 1, 1 + r, r,
+                                   r*r, 1 + r*r, 1 + r + r*r, r + r*r };
+      for (vtkm::IdComponent i=0;i<8;i++)
+        this->Connectivity.Set(8*cell + i, base + corner[i]);
+    }
+  };
+
+  HighOrderRefinement() : NodesPerEdge(0), RefinedNodesPerEdge(0) {}
+
+  /// Select the elements of a cell set's mesh that the isovalues cross, and
+  /// build the refined mesh over them
+  template<typename CellSetType, typename FieldArrayType,
+           typename CoordinateArrayType>
+  void Refine(const std::vector<FieldType>& isovalues,
+              const CellSetType& cellSet,
+              const FieldArrayType& field,
+              const CoordinateArrayType& coordinates,
+              vtkm::Id nodesPerEdge,
+              vtkm::Id refinedNodesPerEdge)
+  {
+    typedef vtkm::cont::DeviceAdapterAlgorithm<DeviceAdapter> Algorithm;
+    typedef typename FieldArrayType::template
+      ExecutionTypes<DeviceAdapter>::PortalConst FieldPortalType;
+
+    this->NodesPerEdge = nodesPerEdge;
+    this->RefinedNodesPerEdge = refinedNodesPerEdge;
+
+    const vtkm::Id nodesPerElement = nodesPerEdge*nodesPerEdge*nodesPerEdge;
+    const vtkm::Id nElements = field.GetNumberOfValues()/nodesPerElement;
+
+    IdHandle present;
+    Algorithm::Copy(vtkm::cont::make_ArrayHandleImplicit<vtkm::Id>(
+                      Zero(),nElements),present);
+    MarkElements markElements(present.PrepareForInPlace(DeviceAdapter()),
+                              nodesPerElement);
+    vtkm::worklet::DispatcherMapTopology<MarkElements,
+      DeviceAdapter>(markElements).Invoke(cellSet);
+
+    FieldHandle isovalueArray = vtkm::cont::make_ArrayHandle(isovalues);
+    IdHandle active;
+    ClassifyElements<FieldPortalType> classify(
+      field.PrepareForInput(DeviceAdapter()),
+      isovalueArray.PrepareForInput(DeviceAdapter()),
+      nodesPerElement);
+    vtkm::worklet::DispatcherMapField<ClassifyElements<FieldPortalType>,
+      DeviceAdapter>(classify).Invoke(present, active);
+
+    // Compact the active element ids
+    const vtkm::Id nActive = Algorithm::ScanInclusive(active, active);
+    vtkm::cont::ArrayHandleCounting<vtkm::Id> activeCount(0, 1, nActive);
+    Algorithm::UpperBounds(active, activeCount, this->ActiveElements);
+
+    // Lagrange basis through the element's nodes, at the resampled points
+    const vtkm::Id n = nodesPerEdge;
+    const vtkm::Id r = refinedNodesPerEdge;
+    this->Basis.Allocate(r*n);
+    typename FieldHandle::PortalControl basis =
+      this->Basis.GetPortalControl();
+    for (vtkm::Id a=0;a<r;a++)
+      {
+      const double x = static_cast<double>(a)*(n - 1)/(r - 1);
+      for (vtkm::Id i=0;i<n;i++)
+        {
+        double l = 1.;
+        for (vtkm::Id j=0;j<n;j++)
+          if (j != i)
+            l *= (x - j)/(i - j);
+        basis.Set(a*n + i, static_cast<FieldType>(l));
+        }
+      }
+
+    this->Map(coordinates, this->Coordinates);
+
+    const vtkm::Id nCells = nActive*(r - 1)*(r - 1)*(r - 1);
+    IdHandle connectivity;
+    Connect connect(connectivity.PrepareForOutput(8*nCells, DeviceAdapter()),
+                    r);
+    vtkm::worklet::DispatcherMapField<Connect,DeviceAdapter>(connect).
+      Invoke(vtkm::cont::ArrayHandleCounting<vtkm::Id>(0, 1, nCells));
+
+    this->RefinedCellSet = CellSet(vtkm::CellShapeTagHexahedron(),
+                                   "refined");
+    this->RefinedCellSet.Fill(connectivity);
+  }
+
+  /// Resample a nodal array on the active elements
+  template<typename ArrayHandleIn, typename ValueType>
+  void Map(const ArrayHandleIn& nodal,
+           vtkm::cont::ArrayHandle<ValueType>& refined) const
+  {
+    typedef typename ArrayHandleIn::template
+      ExecutionTypes<DeviceAdapter>::PortalConst NodalPortalType;
+    typedef Resample<ValueType,NodalPortalType> ResampleWorklet;
+
+    const vtkm::Id r = this->RefinedNodesPerEdge;
+    const vtkm::Id nPoints = this->ActiveElements.GetNumberOfValues()*r*r*r;
+
+    ResampleWorklet resample(nodal.PrepareForInput(DeviceAdapter()),
+                             this->ActiveElements.PrepareForInput(
+                               DeviceAdapter()),
+                             this->Basis.PrepareForInput(DeviceAdapter()),
+                             this->NodesPerEdge,
+                             r);
+    vtkm::worklet::DispatcherMapField<ResampleWorklet,DeviceAdapter>(
+      resample).Invoke(vtkm::cont::ArrayHandleCounting<vtkm::Id>(0, 1,
+                                                                 nPoints),
+                       refined);
+  }
+
+  const CellSet& GetCellSet() const { return this->RefinedCellSet; }
+  vtkm::cont::CoordinateSystem GetCoordinateSystem() const
+  {
+    return vtkm::cont::CoordinateSystem("coordinates",1,this->Coordinates);
+  }
+
+private:
+  struct Zero
+  {
+    VTKM_EXEC_CONT_EXPORT
+    vtkm::Id operator()(vtkm::Id) const { return 0; }
+  };
+
+  vtkm::Id NodesPerEdge;
+  vtkm::Id RefinedNodesPerEdge;
+  IdHandle ActiveElements;
+  FieldHandle Basis;
+  Vec3Handle Coordinates;
+  CellSet RefinedCellSet;
+};
+
+}
+} // namespace vtkm::worklet
+
+#endif
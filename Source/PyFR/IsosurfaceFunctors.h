@@ -0,0 +1,223 @@
+#ifndef ISOSURFACEFUNCTORS_H
+#define ISOSURFACEFUNCTORS_H
+
+#define BOOST_SP_DISABLE_THREADS
+
+#include <vector>
+
+#include <vtkm/cont/ArrayHandle.h>
+#include <vtkm/cont/CoordinateSystem.h>
+
+// Functors for calling the isosurface filter on a field held in a
+// DynamicArrayHandle, whose storage depends upon whether PyFRData
+// materializes its fields (see PyFRData::FieldStorageList).
+
+template<typename IsosurfaceFilter, typename CellSetType, typename Vec3HandleVec>
+class RunIsosurfaceFunctor
+{
+public:
+  RunIsosurfaceFunctor(IsosurfaceFilter* filter,
+                       const std::vector<FPType>& isovalues,
+                       const CellSetType& cellSet,
+                       const vtkm::cont::CoordinateSystem& coords,
+                       Vec3HandleVec& vertices,
+                       Vec3HandleVec& normals) : Filter(filter),
+                                                 Isovalues(isovalues),
+                                                 CellSet(cellSet),
+                                                 Coords(coords),
+                                                 Vertices(vertices),
+                                                 Normals(normals) {}
+
+  template<typename StorageTag>
+  void operator()(const vtkm::cont::ArrayHandle<FPType,StorageTag>& field) const
+  {
+    this->Filter->Run(this->Isovalues,
+                      this->CellSet,
+                      this->Coords,
+                      field,
+                      this->Vertices,
+                      this->Normals);
+  }
+
+private:
+  IsosurfaceFilter* Filter;
+  const std::vector<FPType>& Isovalues;
+  const CellSetType& CellSet;
+  const vtkm::cont::CoordinateSystem& Coords;
+  Vec3HandleVec& Vertices;
+  Vec3HandleVec& Normals;
+};
+
+template<typename IsosurfaceFilter>
+class BuildBlockIndexFunctor
+{
+public:
+  BuildBlockIndexFunctor(IsosurfaceFilter* filter,
+                         vtkm::Id nCells) : Filter(filter),
+                                            NumberOfCells(nCells) {}
+
+  template<typename StorageTag>
+  void operator()(const vtkm::cont::ArrayHandle<FPType,StorageTag>& field) const
+  {
+    this->Filter->BuildBlockIndex(field,this->NumberOfCells);
+  }
+
+private:
+  IsosurfaceFilter* Filter;
+  vtkm::Id NumberOfCells;
+};
+
+template<typename IsosurfaceFilter, typename ArrayHandleOut>
+class MapFieldFunctor
+{
+public:
+  MapFieldFunctor(IsosurfaceFilter* filter,
+                  std::vector<ArrayHandleOut>& output) : Filter(filter),
+                                                         Output(output) {}
+
+  template<typename StorageTag>
+  void operator()(const vtkm::cont::ArrayHandle<FPType,StorageTag>& field) const
+  {
+    this->Filter->MapFieldOntoIsosurfaces(field,this->Output);
+  }
+
+private:
+  IsosurfaceFilter* Filter;
+  std::vector<ArrayHandleOut>& Output;
+};
+
+// Functors for contouring high-order hexahedra through a HighOrderRefinement:
+// the elements that the isovalues cross are resampled before contouring, and
+// mapped fields are resampled on the same elements.
+
+template<typename IsosurfaceFilter, typename Refinement, typename CellSetType,
+         typename CoordinateArrayType, typename Vec3HandleVec>
+class RunRefinedIsosurfaceFunctor
+{
+public:
+  RunRefinedIsosurfaceFunctor(IsosurfaceFilter* filter,
+                              Refinement* refinement,
+                              const std::vector<FPType>& isovalues,
+                              const CellSetType& cellSet,
+                              const CoordinateArrayType& coords,
+                              vtkm::Id nodesPerEdge,
+                              vtkm::Id refinedNodesPerEdge,
+                              Vec3HandleVec& vertices,
+                              Vec3HandleVec& normals) :
+    Filter(filter),
+    Refine(refinement),
+    Isovalues(isovalues),
+    CellSet(cellSet),
+    Coords(coords),
+    NodesPerEdge(nodesPerEdge),
+    RefinedNodesPerEdge(refinedNodesPerEdge),
+    Vertices(vertices),
+    Normals(normals) {}
+
+  template<typename StorageTag>
+  void operator()(const vtkm::cont::ArrayHandle<FPType,StorageTag>& field) const
+  {
+    this->Refine->Refine(this->Isovalues,
+                         this->CellSet,
+                         field,
+                         this->Coords,
+                         this->NodesPerEdge,
+                         this->RefinedNodesPerEdge);
+
+    vtkm::cont::ArrayHandle<FPType> refinedField;
+    this->Refine->Map(field,refinedField);
+
+    this->Filter->Run(this->Isovalues,
+                      this->Refine->GetCellSet(),
+                      this->Refine->GetCoordinateSystem(),
+                      refinedField,
+                      this->Vertices,
+                      this->Normals);
+  }
+
+private:
+  IsosurfaceFilter* Filter;
+  Refinement* Refine;
+  const std::vector<FPType>& Isovalues;
+  const CellSetType& CellSet;
+  const CoordinateArrayType& Coords;
+  vtkm::Id NodesPerEdge;
+  vtkm::Id RefinedNodesPerEdge;
+  Vec3HandleVec& Vertices;
+  Vec3HandleVec& Normals;
+};
+
+template<typename IsosurfaceFilter, typename Refinement,
+         typename ArrayHandleOut>
+class MapRefinedFieldFunctor
+{
+public:
+  MapRefinedFieldFunctor(IsosurfaceFilter* filter,
+                         const Refinement* refinement,
+                         std::vector<ArrayHandleOut>& output) :
+    Filter(filter), Refine(refinement), Output(output) {}
+
+  template<typename StorageTag>
+  void operator()(const vtkm::cont::ArrayHandle<FPType,StorageTag>& field) const
+  {
+    vtkm::cont::ArrayHandle<FPType> refinedField;
+    this->Refine->Map(field,refinedField);
+    this->Filter->MapFieldOntoIsosurfaces(refinedField,this->Output);
+  }
+
+private:
+  IsosurfaceFilter* Filter;
+  const Refinement* Refine;
+  std::vector<ArrayHandleOut>& Output;
+};
+
+// Functors for mapping several fields in one pass. Fields are gathered by
+// storage, since a single kernel can only read fields of one array type, and
+// the fields of refined elements are first resampled onto them.
+
+template<typename StorageTag>
+class GatherFieldFunctor
+{
+public:
+  typedef vtkm::cont::ArrayHandle<FPType,StorageTag> ArrayHandleType;
+
+  GatherFieldFunctor(std::vector<ArrayHandleType>& fields,
+                     bool& gathered) : Fields(fields),
+                                       Gathered(gathered) {}
+
+  void operator()(const ArrayHandleType& field) const
+  {
+    this->Fields.push_back(field);
+    this->Gathered = true;
+  }
+
+  template<typename OtherStorageTag>
+  void operator()(const vtkm::cont::ArrayHandle<FPType,OtherStorageTag>&) const
+  {
+  }
+
+private:
+  std::vector<ArrayHandleType>& Fields;
+  bool& Gathered;
+};
+
+template<typename Refinement>
+class RefineFieldFunctor
+{
+public:
+  RefineFieldFunctor(const Refinement* refinement,
+                     vtkm::cont::ArrayHandle<FPType>& output) :
+    Refine(refinement), Output(output) {}
+
+  template<typename StorageTag>
+  void operator()(const vtkm::cont::ArrayHandle<FPType,StorageTag>& field) const
+  {
+    this->Refine->Map(field,this->Output);
+  }
+
+private:
+  const Refinement* Refine;
+  vtkm::cont::ArrayHandle<FPType>& Output;
+};
+
+#endif
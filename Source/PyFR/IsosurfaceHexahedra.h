@@ -21,7 +21,9 @@
 #ifndef vtk_m_worklet_IsosurfaceHexahedra_h
 #define vtk_m_worklet_IsosurfaceHexahedra_h
 
+#include <algorithm>
 #include <cassert>
+#include <limits>
 #include <stdlib.h>
 #include <stdio.h>
 
@@ -29,8 +31,11 @@
 
 #include <vtkm/cont/DeviceAdapter.h>
 #include <vtkm/cont/ArrayHandle.h>
+#include <vtkm/cont/ArrayHandleConstant.h>
 #include <vtkm/cont/ArrayHandleCounting.h>
+#include <vtkm/cont/ArrayHandleImplicit.h>
 #include <vtkm/cont/ArrayHandlePermutation.h>
+#include <vtkm/cont/ArrayHandleTransform.h>
 #include <vtkm/cont/CellSetExplicit.h>
 #include <vtkm/cont/DynamicArrayHandle.h>
 #include <vtkm/worklet/DispatcherMapField.h>
@@ -38,18 +43,142 @@
 #include <vtkm/Pair.h>
 
 #include <vtkm/cont/CellSetPermutation.h>
+#include <vtkm/cont/CellSetSingleType.h>
 #include <vtkm/cont/DataSet.h>
 #include <vtkm/cont/Field.h>
+#include <vtkm/cont/Timer.h>
 #include <vtkm/worklet/DispatcherMapTopology.h>
 #include <vtkm/worklet/WorkletMapTopology.h>
 #include <vtkm/VectorAnalysis.h>
 
-#include <vtkm/worklet/MarchingCubesDataTables.h>
 
 #include <vtkm/exec/Assert.h>
 
+#include "HexahedronCase.h"
+#include "MarchingCubesTables.h"
+#include "PointGradients.h"
+
 namespace vtkm {
 namespace worklet {
+
+/// \brief Seconds spent in each phase of the isosurface filter
+///
+/// Each phase ends by synchronizing with the device, so the times include
+/// the kernels launched in that phase.
+struct IsosurfaceTimings
+{
+  IsosurfaceTimings() : Classify(0.), Scan(0.), Generate(0.) {}
+
+  IsosurfaceTimings& operator+=(const IsosurfaceTimings& other)
+  {
+    this->Classify += other.Classify;
+    this->Scan += other.Scan;
+    this->Generate += other.Generate;
+    return *this;
+  }
+
+  // Marching cubes case classification of every input cell
+  vtkm::Float64 Classify;
+  // Scan of the triangle counts, and the searches that compact the cells
+  // that generate triangles
+  vtkm::Float64 Scan;
+  // Triangle generation over the compacted cells
+  vtkm::Float64 Generate;
+};
+
+/// \brief State kept between runs of the isosurface filter on one batch of
+/// isovalues
+///
+/// A cell's marching cubes case only depends upon which side of each
+/// isovalue its points lie. If no point has crossed an isovalue since the
+/// previous run, the cells that generate triangles, and how many each
+/// generates, are unchanged, so the previous run's compaction is reused and
+/// only the triangles are regenerated from the new values.
+///
+/// If some points have crossed, and the points are laid out by element (each
+/// element owning PointsPerElement consecutive points, as PyFR's elements
+/// do), only the cells of the elements holding those points are classified
+/// again. Their triangle counts are spliced into the previous run's before
+/// the scan. If each element also owns CellsPerElement consecutive cells, its
+/// cells are found directly. Otherwise the cells must still be in element
+/// order, as the cells a clip keeps are, and the element of each cell is
+/// found once per cell set, from its first point.
+///
+/// Finding and splicing the dirty cells costs more per cell than
+/// classifying them all, so when more than DirtyCellFraction of the cells
+/// (a quarter by default) are dirty, all of them are classified instead.
+template<typename FieldType>
+struct IsosurfaceCoherence
+{
+  IsosurfaceCoherence() : Valid(false), NumberOfCells(0),
+                          PointsPerElement(0), CellsPerElement(0),
+                          DirtyCellFraction(0.25) {}
+
+  bool Valid;
+  std::vector<FieldType> Isovalues;
+  vtkm::Id NumberOfCells;
+  vtkm::Id PointsPerElement;
+  vtkm::Id CellsPerElement;
+  vtkm::Float64 DirtyCellFraction;
+  // The element of each cell, when the cells are not laid out by element
+  vtkm::cont::ArrayHandle<vtkm::Id> CellElements;
+  // Bit i of a point's state is set if its value exceeds isovalue i
+  vtkm::cont::ArrayHandle<vtkm::UInt8> PointStates;
+  // The number of triangles (at most 5) each cell generates for each
+  // isovalue of the batch, before the scan. Empty when the cells were
+  // classified through a block index.
+  vtkm::cont::ArrayHandle<vtkm::Vec<vtkm::UInt8,8> > TrianglesPerCell;
+  // For each isovalue, the cell generating each triangle, and the index of
+  // the first triangle generated by that cell
+  std::vector<vtkm::cont::ArrayHandle<vtkm::Id> > ValidCellIndices;
+  std::vector<vtkm::cont::ArrayHandle<vtkm::Id> > CellLowerBounds;
+};
+
+/// \brief Ranges of a field over blocks of cells, used to skip the cells
+/// that no isovalue crosses
+///
+/// The cells are grouped into blocks of whole elements, BlockSize
+/// consecutive cell ids each, and each block holds the minimum and maximum
+/// of the field over its elements' points. Since each element owns
+/// consecutive points, the ranges are a reduction of the field by block,
+/// without visiting the cells. Only the cells of blocks whose range contains
+/// an isovalue are classified, and isovalues outside the field's overall
+/// range are not contoured at all. Without the element layout there are no
+/// blocks, and only the field's overall range is kept. The index describes
+/// one solution of the field, so it only saves work when that solution is
+/// contoured more than once, e.g. with other isovalues.
+template<typename FieldType>
+struct IsosurfaceBlockIndex
+{
+  typedef vtkm::Vec<FieldType,2> Range;
+
+  IsosurfaceBlockIndex() : Valid(false), BlockSize(256), NumberOfCells(0) {}
+
+  bool Valid;
+  vtkm::Id BlockSize;
+  vtkm::Id NumberOfCells;
+  Range FieldRange;
+  // Empty if the cells are not laid out by element
+  vtkm::cont::ArrayHandle<Range> BlockRanges;
+};
+
+/// \brief A clip plane that is applied while classifying the cells
+///
+/// Only the cells with a point on the negative side of the plane (those that
+/// CrinkleClip keeps with this plane as its clip function) generate
+/// triangles. This fuses a preceding crinkle clip into the isosurface's
+/// classification pass, instead of classifying the cells once for the clip
+/// and contouring through its permutation of the cell set.
+template<typename FieldType>
+struct IsosurfaceClipPlane
+{
+  IsosurfaceClipPlane() : Enabled(false) {}
+
+  bool Enabled;
+  vtkm::Vec<FieldType,3> Origin;
+  vtkm::Vec<FieldType,3> Normal;
+};
+
 namespace internal {
 
 /// \brief Compute the isosurface for a uniform grid data set
@@ -82,15 +211,15 @@ public:
     typedef void ExecutionSignature(_1, _3);
     typedef _2 InputDomain;
 
-    typedef vtkm::cont::ArrayHandle<vtkm::Id> IdArrayHandle;
-    typedef typename IdArrayHandle::ExecutionTypes<DeviceAdapter>::PortalConst IdPortalType;
-    const IdPortalType VertexTable;
+    typedef typename MarchingCubesTables<DeviceAdapter>::PortalType
+      TablePortalType;
+    const TablePortalType NumTrianglesTable;
     vtkm::Vec<FieldType,NumberOfIsovalues> Isovalues;
 
     VTKM_CONT_EXPORT
-    ClassifyCell(const IdPortalType vertexTable,
+    ClassifyCell(const TablePortalType numTrianglesTable,
                  const FieldVec& isovalues) :
-      VertexTable(vertexTable)
+      NumTrianglesTable(numTrianglesTable)
     {
       for (unsigned i=0;i<NumberOfIsovalues;i++)
         this->Isovalues[i] = isovalues[i];
@@ -101,20 +230,462 @@ public:
     void operator()(const ScalarsVecType &scalars,
                     IdVec& numVertices) const
     {
-      const vtkm::Id mask[] = { 1, 2, 4, 8, 16, 32, 64, 128 };
+      // Gather the corners once for all of the isovalues
+      FieldType corners[8];
+      for (vtkm::IdComponent i = 0; i < 8; ++i)
+        corners[i] = static_cast<FieldType>(scalars[i]);
 
 #pragma unroll
       for (IsovalueCount iso=0;iso<NumberOfIsovalues;iso++)
+        numVertices[iso] = this->NumTrianglesTable.Get(
+          HexahedronCase(corners, this->Isovalues[iso]));
+    }
+  };
+
+  /// \brief Classify the cells that a clip plane keeps, leaving the others
+  /// without triangles
+  class ClassifyCellClipped : public ClassifyCell
+  {
+  public:
+    typedef typename ClassifyCell::IdVecType IdVecType;
+
+    typedef void ControlSignature(FieldInFrom<Scalar> scalars,
+                                  FieldInFrom<Vec3> coordinates,
+                                  TopologyIn topology,
+                                  FieldOut<IdVecType> numVertices);
+    typedef void ExecutionSignature(_1, _2, _4);
+    typedef _3 InputDomain;
+
+    typedef vtkm::Vec<FieldType,3> Vec3Type;
+    Vec3Type Origin;
+    Vec3Type Normal;
+
+    VTKM_CONT_EXPORT
+    ClassifyCellClipped(const typename ClassifyCell::TablePortalType
+                        numTrianglesTable,
+                        const FieldVec& isovalues,
+                        const IsosurfaceClipPlane<FieldType>& clipPlane) :
+      ClassifyCell(numTrianglesTable,isovalues),
+      Origin(clipPlane.Origin),
+      Normal(clipPlane.Normal) {}
+
+    template<typename ScalarsVecType,typename VectorsVecType>
+    VTKM_EXEC_EXPORT
+    void operator()(const ScalarsVecType &scalars,
+                    const VectorsVecType &pointCoords,
+                    IdVec& numVertices) const
+    {
+      bool kept = false;
+      for (vtkm::IdComponent i = 0; i < 8; ++i)
+        kept |= (vtkm::dot(Vec3Type(pointCoords[i]) - this->Origin,
+                           this->Normal) < FieldType(0));
+
+      if (kept)
+        this->ClassifyCell::operator()(scalars, numVertices);
+      else
+        numVertices = IdVec(0);
+    }
+  };
+
+  /// \brief Classify a tile of HexahedronTileSize consecutive cells of a
+  /// single type hexahedral cell set
+  ///
+  /// The corners of the tile are gathered once, corner by corner, through the
+  /// connectivity, and compared against each isovalue together (see
+  /// HexahedronTileCases). With a clip plane, the cells it discards are left
+  /// without triangles, as ClassifyCellClipped does.
+  template<typename FieldPortalType,typename ConnectivityPortalType,
+           typename CoordinatePortalType>
+  class ClassifyCellTile : public vtkm::worklet::WorkletMapField
+  {
+  public:
+    typedef void ControlSignature(FieldIn<IdType> tile);
+    typedef void ExecutionSignature(_1);
+    typedef _1 InputDomain;
+
+    typedef typename MarchingCubesTables<DeviceAdapter>::PortalType
+      TablePortalType;
+    typedef typename IdVecHandle::template ExecutionTypes<DeviceAdapter>
+      ::Portal IdVecPortalType;
+
+    typedef vtkm::Vec<FieldType,3> Vec3Type;
+
+    FieldPortalType Field;
+    ConnectivityPortalType Connectivity;
+    CoordinatePortalType Coordinates;
+    TablePortalType NumTrianglesTable;
+    vtkm::Vec<FieldType,NumberOfIsovalues> Isovalues;
+    bool Clipped;
+    Vec3Type Origin;
+    Vec3Type Normal;
+    vtkm::Id NumberOfCells;
+    IdVecPortalType NumVertices;
+
+    VTKM_CONT_EXPORT
+    ClassifyCellTile(FieldPortalType field,
+                     ConnectivityPortalType connectivity,
+                     CoordinatePortalType coordinates,
+                     const TablePortalType numTrianglesTable,
+                     const FieldVec& isovalues,
+                     const IsosurfaceClipPlane<FieldType>& clipPlane,
+                     vtkm::Id numberOfCells,
+                     IdVecPortalType numVertices) :
+      Field(field),
+      Connectivity(connectivity),
+      Coordinates(coordinates),
+      NumTrianglesTable(numTrianglesTable),
+      Clipped(clipPlane.Enabled),
+      Origin(clipPlane.Origin),
+      Normal(clipPlane.Normal),
+      NumberOfCells(numberOfCells),
+      NumVertices(numVertices)
+    {
+      for (unsigned i=0;i<NumberOfIsovalues;i++)
+        this->Isovalues[i] = isovalues[i];
+    }
+
+    VTKM_EXEC_EXPORT
+    void operator()(const vtkm::Id& tile) const
+    {
+      const vtkm::Id first = tile*HexahedronTileSize;
+      const vtkm::Id nTileCells =
+        vtkm::Min(vtkm::Id(HexahedronTileSize), this->NumberOfCells - first);
+
+      // The last tile is padded with its first cell, which is not written
+      FieldType corners[8][HexahedronTileSize];
+      bool kept[HexahedronTileSize];
+      for (vtkm::IdComponent c = 0; c < HexahedronTileSize; ++c)
         {
-        vtkm::Id caseId = 0;
+        const vtkm::Id cell = first + (c < nTileCells ? c : 0);
+        kept[c] = !this->Clipped;
         for (vtkm::IdComponent i = 0; i < 8; ++i)
-          caseId += (static_cast<FieldType>(scalars[i]) > this->Isovalues[iso])*mask[i];
-        numVertices[iso] = this->VertexTable.Get(caseId) / 3;
+          {
+          const vtkm::Id point = this->Connectivity.Get(8*cell + i);
+          corners[i][c] = static_cast<FieldType>(this->Field.Get(point));
+          if (this->Clipped)
+            kept[c] |= (vtkm::dot(Vec3Type(this->Coordinates.Get(point)) -
+                                  this->Origin, this->Normal) < FieldType(0));
+          }
         }
+
+      IdVec numVertices[HexahedronTileSize];
+      vtkm::IdComponent cases[HexahedronTileSize];
+      for (IsovalueCount iso=0;iso<NumberOfIsovalues;iso++)
+        {
+        HexahedronTileCases(corners, this->Isovalues[iso], cases);
+        for (vtkm::IdComponent c = 0; c < HexahedronTileSize; ++c)
+          numVertices[c][iso] =
+            (kept[c] ? this->NumTrianglesTable.Get(cases[c]) : 0);
+        }
+
+      for (vtkm::IdComponent c = 0; c < nTileCells; ++c)
+        this->NumVertices.Set(first + c, numVertices[c]);
+    }
+  };
+
+  /// \brief Count the cells of each block that may be crossed by one of the
+  /// isovalues: all of them if the block's range contains an isovalue, and
+  /// none otherwise
+  class CountCandidateCells : public vtkm::worklet::WorkletMapField
+  {
+  public:
+    typedef typename IsosurfaceBlockIndex<FieldType>::Range Range;
+
+    typedef void ControlSignature(FieldIn<vtkm::ListTagBase<Range> > range,
+                                  FieldOut<IdType> count);
+    typedef void ExecutionSignature(_1, _2, WorkIndex);
+    typedef _1 InputDomain;
+
+    vtkm::Vec<FieldType,NumberOfIsovalues> Isovalues;
+    vtkm::Id BlockSize;
+    vtkm::Id NumberOfCells;
+
+    VTKM_CONT_EXPORT
+    CountCandidateCells(const FieldVec& isovalues,
+                        vtkm::Id blockSize,
+                        vtkm::Id numberOfCells) : BlockSize(blockSize),
+                                                  NumberOfCells(numberOfCells)
+    {
+      for (unsigned i=0;i<NumberOfIsovalues;i++)
+        this->Isovalues[i] = isovalues[i];
+    }
+
+    VTKM_EXEC_EXPORT
+    void operator()(const Range& range,
+                    vtkm::Id& count,
+                    const vtkm::Id block) const
+    {
+      bool crossed = false;
+      for (IsovalueCount iso=0;iso<NumberOfIsovalues;iso++)
+        crossed |= (range[0] <= this->Isovalues[iso] &&
+                    this->Isovalues[iso] < range[1]);
+
+      const vtkm::Id remaining = this->NumberOfCells - block*this->BlockSize;
+      count = (crossed ? (remaining < this->BlockSize ? remaining :
+                          this->BlockSize) : 0);
+    }
+  };
+
+  /// \brief Expand the candidate blocks into the ids of their cells
+  class CandidateCellIds : public vtkm::worklet::WorkletMapField
+  {
+  public:
+    typedef void ControlSignature(FieldIn<IdType> block,
+                                  FieldOut<IdType> cellId);
+    typedef void ExecutionSignature(_1, _2, WorkIndex);
+    typedef _1 InputDomain;
+
+    typedef typename IdHandle::template ExecutionTypes<DeviceAdapter>
+      ::PortalConst IdPortalConstType;
+    IdPortalConstType CandidateOffsets;
+    vtkm::Id BlockSize;
+    vtkm::Id NumberOfCells;
+
+    VTKM_CONT_EXPORT
+    CandidateCellIds(IdPortalConstType candidateOffsets,
+                     vtkm::Id blockSize,
+                     vtkm::Id numberOfCells) :
+      CandidateOffsets(candidateOffsets),
+      BlockSize(blockSize),
+      NumberOfCells(numberOfCells) {}
+
+    VTKM_EXEC_EXPORT
+    void operator()(const vtkm::Id& block,
+                    vtkm::Id& cellId,
+                    const vtkm::Id index) const
+    {
+      // The offsets are an inclusive scan, so the block's first candidate is
+      // its offset less its number of cells
+      const vtkm::Id remaining = this->NumberOfCells - block*this->BlockSize;
+      const vtkm::Id size = (remaining < this->BlockSize ? remaining :
+                             this->BlockSize);
+      const vtkm::Id first = this->CandidateOffsets.Get(block) - size;
+      cellId = block*this->BlockSize + (index - first);
+    }
+  };
+
+  /// \brief Classify each point against the isovalues, and flag the points
+  /// whose classification differs from that of the previous run
+  class ClassifyPoints : public vtkm::worklet::WorkletMapField
+  {
+  public:
+    typedef vtkm::ListTagBase<vtkm::UInt8> StateType;
+
+    typedef void ControlSignature(FieldIn<Scalar> scalar,
+                                  FieldIn<StateType> previousState,
+                                  FieldOut<StateType> state,
+                                  FieldOut<IdType> crossed);
+    typedef void ExecutionSignature(_1, _2, _3, _4);
+    typedef _1 InputDomain;
+
+    vtkm::Vec<FieldType,NumberOfIsovalues> Isovalues;
+
+    VTKM_CONT_EXPORT
+    ClassifyPoints(const FieldVec& isovalues)
+    {
+      for (unsigned i=0;i<NumberOfIsovalues;i++)
+        this->Isovalues[i] = isovalues[i];
+    }
+
+    template<typename T>
+    VTKM_EXEC_EXPORT
+    void operator()(const T& scalar,
+                    const vtkm::UInt8& previousState,
+                    vtkm::UInt8& state,
+                    vtkm::Id& crossed) const
+    {
+      state = 0;
+      for (IsovalueCount iso=0;iso<NumberOfIsovalues;iso++)
+        state |= static_cast<vtkm::UInt8>(
+          (static_cast<FieldType>(scalar) > this->Isovalues[iso]) << iso);
+      crossed = (state != previousState ? 1 : 0);
+    }
+  };
+
+  typedef vtkm::Vec<vtkm::UInt8,8> TriangleCounts;
+  typedef vtkm::cont::ArrayHandle<TriangleCounts> TriangleCountsHandle;
+
+  /// \brief Convert the triangle counts of the classification to the bytes
+  /// kept between runs (see IsosurfaceCoherence), and back
+  struct PackTriangleCounts
+  {
+    VTKM_EXEC_CONT_EXPORT
+    TriangleCounts operator()(const IdVec& counts) const
+    {
+      TriangleCounts packed(0);
+      for (IsovalueCount iso=0;iso<NumberOfIsovalues;iso++)
+        packed[iso] = static_cast<vtkm::UInt8>(counts[iso]);
+      return packed;
+    }
+  };
+
+  struct UnpackTriangleCounts
+  {
+    VTKM_EXEC_CONT_EXPORT
+    IdVec operator()(const TriangleCounts& packed) const
+    {
+      IdVec counts;
+      for (IsovalueCount iso=0;iso<NumberOfIsovalues;iso++)
+        counts[iso] = packed[iso];
+      return counts;
+    }
+  };
+
+  /// \brief Map each crossed point to the element that holds it
+  class ElementOfPoint : public vtkm::worklet::WorkletMapField
+  {
+  public:
+    typedef void ControlSignature(FieldIn<IdType> point,
+                                  FieldOut<IdType> element);
+    typedef void ExecutionSignature(_1, _2);
+    typedef _1 InputDomain;
+
+    vtkm::Id PointsPerElement;
+
+    VTKM_CONT_EXPORT
+    ElementOfPoint(vtkm::Id pointsPerElement) :
+      PointsPerElement(pointsPerElement) {}
+
+    VTKM_EXEC_EXPORT
+    void operator()(const vtkm::Id& point, vtkm::Id& element) const
+    {
+      element = point/this->PointsPerElement;
+    }
+  };
+
+  /// \brief Expand the elements that hold crossed points into the ids of
+  /// their cells
+  class ElementCellIds : public vtkm::worklet::WorkletMapField
+  {
+  public:
+    typedef void ControlSignature(FieldIn<IdType> index,
+                                  FieldOut<IdType> cellId);
+    typedef void ExecutionSignature(_1, _2);
+    typedef _1 InputDomain;
+
+    typedef typename IdHandle::template ExecutionTypes<DeviceAdapter>
+      ::PortalConst IdPortalConstType;
+    IdPortalConstType Elements;
+    vtkm::Id CellsPerElement;
+
+    VTKM_CONT_EXPORT
+    ElementCellIds(IdPortalConstType elements,
+                   vtkm::Id cellsPerElement) :
+      Elements(elements),
+      CellsPerElement(cellsPerElement) {}
+
+    VTKM_EXEC_EXPORT
+    void operator()(const vtkm::Id& index, vtkm::Id& cellId) const
+    {
+      cellId = this->Elements.Get(index/this->CellsPerElement)*
+        this->CellsPerElement + index%this->CellsPerElement;
+    }
+  };
+
+  /// \brief Map each cell to the element that holds its points
+  class CellElement : public vtkm::worklet::WorkletMapPointToCell
+  {
+  public:
+    typedef void ControlSignature(TopologyIn topology,
+                                  FieldOut<IdType> element);
+    typedef void ExecutionSignature(FromIndices, _2);
+    typedef _1 InputDomain;
+
+    vtkm::Id PointsPerElement;
+
+    VTKM_CONT_EXPORT
+    CellElement(vtkm::Id pointsPerElement) :
+      PointsPerElement(pointsPerElement) {}
+
+    template<typename IndicesVecType>
+    VTKM_EXEC_EXPORT
+    void operator()(const IndicesVecType& indices, vtkm::Id& element) const
+    {
+      element = indices[0]/this->PointsPerElement;
+    }
+  };
+
+  /// \brief Count the cells of each dirty element, given the range of cells
+  /// in element order that it holds
+  class CellRangeLength : public vtkm::worklet::WorkletMapField
+  {
+  public:
+    typedef void ControlSignature(FieldIn<IdType> first,
+                                  FieldIn<IdType> last,
+                                  FieldOut<IdType> length);
+    typedef void ExecutionSignature(_1, _2, _3);
+    typedef _1 InputDomain;
+
+    VTKM_EXEC_EXPORT
+    void operator()(const vtkm::Id& first, const vtkm::Id& last,
+                    vtkm::Id& length) const
+    {
+      length = last - first;
+    }
+  };
+
+  /// \brief Expand the ranges of cells of the dirty elements into the ids
+  /// of their cells
+  class CellRangeIds : public vtkm::worklet::WorkletMapField
+  {
+  public:
+    typedef void ControlSignature(FieldIn<IdType> index,
+                                  FieldIn<IdType> range,
+                                  FieldOut<IdType> cellId);
+    typedef void ExecutionSignature(_1, _2, _3);
+    typedef _1 InputDomain;
+
+    typedef typename IdHandle::template ExecutionTypes<DeviceAdapter>
+      ::PortalConst IdPortalConstType;
+    IdPortalConstType Firsts;
+    IdPortalConstType Ends;
+    IdPortalConstType Lengths;
+
+    VTKM_CONT_EXPORT
+    CellRangeIds(IdPortalConstType firsts,
+                 IdPortalConstType ends,
+                 IdPortalConstType lengths) : Firsts(firsts),
+                                              Ends(ends),
+                                              Lengths(lengths) {}
+
+    VTKM_EXEC_EXPORT
+    void operator()(const vtkm::Id& index, const vtkm::Id& range,
+                    vtkm::Id& cellId) const
+    {
+      const vtkm::Id start = this->Ends.Get(range) - this->Lengths.Get(range);
+      cellId = this->Firsts.Get(range) + index - start;
     }
   };
 
-  /// \brief Compute isosurface vertices and scalars
+  /// \brief Splice the triangle counts of the reclassified cells into those
+  /// kept between runs
+  class SpliceTriangleCounts : public vtkm::worklet::WorkletMapField
+  {
+  public:
+    typedef vtkm::ListTagBase<IdVec> IdVecType;
+
+    typedef void ControlSignature(FieldIn<IdType> cellId,
+                                  FieldIn<IdVecType> counts);
+    typedef void ExecutionSignature(_1, _2);
+    typedef _1 InputDomain;
+
+    typedef typename TriangleCountsHandle::template
+      ExecutionTypes<DeviceAdapter>::Portal TriangleCountsPortalType;
+    TriangleCountsPortalType TrianglesPerCell;
+
+    VTKM_CONT_EXPORT
+    SpliceTriangleCounts(TriangleCountsPortalType trianglesPerCell) :
+      TrianglesPerCell(trianglesPerCell) {}
+
+    VTKM_EXEC_EXPORT
+    void operator()(const vtkm::Id& cellId, const IdVec& counts) const
+    {
+      this->TrianglesPerCell.Set(cellId, PackTriangleCounts()(counts));
+    }
+  };
+
+  /// \brief Compute isosurface vertices, normals and scalars
+  template<typename PointGradientType>
   class IsoSurfaceGenerate : public vtkm::worklet::WorkletMapPointToCell
   {
   public:
@@ -131,31 +702,36 @@ public:
     ScalarPortalType InterpolationWeight;
 
     typedef typename vtkm::cont::ArrayHandle<vtkm::Id> IdArrayHandle;
-    typedef typename IdArrayHandle::ExecutionTypes<DeviceAdapter>::PortalConst IdPortalConstType;
-    IdPortalConstType TriTable;
+    typedef typename MarchingCubesTables<DeviceAdapter>::PortalType
+      TablePortalType;
+    TablePortalType TriTable;
     typedef typename IdArrayHandle::ExecutionTypes<DeviceAdapter>::Portal IdPortalType;
     IdPortalType InterpolationLowId;
     IdPortalType InterpolationHighId;
 
     typedef typename vtkm::cont::ArrayHandle<vtkm::Vec<FieldType, 3> >::template ExecutionTypes<DeviceAdapter>::Portal VectorPortalType;
     VectorPortalType Vertices;
-    // VectorPortalType Normals;
+    VectorPortalType Normals;
+    PointGradientType PointGradient;
 
     template<typename V>
     VTKM_CONT_EXPORT
     IsoSurfaceGenerate(const FieldType ivalue,
-                       IdPortalConstType triTablePortal,
+                       TablePortalType triTablePortal,
                        ScalarPortalType interpolationWeight,
                        IdPortalType interpolationLowId,
                        IdPortalType interpolationHighId,
-                       const V &vertices) :
+                       const V &vertices,
+                       const V &normals,
+                       const PointGradientType &pointGradient) :
       Isovalue(ivalue),
       InterpolationWeight(interpolationWeight),
       TriTable(triTablePortal),
       InterpolationLowId(interpolationLowId),
       InterpolationHighId(interpolationHighId),
-      Vertices(vertices)//,
-      // Normals(normals)
+      Vertices(vertices),
+      Normals(normals),
+      PointGradient(pointGradient)
     {
     }
 
@@ -167,17 +743,12 @@ public:
                     const vtkm::Id inputLowerBounds,
                     const IdVecType &pointIds) const
     {
-      // Get data for this cell
-      const int verticesForEdge[] = { 0, 1, 1, 2, 3, 2, 0, 3,
-                                      4, 5, 5, 6, 7, 6, 4, 7,
-                                      0, 4, 1, 5, 2, 6, 3, 7 };
-
       // Compute the Marching Cubes case number for this cell
-      unsigned int cubeindex = 0;
-      const vtkm::Id mask[] = { 1, 2, 4, 8, 16, 32, 64, 128 };
-#pragma unroll
+      FieldType corners[8];
       for (vtkm::IdComponent i = 0; i < 8; ++i)
-        cubeindex += (static_cast<FieldType>(scalars[i]) > this->Isovalue)*mask[i];
+        corners[i] = static_cast<FieldType>(scalars[i]);
+      const vtkm::IdComponent cubeindex =
+        HexahedronCase(corners, this->Isovalue);
 
       // Interpolate for vertex positions and associated scalar values
       const vtkm::Id inputIteration = (outputCellId - inputLowerBounds);
@@ -187,28 +758,28 @@ public:
 
       for (vtkm::IdComponent v = 0; v < 3; v++)
       {
-        const vtkm::Id edge = this->TriTable.Get(cellOffset + v);
-        const int v0   = verticesForEdge[2*edge];
-        const int v1   = verticesForEdge[2*edge + 1];
-        const FieldType t  = (this->Isovalue - scalars[v0]) / (scalars[v1] - scalars[v0]);
+        const vtkm::IdComponent edge = this->TriTable.Get(cellOffset + v);
+        int v0, v1;
+        HexahedronEdgeVertices(edge, v0, v1);
+        const FieldType t  = (this->Isovalue - corners[v0]) / (corners[v1] - corners[v0]);
         this->Vertices.Set(outputVertId + v,
                            vtkm::Lerp(pointCoords[v0], pointCoords[v1], t));
         this->InterpolationWeight.Set(outputVertId + v, t);
         this->InterpolationLowId.Set(outputVertId + v, pointIds[v0]);
         this->InterpolationHighId.Set(outputVertId + v, pointIds[v1]);
-      }
-
-      //disabling normal calculation as it is not needed
-      // vtkm::Vec<FieldType, 3> vertex0 = this->Vertices.Get(outputVertId + 0);
-      // vtkm::Vec<FieldType, 3> vertex1 = this->Vertices.Get(outputVertId + 1);
-      // vtkm::Vec<FieldType, 3> vertex2 = this->Vertices.Get(outputVertId + 2);
 
-      // vtkm::Vec<FieldType, 3> curNorm = vtkm::Cross(vertex1-vertex0,
-      //                                               vertex2-vertex0);
-      // vtkm::Normalize(curNorm);
-      // this->Normals.Set(outputVertId + 0, curNorm);
-      // this->Normals.Set(outputVertId + 1, curNorm);
-      // this->Normals.Set(outputVertId + 2, curNorm);
+        // The normal is the scalar gradient at the crossing, interpolated
+        // from the edge's points and pointing towards decreasing values.
+        // The point gradients do not depend upon the cell, so every cell
+        // sharing the edge gives its vertex the same normal.
+        vtkm::Vec<FieldType,3> normal =
+          vtkm::Lerp(this->PointGradient(pointIds[v0]),
+                     this->PointGradient(pointIds[v1]), t);
+        const FieldType magnitude = vtkm::Magnitude(normal);
+        if (magnitude > FieldType(0))
+          normal = (FieldType(-1)/magnitude)*normal;
+        this->Normals.Set(outputVertId + v, normal);
+      }
     }
   };
 
@@ -258,6 +829,277 @@ public:
   public:
   IsosurfaceFilterHexahedra() {}
 
+  // Compute the number of triangles each cell generates for each isovalue,
+  // scanned in place on the device. Only the scan's total is read back.
+  template<class CellSetType,typename StorageTag>
+  static IdVec ClassifyCells(const FieldVec& isovalues,
+                             const CellSetType& cellSet,
+                             const vtkm::cont::CoordinateSystem& coordinateSystem,
+                             const vtkm::cont::ArrayHandle<FieldType,StorageTag>& isoField,
+                             const IsosurfaceClipPlane<FieldType>& clipPlane,
+                             IdVecHandle& numOutputTrisPerCell,
+                             IsosurfaceTimings& timings)
+  {
+    CountTriangles(isovalues,cellSet,coordinateSystem,isoField,clipPlane,
+                   numOutputTrisPerCell,timings);
+    return ScanTriangleCounts(numOutputTrisPerCell,numOutputTrisPerCell,
+                              timings);
+  }
+
+  // Compute the number of triangles each cell generates for each isovalue
+  template<class CellSetType,typename StorageTag>
+  static void CountTriangles(const FieldVec& isovalues,
+                             const CellSetType& cellSet,
+                             const vtkm::cont::CoordinateSystem& coordinateSystem,
+                             const vtkm::cont::ArrayHandle<FieldType,StorageTag>& isoField,
+                             const IsosurfaceClipPlane<FieldType>& clipPlane,
+                             IdVecHandle& numOutputTrisPerCell,
+                             IsosurfaceTimings& timings)
+  {
+    vtkm::cont::Timer<DeviceAdapter> timer;
+
+    if (!CountTrianglesTiled(isovalues,cellSet,coordinateSystem,isoField,
+                             clipPlane,numOutputTrisPerCell))
+      CountTrianglesPerCell(isovalues,cellSet,coordinateSystem,isoField,
+                            clipPlane,numOutputTrisPerCell);
+    timings.Classify += timer.GetElapsedTime();
+  }
+
+  // Count the triangles of the cells of a single type hexahedral cell set in
+  // tiles (see ClassifyCellTile). This is only done on the CPU adapters; on
+  // CUDA, where a thread classifies each cell, and for other cell sets, it
+  // returns false and ClassifyCell is used instead.
+#ifdef PYFR_TILED_CLASSIFY
+  template<typename ConnectivityStorageTag,typename StorageTag>
+  static bool CountTrianglesTiled(
+    const FieldVec& isovalues,
+    const vtkm::cont::CellSetSingleType<ConnectivityStorageTag>& cellSet,
+    const vtkm::cont::CoordinateSystem& coordinateSystem,
+    const vtkm::cont::ArrayHandle<FieldType,StorageTag>& isoField,
+    const IsosurfaceClipPlane<FieldType>& clipPlane,
+    IdVecHandle& numOutputTrisPerCell)
+  {
+    typedef vtkm::cont::ArrayHandle<vtkm::Id,ConnectivityStorageTag>
+      ConnectivityHandle;
+    typedef vtkm::cont::ArrayHandle<vtkm::Vec<FieldType,3> > CoordinateHandle;
+    typedef ClassifyCellTile<
+      typename vtkm::cont::ArrayHandle<FieldType,StorageTag>::template
+        ExecutionTypes<DeviceAdapter>::PortalConst,
+      typename ConnectivityHandle::template
+        ExecutionTypes<DeviceAdapter>::PortalConst,
+      typename CoordinateHandle::template
+        ExecutionTypes<DeviceAdapter>::PortalConst> ClassifyWorklet;
+
+    const vtkm::Id nCells = cellSet.GetNumberOfCells();
+    const ConnectivityHandle& connectivity =
+      cellSet.GetConnectivityArray(vtkm::TopologyElementTagPoint(),
+                                   vtkm::TopologyElementTagCell());
+    if (nCells == 0 || connectivity.GetNumberOfValues() != 8*nCells)
+      return false;
+
+    // The coordinates are only read to evaluate a clip plane
+    CoordinateHandle coords;
+    if (clipPlane.Enabled)
+      coords = coordinateSystem.GetData()
+        .CastToArrayHandle(vtkm::Vec<FieldType,3>(),
+                           vtkm::cont::StorageTagBasic());
+    else
+      coords.Allocate(0);
+
+    const vtkm::Id nTiles =
+      (nCells + HexahedronTileSize - 1)/HexahedronTileSize;
+    ClassifyWorklet classify(
+      isoField.PrepareForInput(DeviceAdapter()),
+      connectivity.PrepareForInput(DeviceAdapter()),
+      coords.PrepareForInput(DeviceAdapter()),
+      MarchingCubesTables<DeviceAdapter>::Get().GetNumTrianglesTable(),
+      isovalues,
+      clipPlane,
+      nCells,
+      numOutputTrisPerCell.PrepareForOutput(nCells,DeviceAdapter()));
+    vtkm::worklet::DispatcherMapField<ClassifyWorklet,DeviceAdapter>(classify)
+      .Invoke(vtkm::cont::ArrayHandleCounting<vtkm::Id>(0,1,nTiles));
+    return true;
+  }
+#endif
+
+  template<class CellSetType,typename StorageTag>
+  static bool CountTrianglesTiled(
+    const FieldVec&,
+    const CellSetType&,
+    const vtkm::cont::CoordinateSystem&,
+    const vtkm::cont::ArrayHandle<FieldType,StorageTag>&,
+    const IsosurfaceClipPlane<FieldType>&,
+    IdVecHandle&)
+  {
+    return false;
+  }
+
+  // Count the triangles of each cell with a thread per cell, as on CUDA
+  template<class CellSetType,typename StorageTag>
+  static void CountTrianglesPerCell(
+    const FieldVec& isovalues,
+    const CellSetType& cellSet,
+    const vtkm::cont::CoordinateSystem& coordinateSystem,
+    const vtkm::cont::ArrayHandle<FieldType,StorageTag>& isoField,
+    const IsosurfaceClipPlane<FieldType>& clipPlane,
+    IdVecHandle& numOutputTrisPerCell)
+  {
+    // The Marching Cubes case tables are only transferred on first use
+    MarchingCubesTables<DeviceAdapter>& tables =
+      MarchingCubesTables<DeviceAdapter>::Get();
+
+    // Call the ClassifyCell functor to compute the Marching Cubes case numbers
+    // for each cell, and the number of vertices to be generated
+    if (clipPlane.Enabled)
+      {
+      ClassifyCellClipped classifyCell(
+        tables.GetNumTrianglesTable(),
+        isovalues,
+        clipPlane);
+
+      vtkm::worklet::DispatcherMapTopology<ClassifyCellClipped,
+        DeviceAdapter>(classifyCell).Invoke(isoField,
+                                            coordinateSystem.GetData(),
+                                            cellSet,
+                                            numOutputTrisPerCell);
+      }
+    else
+      {
+      ClassifyCell classifyCell(
+        tables.GetNumTrianglesTable(),
+        isovalues);
+
+      typedef typename vtkm::worklet::DispatcherMapTopology<
+                                        ClassifyCell,
+                                        DeviceAdapter> ClassifyCellDispatcher;
+      ClassifyCellDispatcher classifyCellDispatcher(classifyCell);
+
+      classifyCellDispatcher.Invoke(isoField,
+                                    cellSet,
+                                    numOutputTrisPerCell);
+      }
+  }
+
+  // Scan the triangle counts on the device, in place if the arrays are the
+  // same. Only the scan's total is read back.
+  template<typename CountStorageTag>
+  static IdVec ScanTriangleCounts(
+    const vtkm::cont::ArrayHandle<IdVec,CountStorageTag>& counts,
+    IdVecHandle& numOutputTrisPerCell,
+    IsosurfaceTimings& timings)
+  {
+    typedef typename vtkm::cont::DeviceAdapterAlgorithm<DeviceAdapter> DeviceAlgorithms;
+
+    vtkm::cont::Timer<DeviceAdapter> timer;
+
+    IdVec numOutputCells(0);
+    if (counts.GetNumberOfValues() > 0)
+      numOutputCells =
+        DeviceAlgorithms::ScanInclusive(counts,numOutputTrisPerCell);
+    timings.Scan += timer.GetElapsedTime();
+    return numOutputCells;
+  }
+
+  // Whether each element owns CellsPerElement consecutive cells of the
+  // cell set (see IsosurfaceCoherence)
+  static bool HasCellLayout(const IsosurfaceCoherence<FieldType>& coherence,
+                            vtkm::Id nPoints,
+                            vtkm::Id nCells)
+  {
+    const vtkm::Id pointsPerElement = coherence.PointsPerElement;
+    const vtkm::Id cellsPerElement = coherence.CellsPerElement;
+    return (pointsPerElement > 0 && cellsPerElement > 0 &&
+            nPoints % pointsPerElement == 0 &&
+            (nPoints/pointsPerElement)*cellsPerElement == nCells);
+  }
+
+  // Find the element of each cell of a cell set whose cells are in element
+  // order, but not laid out by element, e.g. because a clip has dropped some
+  template<class CellSetType>
+  static void FindCellElements(IsosurfaceCoherence<FieldType>& coherence,
+                               const CellSetType& cellSet,
+                               vtkm::Id nPoints)
+  {
+    coherence.CellElements = IdHandle();
+    if (coherence.PointsPerElement <= 0 ||
+        nPoints % coherence.PointsPerElement != 0 ||
+        HasCellLayout(coherence,nPoints,cellSet.GetNumberOfCells()))
+      return;
+
+    vtkm::worklet::DispatcherMapTopology<CellElement,DeviceAdapter>(
+      CellElement(coherence.PointsPerElement))
+      .Invoke(cellSet,coherence.CellElements);
+  }
+
+  // The cells of the elements that hold the crossed points, if the points
+  // are laid out by element and few enough cells are dirty to be classified
+  // again (see IsosurfaceCoherence)
+  static bool DirtyCells(const IsosurfaceCoherence<FieldType>& coherence,
+                         const IdHandle& crossed,
+                         vtkm::Id nCells,
+                         IdHandle& dirtyCells)
+  {
+    typedef typename vtkm::cont::DeviceAdapterAlgorithm<DeviceAdapter> DeviceAlgorithms;
+
+    const vtkm::Id nPoints = crossed.GetNumberOfValues();
+    const vtkm::Id pointsPerElement = coherence.PointsPerElement;
+    const vtkm::Id cellsPerElement = coherence.CellsPerElement;
+    const bool cellLayout = HasCellLayout(coherence,nPoints,nCells);
+    if (pointsPerElement <= 0 ||
+        coherence.TrianglesPerCell.GetNumberOfValues() != nCells ||
+        (!cellLayout &&
+         coherence.CellElements.GetNumberOfValues() != nCells))
+      return false;
+
+    // The crossed points are in increasing order, and so are their elements
+    IdHandle crossedPoints;
+    DeviceAlgorithms::StreamCompact(crossed, crossedPoints);
+    IdHandle elements;
+    vtkm::worklet::DispatcherMapField<ElementOfPoint,DeviceAdapter>(
+      ElementOfPoint(pointsPerElement)).Invoke(crossedPoints,elements);
+    DeviceAlgorithms::Unique(elements);
+
+    if (cellLayout)
+      {
+      const vtkm::Id nDirty = elements.GetNumberOfValues()*cellsPerElement;
+      if (nDirty > coherence.DirtyCellFraction*nCells)
+        return false;
+
+      vtkm::worklet::DispatcherMapField<ElementCellIds,DeviceAdapter>(
+        ElementCellIds(elements.PrepareForInput(DeviceAdapter()),
+                       cellsPerElement))
+        .Invoke(vtkm::cont::ArrayHandleCounting<vtkm::Id>(0, 1, nDirty),
+                dirtyCells);
+      return true;
+      }
+
+    // The cells of each element are a range of the cells in element order,
+    // which may be empty if the element's cells were all dropped
+    IdHandle firsts;
+    IdHandle lasts;
+    DeviceAlgorithms::LowerBounds(coherence.CellElements,elements,firsts);
+    DeviceAlgorithms::UpperBounds(coherence.CellElements,elements,lasts);
+    IdHandle lengths;
+    vtkm::worklet::DispatcherMapField<CellRangeLength,DeviceAdapter>()
+      .Invoke(firsts,lasts,lengths);
+    IdHandle ends;
+    const vtkm::Id nDirty = DeviceAlgorithms::ScanInclusive(lengths,ends);
+    if (nDirty > coherence.DirtyCellFraction*nCells)
+      return false;
+
+    // Find the range of each dirty cell, and its offset in the range
+    vtkm::cont::ArrayHandleCounting<vtkm::Id> indices(0, 1, nDirty);
+    IdHandle ranges;
+    DeviceAlgorithms::UpperBounds(ends,indices,ranges);
+    vtkm::worklet::DispatcherMapField<CellRangeIds,DeviceAdapter>(
+      CellRangeIds(firsts.PrepareForInput(DeviceAdapter()),
+                   ends.PrepareForInput(DeviceAdapter()),
+                   lengths.PrepareForInput(DeviceAdapter())))
+      .Invoke(indices,ranges,dirtyCells);
+    return true;
+  }
+
   template<class CellSetType,typename StorageTag,typename CoordinateType>
   static void Run(const FieldVec& isovalues,
                   const CellSetType& cellSet,
@@ -267,48 +1109,220 @@ public:
                   std::vector<vtkm::cont::ArrayHandle<vtkm::Vec<CoordinateType,3> > >& normals,
                   FieldHandleVec& interpolationWeights,
                   IdHandleVec& interpolationLowIds,
-                  IdHandleVec& interpolationHighIds)
+                  IdHandleVec& interpolationHighIds,
+                  IsosurfaceTimings& timings,
+                  IsosurfaceCoherence<FieldType>* coherence,
+                  const IsosurfaceBlockIndex<FieldType>* blockIndex,
+                  const IsosurfaceClipPlane<FieldType>& clipPlane,
+                  const PointGradients<FieldType,DeviceAdapter>& pointGradients)
   {
     typedef typename vtkm::cont::DeviceAdapterAlgorithm<DeviceAdapter> DeviceAlgorithms;
 
-    // Set up the Marching Cubes case tables
-    IdHandle vertexTableArray =
-    vtkm::cont::make_ArrayHandle(vtkm::worklet::internal::numVerticesTable,256);
+    vtkm::cont::Timer<DeviceAdapter> timer;
+
+    // With coherence, classify the points first. If none has crossed an
+    // isovalue since the previous run, the cell classification, scan and
+    // compaction are skipped in favor of the previous run's. If few have,
+    // only the cells of their elements are classified, and spliced into the
+    // previous run's triangle counts.
+    bool reuse = false;
+    bool splice = false;
+    IdHandle dirtyCells;
+    if (coherence)
+      {
+      const vtkm::Id nPoints = isoField.GetNumberOfValues();
+      const bool comparable =
+        (coherence->Valid &&
+         coherence->Isovalues == isovalues &&
+         coherence->NumberOfCells == cellSet.GetNumberOfCells() &&
+         coherence->PointStates.GetNumberOfValues() == nPoints);
+
+      typedef typename vtkm::worklet::DispatcherMapField<ClassifyPoints,
+        DeviceAdapter> ClassifyPointsDispatcher;
+      ClassifyPointsDispatcher classifyPointsDispatcher(
+        ClassifyPoints(isovalues));
+
+      vtkm::cont::ArrayHandle<vtkm::UInt8> pointStates;
+      IdHandle crossed;
+      if (comparable)
+        {
+        classifyPointsDispatcher.Invoke(isoField,
+                                        coherence->PointStates,
+                                        pointStates,
+                                        crossed);
+        reuse = (DeviceAlgorithms::Reduce(crossed, vtkm::Id(0)) == 0);
+        splice = (!reuse && DirtyCells(*coherence,
+                                       crossed,
+                                       cellSet.GetNumberOfCells(),
+                                       dirtyCells));
+        }
+      else
+        {
+        classifyPointsDispatcher.Invoke(
+          isoField,
+          vtkm::cont::ArrayHandleConstant<vtkm::UInt8>(0, nPoints),
+          pointStates,
+          crossed);
+        FindCellElements(*coherence,cellSet,nPoints);
+        }
+      timings.Classify += timer.GetElapsedTime();
+      timer.Reset();
 
-    // Call the ClassifyCell functor to compute the Marching Cubes case numbers
-    // for each cell, and the number of vertices to be generated
-    ClassifyCell classifyCell(vertexTableArray.PrepareForInput(DeviceAdapter()),
-                              isovalues);
+      if (!reuse)
+        {
+        coherence->Valid = true;
+        coherence->Isovalues = isovalues;
+        coherence->NumberOfCells = cellSet.GetNumberOfCells();
+        coherence->PointStates = pointStates;
+        // NB: Cannot call resize to increase the lengths of vectors of array
+        // handles!
+        coherence->ValidCellIndices.clear();
+        coherence->CellLowerBounds.clear();
+        for (IsovalueCount iso=0;iso<NumberOfIsovalues;iso++)
+          {
+          coherence->ValidCellIndices.push_back(IdHandle());
+          coherence->CellLowerBounds.push_back(IdHandle());
+          }
+        }
+      }
 
-    typedef typename vtkm::worklet::DispatcherMapTopology<
-                                      ClassifyCell,
-                                      DeviceAdapter> ClassifyCellDispatcher;
-    ClassifyCellDispatcher classifyCellDispatcher(classifyCell);
+    // With a block index, isovalues outside of the field's overall range
+    // generate nothing. Otherwise, only the cells of the blocks that the
+    // isovalues cross are classified, and the classified cells are mapped
+    // back to the cell set's ids afterwards.
+    const bool indexed =
+      (!reuse && !splice &&
+       blockIndex && blockIndex->Valid &&
+       blockIndex->NumberOfCells > 0 &&
+       blockIndex->NumberOfCells == cellSet.GetNumberOfCells());
+    bool inRange = true;
+    if (indexed)
+      {
+      inRange = false;
+      for (IsovalueCount iso=0;iso<NumberOfIsovalues;iso++)
+        inRange |= (blockIndex->FieldRange[0] <= isovalues[iso] &&
+                    isovalues[iso] < blockIndex->FieldRange[1]);
+      }
+    const bool useBlockIndex =
+      (indexed && inRange && blockIndex->BlockRanges.GetNumberOfValues() > 0);
+    IdHandle candidateCells;
 
     IdVecHandle numOutputTrisPerCell;
-    classifyCellDispatcher.Invoke(isoField,
-                                  cellSet,
-                                  numOutputTrisPerCell);
-
-    IdVecHandle local;
-    DeviceAlgorithms::Copy(numOutputTrisPerCell,local);
-
-    typename IdVecHandle::PortalConstControl portal = local.GetPortalConstControl();
-    //now manually compute the sum
-    IdVec sum = portal.Get(0);
-    for( std::size_t i = 1; i < local.GetNumberOfValues(); ++i)
+    IdVec NumOutputCells(0);
+    if (reuse)
       {
-      for (unsigned j=0;j<NumberOfIsovalues;j++)
-        sum[j] += portal.Get(i)[j];
+      for (IsovalueCount iso=0;iso<NumberOfIsovalues;iso++)
+        NumOutputCells[iso] =
+          coherence->ValidCellIndices[iso].GetNumberOfValues();
       }
-
-    // Compute the number of valid input cells and those ids
-    IdVec NumOutputCells =
-      DeviceAlgorithms::ScanInclusive(numOutputTrisPerCell,
-                                      numOutputTrisPerCell);
-
-    vtkm::cont::ArrayHandle<vtkm::Id> triangleTableArray =
-      vtkm::cont::make_ArrayHandle(vtkm::worklet::internal::triTable,256*16);
+    else if (splice)
+      {
+      IdVecHandle dirtyCounts;
+      CountTriangles(isovalues,
+                     vtkm::cont::CellSetPermutation<IdHandle,CellSetType>(
+                       dirtyCells,cellSet),
+                     coordinateSystem,
+                     isoField,
+                     clipPlane,
+                     dirtyCounts,
+                     timings);
+      timer.Reset();
+      vtkm::worklet::DispatcherMapField<SpliceTriangleCounts,DeviceAdapter>(
+        SpliceTriangleCounts(
+          coherence->TrianglesPerCell.PrepareForInPlace(DeviceAdapter())))
+        .Invoke(dirtyCells,dirtyCounts);
+      timings.Classify += timer.GetElapsedTime();
+
+      NumOutputCells =
+        ScanTriangleCounts(
+          vtkm::cont::ArrayHandleTransform<IdVec,TriangleCountsHandle,
+            UnpackTriangleCounts>(coherence->TrianglesPerCell),
+          numOutputTrisPerCell,
+          timings);
+      }
+    else if (!inRange)
+      {
+      // Nothing is classified, so there are no counts to splice into
+      if (coherence)
+        coherence->TrianglesPerCell = TriangleCountsHandle();
+      }
+    else if (useBlockIndex)
+      {
+      // The counts of the candidates alone cannot be spliced into
+      if (coherence)
+        coherence->TrianglesPerCell = TriangleCountsHandle();
+
+      CountCandidateCells countCandidates(isovalues,
+                                          blockIndex->BlockSize,
+                                          blockIndex->NumberOfCells);
+      IdHandle candidateCounts;
+      vtkm::worklet::DispatcherMapField<CountCandidateCells,DeviceAdapter>(
+        countCandidates).Invoke(blockIndex->BlockRanges,candidateCounts);
+
+      IdHandle candidateOffsets;
+      const vtkm::Id nCandidates =
+        DeviceAlgorithms::ScanInclusive(candidateCounts,candidateOffsets);
+      if (nCandidates > 0)
+        {
+        IdHandle candidateBlocks;
+        DeviceAlgorithms::UpperBounds(
+          candidateOffsets,
+          vtkm::cont::ArrayHandleCounting<vtkm::Id>(0, 1, nCandidates),
+          candidateBlocks);
+
+        CandidateCellIds candidateCellIds(
+          candidateOffsets.PrepareForInput(DeviceAdapter()),
+          blockIndex->BlockSize,
+          blockIndex->NumberOfCells);
+        vtkm::worklet::DispatcherMapField<CandidateCellIds,DeviceAdapter>(
+          candidateCellIds).Invoke(candidateBlocks,candidateCells);
+        }
+      timings.Scan += timer.GetElapsedTime();
+      timer.Reset();
+
+      if (nCandidates > 0)
+        NumOutputCells =
+          ClassifyCells(isovalues,
+                        vtkm::cont::CellSetPermutation<IdHandle,CellSetType>(
+                          candidateCells,cellSet),
+                        coordinateSystem,
+                        isoField,
+                        clipPlane,
+                        numOutputTrisPerCell,
+                        timings);
+      }
+    else if (coherence)
+      {
+      // Keep the counts for the next run to splice into
+      CountTriangles(isovalues,
+                     cellSet,
+                     coordinateSystem,
+                     isoField,
+                     clipPlane,
+                     numOutputTrisPerCell,
+                     timings);
+      timer.Reset();
+      DeviceAlgorithms::Copy(
+        vtkm::cont::ArrayHandleTransform<TriangleCounts,IdVecHandle,
+          PackTriangleCounts>(numOutputTrisPerCell),
+        coherence->TrianglesPerCell);
+      timings.Classify += timer.GetElapsedTime();
+
+      NumOutputCells = ScanTriangleCounts(numOutputTrisPerCell,
+                                          numOutputTrisPerCell,
+                                          timings);
+      }
+    else
+      NumOutputCells = ClassifyCells(isovalues,
+                                     cellSet,
+                                     coordinateSystem,
+                                     isoField,
+                                     clipPlane,
+                                     numOutputTrisPerCell,
+                                     timings);
+
+    MarchingCubesTables<DeviceAdapter>& tables =
+      MarchingCubesTables<DeviceAdapter>::Get();
 
     SingleId singleId;
     for (IsovalueCount iso=0;iso<NumberOfIsovalues;iso++)
@@ -319,60 +1333,136 @@ public:
         interpolationLowIds[iso].Shrink(0);
         interpolationHighIds[iso].Shrink(0);
         vertices[iso].Shrink(0);
-        // normals[iso].Shrink(0);
+        normals[iso].Shrink(0);
         continue;
         }
 
-      singleId.SetIsovalue(iso);
-      typename SingleId::Array numOutputTrisPerCell_single(numOutputTrisPerCell,
-                                                           singleId);
-
+      timer.Reset();
       IdHandle validCellIndicesArray;
       IdHandle inputCellIterationNumber;
-      vtkm::cont::ArrayHandleCounting<vtkm::Id> validCellCountImplicitArray(0, 1, NumOutputCells[iso]);
-
-      DeviceAlgorithms::UpperBounds(numOutputTrisPerCell_single,
-                                    validCellCountImplicitArray,
-                                    validCellIndicesArray);
-
-      // Compute for each output triangle what iteration of the input cell
-      // generates it
-      DeviceAlgorithms::LowerBounds(validCellIndicesArray,
-                                    validCellIndicesArray,
-                                    inputCellIterationNumber);
+      if (reuse)
+        {
+        validCellIndicesArray = coherence->ValidCellIndices[iso];
+        inputCellIterationNumber = coherence->CellLowerBounds[iso];
+        }
+      else
+        {
+        singleId.SetIsovalue(iso);
+        typename SingleId::Array numOutputTrisPerCell_single(numOutputTrisPerCell,
+                                                             singleId);
+
+        vtkm::cont::ArrayHandleCounting<vtkm::Id> validCellCountImplicitArray(0, 1, NumOutputCells[iso]);
+
+        DeviceAlgorithms::UpperBounds(numOutputTrisPerCell_single,
+                                      validCellCountImplicitArray,
+                                      validCellIndicesArray);
+
+        // Map the classified candidates back to the cell set's ids. The
+        // candidates are in increasing order, so the ids remain sorted.
+        if (useBlockIndex)
+          {
+          IdHandle cellIds;
+          DeviceAlgorithms::Copy(
+            vtkm::cont::ArrayHandlePermutation<IdHandle,IdHandle>(
+              validCellIndicesArray,candidateCells),
+            cellIds);
+          validCellIndicesArray = cellIds;
+          }
+
+        // Compute for each output triangle what iteration of the input cell
+        // generates it
+        DeviceAlgorithms::LowerBounds(validCellIndicesArray,
+                                      validCellIndicesArray,
+                                      inputCellIterationNumber);
+        if (coherence)
+          {
+          coherence->ValidCellIndices[iso] = validCellIndicesArray;
+          coherence->CellLowerBounds[iso] = inputCellIterationNumber;
+          }
+        }
+      timings.Scan += timer.GetElapsedTime();
+      timer.Reset();
 
       // Generate a single triangle per cell
-      const vtkm::Id numTotalVertices = NumOutputCells[iso] * 3;
-
-      IsoSurfaceGenerate isosurface(
-        isovalues[iso],
-        triangleTableArray.PrepareForInput(DeviceAdapter()),
-        interpolationWeights[iso].PrepareForOutput(numTotalVertices,
-                                                   DeviceAdapter()),
-        interpolationLowIds[iso].PrepareForOutput(numTotalVertices,
-                                                  DeviceAdapter()),
-        interpolationHighIds[iso].PrepareForOutput(numTotalVertices,
-                                                   DeviceAdapter()),
-        vertices[iso].PrepareForOutput(numTotalVertices, DeviceAdapter())// ,
-        // normals[iso].PrepareForOutput(numTotalVertices, DeviceAdapter())
-        );
-
-
       vtkm::cont::CellSetPermutation<vtkm::cont::ArrayHandle<vtkm::Id>,
         CellSetType> cellPermutation(validCellIndicesArray,
                                      cellSet);
 
-      typedef typename vtkm::worklet::DispatcherMapTopology< IsoSurfaceGenerate,
-        DeviceAdapter> IsoSurfaceDispatcher;
-      IsoSurfaceDispatcher isosurfaceDispatcher(isosurface);
-      isosurfaceDispatcher.Invoke(isoField,
-                                  coordinateSystem.GetData(),
-                                  inputCellIterationNumber,
-                                  cellPermutation);
+      if (pointGradients.UsesBasis())
+        GenerateTriangles(isovalues[iso],
+                          tables,
+                          cellPermutation,
+                          coordinateSystem,
+                          isoField,
+                          inputCellIterationNumber,
+                          NumOutputCells[iso],
+                          vertices[iso],
+                          normals[iso],
+                          interpolationWeights[iso],
+                          interpolationLowIds[iso],
+                          interpolationHighIds[iso],
+                          pointGradients.PrepareBasisGradient(isoField));
+      else
+        GenerateTriangles(isovalues[iso],
+                          tables,
+                          cellPermutation,
+                          coordinateSystem,
+                          isoField,
+                          inputCellIterationNumber,
+                          NumOutputCells[iso],
+                          vertices[iso],
+                          normals[iso],
+                          interpolationWeights[iso],
+                          interpolationLowIds[iso],
+                          interpolationHighIds[iso],
+                          pointGradients.PrepareStoredGradient());
+      timings.Generate += timer.GetElapsedTime();
 
       }
   }
 
+  template<class CellSetType,typename StorageTag,typename CoordinateType,
+           typename PointGradientType>
+  static void GenerateTriangles(
+    const FieldType isovalue,
+    const MarchingCubesTables<DeviceAdapter>& tables,
+    const CellSetType& cellSet,
+    const vtkm::cont::CoordinateSystem& coordinateSystem,
+    const vtkm::cont::ArrayHandle<FieldType,StorageTag>& isoField,
+    const IdHandle& inputCellIterationNumber,
+    const vtkm::Id numOutputCells,
+    vtkm::cont::ArrayHandle<vtkm::Vec<CoordinateType,3> >& vertices,
+    vtkm::cont::ArrayHandle<vtkm::Vec<CoordinateType,3> >& normals,
+    vtkm::cont::ArrayHandle<FieldType>& interpolationWeights,
+    IdHandle& interpolationLowIds,
+    IdHandle& interpolationHighIds,
+    const PointGradientType& pointGradient)
+  {
+    const vtkm::Id numTotalVertices = numOutputCells * 3;
+
+    IsoSurfaceGenerate<PointGradientType> isosurface(
+      isovalue,
+      tables.GetTriangleTable(),
+      interpolationWeights.PrepareForOutput(numTotalVertices,
+                                            DeviceAdapter()),
+      interpolationLowIds.PrepareForOutput(numTotalVertices,
+                                           DeviceAdapter()),
+      interpolationHighIds.PrepareForOutput(numTotalVertices,
+                                            DeviceAdapter()),
+      vertices.PrepareForOutput(numTotalVertices, DeviceAdapter()),
+      normals.PrepareForOutput(numTotalVertices, DeviceAdapter()),
+      pointGradient);
+
+    typedef typename vtkm::worklet::DispatcherMapTopology<
+      IsoSurfaceGenerate<PointGradientType>,
+      DeviceAdapter> IsoSurfaceDispatcher;
+    IsoSurfaceDispatcher isosurfaceDispatcher(isosurface);
+    isosurfaceDispatcher.Invoke(isoField,
+                                coordinateSystem.GetData(),
+                                inputCellIterationNumber,
+                                cellSet);
+  }
+
   template<typename ArrayHandleIn, typename ArrayHandleOut>
   static void MapFieldOntoIsosurfaces(const ArrayHandleIn& fieldIn,
                                       const FieldHandleVec& interpolationWeights,
@@ -417,6 +1507,11 @@ public:
 namespace vtkm {
 namespace worklet {
 
+/// \brief Compute isosurfaces of hexahedral cell sets for any number of
+/// isovalues
+///
+/// Isovalues are processed in batches of up to MaxNumberOfIsovalues, and
+/// each batch shares a single classification pass over the cells.
 template <typename FieldType, typename DeviceAdapter,
   vtkm::IdComponent MaxNumberOfIsovalues=6>
 class IsosurfaceFilterHexahedra
@@ -495,7 +1590,15 @@ private:
                                 Vec3HandleVec& normals,
                                 FieldHandleVec& interpolationWeights,
                                 IdHandleVec& interpolationLowIds,
-                                IdHandleVec& interpolationHighIds)
+                                IdHandleVec& interpolationHighIds,
+                                IsosurfaceTimings& timings,
+                                IsosurfaceCoherence<FieldType>* coherence,
+                                const IsosurfaceBlockIndex<FieldType>*
+                                blockIndex,
+                                const IsosurfaceClipPlane<FieldType>&
+                                clipPlane,
+                                const PointGradients<FieldType,DeviceAdapter>&
+                                pointGradients)
     {
       if (isovalues.size() == NumberOfIsovalues)
         {
@@ -510,7 +1613,12 @@ private:
                           normals,
                           interpolationWeights,
                           interpolationLowIds,
-                          interpolationHighIds);
+                          interpolationHighIds,
+                          timings,
+                          coherence,
+                          blockIndex,
+                          clipPlane,
+                          pointGradients);
         }
       else
         RunOverIsocontourSetFunctor<CellSetType,StorageTag,
@@ -522,13 +1630,18 @@ private:
                                               normals,
                                               interpolationWeights,
                                               interpolationLowIds,
-                                              interpolationHighIds);
+                                              interpolationHighIds,
+                                              timings,
+                                              coherence,
+                                              blockIndex,
+                                              clipPlane,
+                                              pointGradients);
     }
   };
 
   template<class CellSetType,typename StorageTag,typename CoordinateType>
   class RunOverIsocontourSetFunctor<CellSetType,StorageTag,CoordinateType,
-    MaxNumberOfIsovalues>
+    MaxNumberOfIsovalues+1>
   {
   public:
     typedef vtkm::cont::ArrayHandle<FieldType,StorageTag> FieldHandle;
@@ -545,7 +1658,12 @@ private:
                      Vec3HandleVec&,
                      FieldHandleVec&,
                      IdHandleVec&,
-                     IdHandleVec&)
+                     IdHandleVec&,
+                     IsosurfaceTimings&,
+                     IsosurfaceCoherence<FieldType>*,
+                     const IsosurfaceBlockIndex<FieldType>*,
+                     const IsosurfaceClipPlane<FieldType>&,
+                     const PointGradients<FieldType,DeviceAdapter>&)
     {
       return;
     }
@@ -583,7 +1701,8 @@ private:
   };
 
   template<typename ArrayHandleIn, typename ArrayHandleOut>
-  class MapOntoIsocontourSetFunctor<ArrayHandleIn,ArrayHandleOut,MaxNumberOfIsovalues>
+  class MapOntoIsocontourSetFunctor<ArrayHandleIn,ArrayHandleOut,
+    MaxNumberOfIsovalues+1>
   {
   public:
     MapOntoIsocontourSetFunctor(const ArrayHandleIn&,
@@ -596,7 +1715,334 @@ private:
     }
   };
 
+  // Interpolate several fields at once onto the vertices of an isosurface,
+  // reading each vertex's interpolation ids and weight a single time. The
+  // fields share their array type, so their portals are held in arrays.
+  template<typename FieldPortalConstType, typename FieldPortalType>
+  class ApplyToFields : public vtkm::worklet::WorkletMapField
+  {
+  public:
+    typedef void ControlSignature(FieldIn<IdType> interpolationLow,
+                                  FieldIn<IdType> interpolationHigh,
+                                  FieldIn<vtkm::ListTagBase<FieldType> >
+                                  interpolationWeight);
+    typedef void ExecutionSignature(_1, _2, _3, WorkIndex);
+    typedef _1 InputDomain;
+
+    static const vtkm::IdComponent MaxNumberOfFields = 8;
+
+    FieldPortalConstType Inputs[MaxNumberOfFields];
+    FieldPortalType Outputs[MaxNumberOfFields];
+    vtkm::IdComponent NumberOfFields;
+
+    VTKM_CONT_EXPORT
+    ApplyToFields() : NumberOfFields(0) {}
+
+    VTKM_CONT_EXPORT
+    void AddField(FieldPortalConstType input, FieldPortalType output)
+    {
+      this->Inputs[this->NumberOfFields] = input;
+      this->Outputs[this->NumberOfFields] = output;
+      this->NumberOfFields++;
+    }
+
+    VTKM_EXEC_EXPORT
+    void operator()(const vtkm::Id& low,
+                    const vtkm::Id& high,
+                    const FieldType& weight,
+                    const vtkm::Id index) const
+    {
+      for (vtkm::IdComponent i = 0; i < this->NumberOfFields; i++)
+        this->Outputs[i].Set(index, vtkm::Lerp(this->Inputs[i].Get(low),
+                                               this->Inputs[i].Get(high),
+                                               weight));
+    }
+  };
+
+  // Key each generated vertex by the (unordered) pair of points whose edge it
+  // lies on, so that vertices shared by neighboring triangles compare equal.
+  // The key spans the square of the number of points, which assumes 64-bit
+  // ids for large meshes.
+  class EdgeKey : public vtkm::worklet::WorkletMapField
+  {
+  public:
+    typedef void ControlSignature(FieldIn<IdType> lowId,
+                                  FieldIn<IdType> highId,
+                                  FieldOut<IdType> key);
+    typedef void ExecutionSignature(_1, _2, _3);
+    typedef _1 InputDomain;
+
+    vtkm::Id NumberOfPoints;
+
+    VTKM_CONT_EXPORT
+    EdgeKey(vtkm::Id numberOfPoints) : NumberOfPoints(numberOfPoints) {}
+
+    VTKM_EXEC_EXPORT
+    void operator()(const vtkm::Id& lowId,
+                    const vtkm::Id& highId,
+                    vtkm::Id& key) const
+    {
+      key = (lowId < highId ? lowId*this->NumberOfPoints + highId :
+             highId*this->NumberOfPoints + lowId);
+    }
+  };
+
+  // Scatter each generated vertex to its merged index. Vertices with the same
+  // merged index lie on the same edge and carry the same interpolant, so it
+  // does not matter which of them is written last. Their normals are
+  // accumulated separately (see NormalizeNormals).
+  template<typename CoordinateType, typename FieldPortalType,
+           typename IdPortalType, typename Vec3PortalType>
+  class MergeVertices : public vtkm::worklet::WorkletMapField
+  {
+  public:
+    typedef void ControlSignature(FieldIn<IdType> mergedIndex,
+                                  FieldIn<vtkm::ListTagBase<FieldType> > weight,
+                                  FieldIn<IdType> lowId,
+                                  FieldIn<IdType> highId,
+                                  FieldIn<vtkm::ListTagBase<
+                                    vtkm::Vec<CoordinateType,3> > > vertex);
+    typedef void ExecutionSignature(_1, _2, _3, _4, _5);
+    typedef _1 InputDomain;
+
+    FieldPortalType Weights;
+    IdPortalType LowIds;
+    IdPortalType HighIds;
+    Vec3PortalType Vertices;
+
+    VTKM_CONT_EXPORT
+    MergeVertices(FieldPortalType weights,
+                  IdPortalType lowIds,
+                  IdPortalType highIds,
+                  Vec3PortalType vertices) : Weights(weights),
+                                             LowIds(lowIds),
+                                             HighIds(highIds),
+                                             Vertices(vertices) {}
+
+    VTKM_EXEC_EXPORT
+    void operator()(const vtkm::Id& mergedIndex,
+                    const FieldType& weight,
+                    const vtkm::Id& lowId,
+                    const vtkm::Id& highId,
+                    const vtkm::Vec<CoordinateType,3>& vertex) const
+    {
+      this->Weights.Set(mergedIndex, weight);
+      this->LowIds.Set(mergedIndex, lowId);
+      this->HighIds.Set(mergedIndex, highId);
+      this->Vertices.Set(mergedIndex, vertex);
+    }
+  };
+
+  // Normalize the sum of the normals of the vertices merged into one
+  template<typename CoordinateType>
+  class NormalizeNormals : public vtkm::worklet::WorkletMapField
+  {
+  public:
+    typedef void ControlSignature(FieldIn<vtkm::ListTagBase<
+                                    vtkm::Vec<CoordinateType,3> > > sum,
+                                  FieldOut<vtkm::ListTagBase<
+                                    vtkm::Vec<CoordinateType,3> > > normal);
+    typedef void ExecutionSignature(_1, _2);
+    typedef _1 InputDomain;
+
+    VTKM_EXEC_EXPORT
+    void operator()(const vtkm::Vec<CoordinateType,3>& sum,
+                    vtkm::Vec<CoordinateType,3>& normal) const
+    {
+      const CoordinateType magnitude = vtkm::Magnitude(sum);
+      normal = (magnitude > CoordinateType(0) ?
+                (CoordinateType(1)/magnitude)*sum : sum);
+    }
+  };
+
+  typedef typename IsosurfaceBlockIndex<FieldType>::Range Range;
+
+  // The block of each point, for a block of pointsPerBlock points
+  struct BlockOfPoint
+  {
+    VTKM_EXEC_CONT_EXPORT
+    BlockOfPoint(vtkm::Id pointsPerBlock = 1) : PointsPerBlock(pointsPerBlock) {}
+
+    VTKM_EXEC_CONT_EXPORT
+    vtkm::Id operator()(vtkm::Id point) const
+    {
+      return point/this->PointsPerBlock;
+    }
+
+    vtkm::Id PointsPerBlock;
+  };
+
+  // The range of a single value
+  struct PointRange
+  {
+    VTKM_EXEC_CONT_EXPORT
+    Range operator()(const FieldType& value) const
+    {
+      return Range(value, value);
+    }
+  };
+
+  struct RangeUnion
+  {
+    VTKM_EXEC_CONT_EXPORT
+    Range operator()(const Range& a, const Range& b) const
+    {
+      return Range(a[0] < b[0] ? a[0] : b[0], a[1] > b[1] ? a[1] : b[1]);
+    }
+  };
+
 public:
+  IsosurfaceFilterHexahedra() : MergeDuplicatePoints(false),
+                                TemporalCoherence(false),
+                                PointsPerElement(0),
+                                CellsPerElement(0),
+                                DirtyCellFraction(0.25) {}
+
+  /// Build the block index of a field over the cells (see
+  /// IsosurfaceBlockIndex), which subsequent runs on the same cells use to
+  /// classify only the cells of blocks that an isovalue crosses. The blocks
+  /// are whole elements, about blockSize cells each, so they require the
+  /// element layout (see SetElementLayout); without it only the field's
+  /// overall range is indexed, which still skips the isovalues outside of
+  /// it. The index describes the field's values when it is built, so it
+  /// must be rebuilt or cleared when the field changes.
+  template<typename StorageTag>
+  void BuildBlockIndex(const vtkm::cont::ArrayHandle<FieldType,StorageTag>& field,
+                       vtkm::Id nCells,
+                       vtkm::Id blockSize = 256)
+  {
+    typedef typename vtkm::cont::DeviceAdapterAlgorithm<DeviceAdapter>
+      DeviceAlgorithms;
+
+    this->BlockIndex = IsosurfaceBlockIndex<FieldType>();
+
+    const vtkm::Id nPoints = field.GetNumberOfValues();
+    const vtkm::Id pointsPerElement = this->PointsPerElement;
+    const vtkm::Id cellsPerElement = this->CellsPerElement;
+    if (nCells == 0 || nPoints == 0)
+      return;
+
+    const Range emptyRange(std::numeric_limits<FieldType>::max(),
+                           -std::numeric_limits<FieldType>::max());
+    if (blockSize <= 0 ||
+        pointsPerElement <= 0 || cellsPerElement <= 0 ||
+        nPoints % pointsPerElement != 0 ||
+        (nPoints/pointsPerElement)*cellsPerElement != nCells)
+      {
+      // The range of every point bounds that of the cells' points
+      this->BlockIndex.FieldRange =
+        DeviceAlgorithms::Reduce(
+          vtkm::cont::ArrayHandleTransform<Range,
+            vtkm::cont::ArrayHandle<FieldType,StorageTag>,PointRange>(field),
+          emptyRange,
+          RangeUnion());
+      this->BlockIndex.NumberOfCells = nCells;
+      this->BlockIndex.Valid = true;
+      return;
+      }
+
+    const vtkm::Id elementsPerBlock =
+      std::max(blockSize/cellsPerElement, vtkm::Id(1));
+
+    // Reduce the points' values by block. The keys are sorted, since the
+    // points of each block are consecutive.
+    vtkm::cont::ArrayHandle<vtkm::Id> blocks;
+    DeviceAlgorithms::ReduceByKey(
+      vtkm::cont::make_ArrayHandleImplicit<vtkm::Id>(
+        BlockOfPoint(elementsPerBlock*pointsPerElement), nPoints),
+      vtkm::cont::ArrayHandleTransform<Range,
+        vtkm::cont::ArrayHandle<FieldType,StorageTag>,PointRange>(field),
+      blocks,
+      this->BlockIndex.BlockRanges,
+      RangeUnion());
+
+    this->BlockIndex.FieldRange =
+      DeviceAlgorithms::Reduce(this->BlockIndex.BlockRanges,
+                               emptyRange,
+                               RangeUnion());
+    this->BlockIndex.BlockSize = elementsPerBlock*cellsPerElement;
+    this->BlockIndex.NumberOfCells = nCells;
+    this->BlockIndex.Valid = true;
+  }
+  void ClearBlockIndex()
+  {
+    this->BlockIndex = IsosurfaceBlockIndex<FieldType>();
+  }
+  bool HasBlockIndex() const { return this->BlockIndex.Valid; }
+
+  /// Only contour the cells with a point on the negative side of the plane
+  /// through origin with the given normal (see IsosurfaceClipPlane). The
+  /// plane is evaluated in the classification pass, so the cell set is the
+  /// unclipped one.
+  void SetClipPlane(const vtkm::Vec<FieldType,3>& origin,
+                    const vtkm::Vec<FieldType,3>& normal)
+  {
+    this->ClipPlane.Enabled = true;
+    this->ClipPlane.Origin = origin;
+    this->ClipPlane.Normal = normal;
+  }
+  void ClearClipPlane() { this->ClipPlane = IsosurfaceClipPlane<FieldType>(); }
+  bool HasClipPlane() const { return this->ClipPlane.Enabled; }
+
+  /// When set, each batch of isovalues keeps its point classification and
+  /// compacted cells between runs, and reuses them when no point has crossed
+  /// an isovalue since the previous run (see IsosurfaceCoherence). With an
+  /// element layout, the cells of the elements whose points crossed are
+  /// classified again; otherwise any crossing rebuilds the batch in full. The
+  /// cell set must be the same on each run; call ResetCoherence() when it
+  /// changes.
+  void SetTemporalCoherence(bool coherence)
+  {
+    this->TemporalCoherence = coherence;
+    if (!coherence)
+      this->ResetCoherence();
+  }
+  bool GetTemporalCoherence() const { return this->TemporalCoherence; }
+  void ResetCoherence() { this->Coherence.clear(); }
+
+  /// With temporal coherence, when more than this fraction of the cells
+  /// belong to elements whose points crossed an isovalue, all of the cells
+  /// are classified again rather than just theirs (see IsosurfaceCoherence).
+  /// The default is 0.25; 0 always classifies all of the cells.
+  void SetDirtyCellFraction(vtkm::Float64 fraction)
+  {
+    this->DirtyCellFraction = fraction;
+  }
+  vtkm::Float64 GetDirtyCellFraction() const
+  {
+    return this->DirtyCellFraction;
+  }
+
+  /// Element e of the cell set owns the points from e*pointsPerElement and
+  /// the cells from e*cellsPerElement, consecutively. Temporal coherence then
+  /// only classifies the elements whose points crossed an isovalue. If only
+  /// the points have this layout, pass 0 cells per element: the cells must
+  /// then be in element order, as those a clip keeps are. Zero points per
+  /// element, the default, means the points have no such layout.
+  void SetElementLayout(vtkm::Id pointsPerElement, vtkm::Id cellsPerElement)
+  {
+    this->PointsPerElement = pointsPerElement;
+    this->CellsPerElement = cellsPerElement;
+  }
+
+  /// The points of the cell set are those of high-order hexahedra with n
+  /// points along each edge (see PointGradients), whose basis gives the
+  /// gradients that the isosurface normals are interpolated from. Otherwise
+  /// the gradients are averaged from the cells sharing each point.
+  void SetNodesPerEdge(vtkm::Id n) { this->Gradients.SetNodesPerEdge(n); }
+  vtkm::Id GetNodesPerEdge() const { return this->Gradients.GetNodesPerEdge(); }
+
+  /// When set, the vertices of each isosurface that lie on the same cell edge
+  /// are merged, and GetIndices() holds three indices per triangle into the
+  /// merged vertices. Otherwise each triangle has its own three vertices.
+  void SetMergeDuplicatePoints(bool merge)
+  {
+    this->MergeDuplicatePoints = merge;
+  }
+  bool GetMergeDuplicatePoints() const { return this->MergeDuplicatePoints; }
+
+  const IdHandleVec& GetIndices() const { return this->Indices; }
+
   template<typename StorageTag,typename CoordinateType>
   void Run(const FieldVec& isovalues,
            const vtkm::cont::DataSet& dataSet,
@@ -660,16 +2106,73 @@ public:
       normals.push_back(CoordHandle());
     normals.resize(nIsovalues);
 
-    RunOverIsocontourSetFunctor<CellSetType,StorageTag,
-      CoordinateType>(isovalues,
-                      cellSet,
-                      coords,
-                      isoField,
-                      vertices,
-                      normals,
-                      this->InterpolationWeights,
-                      this->InterpolationLowIds,
-                      this->InterpolationHighIds);
+    // Point states are held in a byte per point, so coherence is limited to
+    // batches of up to eight isovalues
+    const bool coherence = (this->TemporalCoherence &&
+                            MaxNumberOfIsovalues <= 8);
+    const std::size_t nBatches =
+      (nIsovalues + MaxNumberOfIsovalues - 1)/MaxNumberOfIsovalues;
+    for (std::size_t batch=this->Coherence.size();batch<nBatches;batch++)
+      this->Coherence.push_back(IsosurfaceCoherence<FieldType>());
+    for (std::size_t batch=0;batch<this->Coherence.size();batch++)
+      {
+      this->Coherence[batch].PointsPerElement = this->PointsPerElement;
+      this->Coherence[batch].CellsPerElement = this->CellsPerElement;
+      this->Coherence[batch].DirtyCellFraction = this->DirtyCellFraction;
+      }
+
+    this->Gradients.Update(cellSet,coords,isoField);
+
+    // Array handles are shared by copies, so each batch works on slices of
+    // the output vectors that refer to the same arrays.
+    for (IsovalueCount first=0;first<nIsovalues;first+=MaxNumberOfIsovalues)
+      {
+      const IsovalueCount last =
+        std::min(first + MaxNumberOfIsovalues, nIsovalues);
+
+      FieldVec batchIsovalues(isovalues.begin() + first,
+                              isovalues.begin() + last);
+      std::vector<CoordHandle> batchVertices(vertices.begin() + first,
+                                             vertices.begin() + last);
+      std::vector<CoordHandle> batchNormals(normals.begin() + first,
+                                            normals.begin() + last);
+      FieldHandleVec batchWeights(this->InterpolationWeights.begin() + first,
+                                  this->InterpolationWeights.begin() + last);
+      IdHandleVec batchLowIds(this->InterpolationLowIds.begin() + first,
+                              this->InterpolationLowIds.begin() + last);
+      IdHandleVec batchHighIds(this->InterpolationHighIds.begin() + first,
+                               this->InterpolationHighIds.begin() + last);
+
+      RunOverIsocontourSetFunctor<CellSetType,StorageTag,
+        CoordinateType>(batchIsovalues,
+                        cellSet,
+                        coords,
+                        isoField,
+                        batchVertices,
+                        batchNormals,
+                        batchWeights,
+                        batchLowIds,
+                        batchHighIds,
+                        this->Timings,
+                        coherence ?
+                        &this->Coherence[first/MaxNumberOfIsovalues] : NULL,
+                        &this->BlockIndex,
+                        this->ClipPlane,
+                        this->Gradients);
+      }
+
+    for (unsigned iso=this->Indices.size();iso<nIsovalues;iso++)
+      this->Indices.push_back(IdHandle());
+    this->Indices.resize(nIsovalues);
+
+    for (IsovalueCount iso=0;iso<nIsovalues;iso++)
+      {
+      if (this->MergeDuplicatePoints)
+        this->MergeVerticesOnEdges(isoField.GetNumberOfValues(),iso,
+                                   vertices,normals);
+      else
+        this->Indices[iso].Shrink(0);
+      }
   }
 
   template<typename Field, typename StorageTag>
@@ -686,27 +2189,186 @@ public:
   //   fieldOut.push_back(FieldHandle());
   // fieldOut.resize(nIsovalues);
 
-  MapOntoIsocontourSetFunctor<Field,StorageTag,
-    FieldHandle::StorageTag>(fieldIn,
-                             this->InterpolationWeights,
-                             this->InterpolationLowIds,
-                             this->InterpolationHighIds,
-                             fieldOut);
+  this->MapFieldOntoIsosurfaceBatches(fieldIn,fieldOut);
 }
 
   template<typename ArrayHandleIn, typename ArrayHandleOut>
   void MapFieldOntoIsosurfaces(const ArrayHandleIn& fieldIn,
                                std::vector<ArrayHandleOut>& fieldOut)
 {
-  MapOntoIsocontourSetFunctor<ArrayHandleIn,
-                              ArrayHandleOut>(fieldIn,
-                                              this->InterpolationWeights,
-                                              this->InterpolationLowIds,
-                                              this->InterpolationHighIds,
-                                              fieldOut);
+  this->MapFieldOntoIsosurfaceBatches(fieldIn,fieldOut);
 }
 
+  /// Map several fields of the same array type onto the isosurfaces, with
+  /// fieldsOut[i][iso] receiving fieldsIn[i] on isosurface iso. Each kernel
+  /// reads the interpolation arrays once for up to eight fields.
+  template<typename ArrayHandleIn, typename ArrayHandleOut>
+  void MapFieldsOntoIsosurfaces(const std::vector<ArrayHandleIn>& fieldsIn,
+                                std::vector<std::vector<ArrayHandleOut> >&
+                                fieldsOut)
+  {
+    typedef ApplyToFields<typename ArrayHandleIn::template
+      ExecutionTypes<DeviceAdapter>::PortalConst,
+      typename ArrayHandleOut::template
+      ExecutionTypes<DeviceAdapter>::Portal> ApplyToFieldsWorklet;
+    const vtkm::IdComponent maxFields = ApplyToFieldsWorklet::MaxNumberOfFields;
+
+    assert(fieldsOut.size() == fieldsIn.size());
+    const vtkm::IdComponent nFields = fieldsIn.size();
+    for (std::size_t iso=0;iso<this->InterpolationWeights.size();iso++)
+      {
+      const vtkm::Id nValues =
+        this->InterpolationWeights[iso].GetNumberOfValues();
+      if (nValues == 0)
+        {
+        for (vtkm::IdComponent i=0;i<nFields;i++)
+          fieldsOut[i][iso].Shrink(0);
+        continue;
+        }
+
+      for (vtkm::IdComponent first=0;first<nFields;first+=maxFields)
+        {
+        const vtkm::IdComponent last = std::min(first + maxFields, nFields);
+
+        ApplyToFieldsWorklet applyToFields;
+        for (vtkm::IdComponent i=first;i<last;i++)
+          applyToFields.AddField(
+            fieldsIn[i].PrepareForInput(DeviceAdapter()),
+            fieldsOut[i][iso].PrepareForOutput(nValues,DeviceAdapter()));
+
+        vtkm::worklet::DispatcherMapField<ApplyToFieldsWorklet,
+          DeviceAdapter>(applyToFields)
+          .Invoke(this->InterpolationLowIds[iso],
+                  this->InterpolationHighIds[iso],
+                  this->InterpolationWeights[iso]);
+        }
+      }
+  }
+
+  // Time spent in each phase by the calls to Run since the last reset
+  const IsosurfaceTimings& GetTimings() const { return this->Timings; }
+  void ResetTimings() { this->Timings = IsosurfaceTimings(); }
+
 protected:
+  // Replace an isosurface's triangle soup with its unique vertices, and
+  // record each triangle's vertices as indices into them. The interpolation
+  // arrays are merged alongside, so mapped fields are merged as well.
+  template<typename CoordinateType>
+  void MergeVerticesOnEdges(vtkm::Id numberOfPoints,
+                            IsovalueCount iso,
+                            std::vector<vtkm::cont::ArrayHandle<vtkm::Vec<
+                            CoordinateType,3> > >& vertices,
+                            std::vector<vtkm::cont::ArrayHandle<vtkm::Vec<
+                            CoordinateType,3> > >& normals)
+  {
+    typedef typename vtkm::cont::DeviceAdapterAlgorithm<DeviceAdapter>
+      DeviceAlgorithms;
+    typedef vtkm::cont::ArrayHandle<FieldType> FieldHandle;
+    typedef vtkm::cont::ArrayHandle<vtkm::Vec<CoordinateType,3> > CoordHandle;
+    typedef MergeVertices<CoordinateType,
+      typename FieldHandle::template ExecutionTypes<DeviceAdapter>::Portal,
+      typename IdHandle::template ExecutionTypes<DeviceAdapter>::Portal,
+      typename CoordHandle::template ExecutionTypes<DeviceAdapter>::Portal>
+      MergeWorklet;
+
+    if (this->InterpolationWeights[iso].GetNumberOfValues() == 0)
+      {
+      this->Indices[iso].Shrink(0);
+      return;
+      }
+
+    IdHandle keys;
+    vtkm::worklet::DispatcherMapField<EdgeKey,DeviceAdapter>(
+      EdgeKey(numberOfPoints)).Invoke(this->InterpolationLowIds[iso],
+                                      this->InterpolationHighIds[iso],
+                                      keys);
+
+    // Sort the normals by edge, and sum those of each edge. The reduced keys
+    // are the unique edges, in the order of the merged vertices.
+    IdHandle sortedKeys;
+    CoordHandle sortedNormals;
+    DeviceAlgorithms::Copy(keys,sortedKeys);
+    DeviceAlgorithms::Copy(normals[iso],sortedNormals);
+    DeviceAlgorithms::SortByKey(sortedKeys,sortedNormals);
+    IdHandle uniqueKeys;
+    CoordHandle summedNormals;
+    DeviceAlgorithms::ReduceByKey(sortedKeys,sortedNormals,
+                                  uniqueKeys,summedNormals,
+                                  typename PointGradients<FieldType,
+                                  DeviceAdapter>::Sum());
+    DeviceAlgorithms::LowerBounds(uniqueKeys,keys,this->Indices[iso]);
+
+    const vtkm::Id nMerged = uniqueKeys.GetNumberOfValues();
+    FieldHandle weights;
+    IdHandle lowIds;
+    IdHandle highIds;
+    CoordHandle mergedVertices;
+    MergeWorklet merge(weights.PrepareForOutput(nMerged,DeviceAdapter()),
+                       lowIds.PrepareForOutput(nMerged,DeviceAdapter()),
+                       highIds.PrepareForOutput(nMerged,DeviceAdapter()),
+                       mergedVertices.PrepareForOutput(nMerged,
+                                                       DeviceAdapter()));
+    vtkm::worklet::DispatcherMapField<MergeWorklet,DeviceAdapter>(merge)
+      .Invoke(this->Indices[iso],
+              this->InterpolationWeights[iso],
+              this->InterpolationLowIds[iso],
+              this->InterpolationHighIds[iso],
+              vertices[iso]);
+
+    CoordHandle mergedNormals;
+    vtkm::worklet::DispatcherMapField<NormalizeNormals<CoordinateType>,
+      DeviceAdapter>().Invoke(summedNormals,mergedNormals);
+
+    this->InterpolationWeights[iso] = weights;
+    this->InterpolationLowIds[iso] = lowIds;
+    this->InterpolationHighIds[iso] = highIds;
+    // Copy rather than assign, as the caller's handles share their arrays
+    // with its output
+    DeviceAlgorithms::Copy(mergedVertices,vertices[iso]);
+    DeviceAlgorithms::Copy(mergedNormals,normals[iso]);
+  }
+
+  // Map a field in the same batches of isovalues that generated the
+  // isosurfaces
+  template<typename ArrayHandleIn, typename ArrayHandleOut>
+  void MapFieldOntoIsosurfaceBatches(const ArrayHandleIn& fieldIn,
+                                     std::vector<ArrayHandleOut>& fieldOut)
+  {
+    const IsovalueCount nIsovalues = fieldOut.size();
+    for (IsovalueCount first=0;first<nIsovalues;first+=MaxNumberOfIsovalues)
+      {
+      const IsovalueCount last =
+        std::min(first + MaxNumberOfIsovalues, nIsovalues);
+
+      FieldHandleVec batchWeights(this->InterpolationWeights.begin() + first,
+                                  this->InterpolationWeights.begin() + last);
+      IdHandleVec batchLowIds(this->InterpolationLowIds.begin() + first,
+                              this->InterpolationLowIds.begin() + last);
+      IdHandleVec batchHighIds(this->InterpolationHighIds.begin() + first,
+                               this->InterpolationHighIds.begin() + last);
+      std::vector<ArrayHandleOut> batchOut(fieldOut.begin() + first,
+                                           fieldOut.begin() + last);
+
+      MapOntoIsocontourSetFunctor<ArrayHandleIn,
+                                  ArrayHandleOut>(fieldIn,
+                                                  batchWeights,
+                                                  batchLowIds,
+                                                  batchHighIds,
+                                                  batchOut);
+      }
+  }
+
+    IsosurfaceTimings Timings;
+    bool           MergeDuplicatePoints;
+    bool           TemporalCoherence;
+    vtkm::Id       PointsPerElement;
+    vtkm::Id       CellsPerElement;
+    vtkm::Float64  DirtyCellFraction;
+    std::vector<IsosurfaceCoherence<FieldType> > Coherence;
+    IsosurfaceBlockIndex<FieldType> BlockIndex;
+    IsosurfaceClipPlane<FieldType> ClipPlane;
+    PointGradients<FieldType,DeviceAdapter> Gradients;
+    IdHandleVec    Indices;
     FieldHandleVec InterpolationWeights;
     IdHandleVec    InterpolationLowIds;
     IdHandleVec    InterpolationHighIds;
@@ -0,0 +1,100 @@
+#ifndef MARCHINGCUBESTABLES_H
+#define MARCHINGCUBESTABLES_H
+
+#define BOOST_SP_DISABLE_THREADS
+
+#include <vector>
+
+#include <vtkm/Types.h>
+#include <vtkm/cont/ArrayHandle.h>
+#include <vtkm/cont/DeviceAdapter.h>
+#include <vtkm/worklet/MarchingCubesDataTables.h>
+
+namespace vtkm {
+namespace worklet {
+
+/// The corners of a hexahedron that each of its edges joins, in the edge
+/// numbering of the marching cubes tables
+VTKM_EXEC_CONT_EXPORT
+void HexahedronEdgeVertices(vtkm::IdComponent edge, int& v0, int& v1)
+{
+  const int verticesForEdge[] = { 0, 1, 1, 2, 3, 2, 0, 3,
+                                  4, 5, 5, 6, 7, 6, 4, 7,
+                                  0, 4, 1, 5, 2, 6, 3, 7 };
+  v0 = verticesForEdge[2*edge];
+  v1 = verticesForEdge[2*edge + 1];
+}
+
+/// \brief Byte-sized marching cubes tables, resident on the device
+///
+/// VTK-m's tables hold 64-bit ids, so the triangle table alone is 32 KB.
+/// Every entry fits in a byte (a case has at most five triangles, and there
+/// are twelve edges), which shrinks the tables that the classify and
+/// generate kernels read to 4.25 KB. The tables are narrowed from VTK-m's
+/// and transferred to the device on first use, and are then shared by every
+/// filter for the rest of the process.
+template <typename DeviceAdapter>
+class MarchingCubesTables
+{
+public:
+  typedef vtkm::cont::ArrayHandle<vtkm::UInt8> TableHandle;
+  typedef typename TableHandle::template ExecutionTypes<DeviceAdapter>
+    ::PortalConst PortalType;
+
+  /// The value of unused entries in the triangle table
+  static const vtkm::UInt8 NoEdge = 255;
+
+  // The instance is never destroyed, as its arrays may be released after the
+  // device has been torn down at exit
+  static MarchingCubesTables& Get()
+  {
+    static MarchingCubesTables* tables = new MarchingCubesTables();
+    return *tables;
+  }
+
+  /// The number of triangles generated by each of the 256 cases
+  PortalType GetNumTrianglesTable()
+  {
+    return this->NumTriangles.PrepareForInput(DeviceAdapter());
+  }
+
+  /// The edges of each case's triangles, 16 entries per case
+  PortalType GetTriangleTable()
+  {
+    return this->Triangles.PrepareForInput(DeviceAdapter());
+  }
+
+private:
+  MarchingCubesTables()
+  {
+    this->NumTrianglesData.resize(256);
+    for (std::size_t i=0;i<256;i++)
+      this->NumTrianglesData[i] = static_cast<vtkm::UInt8>(
+        vtkm::worklet::internal::numVerticesTable[i]/3);
+
+    this->TrianglesData.resize(256*16);
+    for (std::size_t i=0;i<256*16;i++)
+      {
+      const vtkm::Id edge = vtkm::worklet::internal::triTable[i];
+      this->TrianglesData[i] = (edge < 0 ? NoEdge :
+                                static_cast<vtkm::UInt8>(edge));
+      }
+
+    this->NumTriangles = vtkm::cont::make_ArrayHandle(this->NumTrianglesData);
+    this->Triangles = vtkm::cont::make_ArrayHandle(this->TrianglesData);
+  }
+
+  MarchingCubesTables(const MarchingCubesTables&); // Not implemented
+  void operator=(const MarchingCubesTables&); // Not implemented
+
+  // The host copies, which the array handles wrap
+  std::vector<vtkm::UInt8> NumTrianglesData;
+  std::vector<vtkm::UInt8> TrianglesData;
+  TableHandle NumTriangles;
+  TableHandle Triangles;
+};
+
+}
+} // namespace vtkm::worklet
+
+#endif
@@ -0,0 +1,289 @@
+#ifndef MORTONREORDER_H
+#define MORTONREORDER_H
+
+#define BOOST_SP_DISABLE_THREADS
+
+#include <vtkm/Math.h>
+#include <vtkm/Pair.h>
+#include <vtkm/cont/ArrayHandle.h>
+#include <vtkm/cont/ArrayHandleCounting.h>
+#include <vtkm/cont/ArrayHandleTransform.h>
+#include <vtkm/cont/DeviceAdapter.h>
+#include <vtkm/worklet/DispatcherMapField.h>
+#include <vtkm/worklet/WorkletMapField.h>
+
+#include "Bounds.h"
+
+namespace vtkm {
+namespace worklet {
+
+/// \brief Reorder high-order elements along a Morton (Z-order) curve
+///
+/// Each element is keyed by the Morton code of the centroid of its points,
+/// quantized to 10 bits per axis within the bounds of the mesh. Sorting the
+/// keys gives the permutation from new to old element ids, which is computed
+/// once per mesh; the points and the subdivided cells of each element are
+/// then gathered into that order as whole elements. Each element's points
+/// and cells stay consecutive, so anything indexed by element still applies,
+/// while neighbouring elements, and the cells that share their faces, are
+/// close in memory.
+template <typename DeviceAdapter>
+class MortonReorder
+{
+public:
+  typedef vtkm::cont::ArrayHandle<vtkm::Id> IdArrayHandle;
+  typedef vtkm::cont::ArrayHandle<vtkm::Int32> Int32ArrayHandle;
+  typedef typename IdArrayHandle::template
+    ExecutionTypes<DeviceAdapter>::PortalConst IdPortalConstType;
+
+  template <typename CoordinatePortalType>
+  class ComputeElementCodes : public vtkm::worklet::WorkletMapField
+  {
+  public:
+    typedef void ControlSignature(FieldIn<IdType> element,
+                                  FieldOut<IdType> code);
+    typedef void ExecutionSignature(_1, _2);
+    typedef _1 InputDomain;
+
+    CoordinatePortalType Coordinates;
+    vtkm::Id PointsPerElement;
+    vtkm::Vec<vtkm::Float64,3> Origin;
+    vtkm::Vec<vtkm::Float64,3> Scale;
+
+    VTKM_CONT_EXPORT
+    ComputeElementCodes(CoordinatePortalType coordinates,
+                        vtkm::Id pointsPerElement,
+                        const vtkm::Vec<vtkm::Float64,3>& origin,
+                        const vtkm::Vec<vtkm::Float64,3>& scale) :
+      Coordinates(coordinates),
+      PointsPerElement(pointsPerElement),
+      Origin(origin),
+      Scale(scale) {}
+
+    // Spread the low 10 bits of x so that they occupy every third bit
+    VTKM_EXEC_EXPORT
+    static vtkm::Id Spread(vtkm::Id x)
+    {
+      x = (x | (x << 16)) & 0x030000FF;
+      x = (x | (x << 8)) & 0x0300F00F;
+      x = (x | (x << 4)) & 0x030C30C3;
+      x = (x | (x << 2)) & 0x09249249;
+      return x;
+    }
+
+    VTKM_EXEC_EXPORT
+    void operator()(const vtkm::Id& element, vtkm::Id& code) const
+    {
+      vtkm::Vec<vtkm::Float64,3> centroid(0.);
+      const vtkm::Id first = element*this->PointsPerElement;
+      for (vtkm::Id i=0;i<this->PointsPerElement;i++)
+        for (vtkm::IdComponent j=0;j<3;j++)
+          centroid[j] += this->Coordinates.Get(first + i)[j];
+
+      code = 0;
+      for (vtkm::IdComponent j=0;j<3;j++)
+        {
+        vtkm::Float64 x =
+          (centroid[j]/static_cast<vtkm::Float64>(this->PointsPerElement) -
+           this->Origin[j])*this->Scale[j];
+        vtkm::Id q = static_cast<vtkm::Id>(vtkm::Max(vtkm::Min(x,1023.),0.));
+        code |= Spread(q) << j;
+        }
+    }
+  };
+
+  template <typename InputPortalType, typename OutputPortalType>
+  class GatherPoints : public vtkm::worklet::WorkletMapField
+  {
+  public:
+    typedef void ControlSignature(FieldIn<IdType> newPoint);
+    typedef void ExecutionSignature(_1);
+    typedef _1 InputDomain;
+
+    IdPortalConstType ElementOrder;
+    vtkm::Id PointsPerElement;
+    InputPortalType Input;
+    OutputPortalType Output;
+
+    VTKM_CONT_EXPORT
+    GatherPoints(IdPortalConstType elementOrder,
+                 vtkm::Id pointsPerElement,
+                 InputPortalType input,
+                 OutputPortalType output) :
+      ElementOrder(elementOrder),
+      PointsPerElement(pointsPerElement),
+      Input(input),
+      Output(output) {}
+
+    VTKM_EXEC_EXPORT
+    void operator()(const vtkm::Id& newPoint) const
+    {
+      const vtkm::Id element = newPoint/this->PointsPerElement;
+      const vtkm::Id oldPoint =
+        this->ElementOrder.Get(element)*this->PointsPerElement +
+        newPoint%this->PointsPerElement;
+      this->Output.Set(newPoint, this->Input.Get(oldPoint));
+    }
+  };
+
+  // Gather the cells of each element, renumbering their points to follow
+  // the element's points to their new place
+  template <typename ConnectivityPortalType>
+  class GatherCells : public vtkm::worklet::WorkletMapField
+  {
+  public:
+    typedef void ControlSignature(FieldIn<IdType> newCell);
+    typedef void ExecutionSignature(_1);
+    typedef _1 InputDomain;
+
+    typedef typename Int32ArrayHandle::template
+      ExecutionTypes<DeviceAdapter>::Portal OutputPortalType;
+
+    IdPortalConstType ElementOrder;
+    vtkm::Id PointsPerElement;
+    vtkm::Id CellsPerElement;
+    ConnectivityPortalType Input;
+    OutputPortalType Output;
+
+    VTKM_CONT_EXPORT
+    GatherCells(IdPortalConstType elementOrder,
+                vtkm::Id pointsPerElement,
+                vtkm::Id cellsPerElement,
+                ConnectivityPortalType input,
+                OutputPortalType output) :
+      ElementOrder(elementOrder),
+      PointsPerElement(pointsPerElement),
+      CellsPerElement(cellsPerElement),
+      Input(input),
+      Output(output) {}
+
+    VTKM_EXEC_EXPORT
+    void operator()(const vtkm::Id& newCell) const
+    {
+      const vtkm::Id newElement = newCell/this->CellsPerElement;
+      const vtkm::Id oldElement = this->ElementOrder.Get(newElement);
+      const vtkm::Id oldCell =
+        oldElement*this->CellsPerElement + newCell%this->CellsPerElement;
+      const vtkm::Id offset =
+        (newElement - oldElement)*this->PointsPerElement;
+      for (vtkm::IdComponent i=0;i<8;i++)
+        this->Output.Set(8*newCell + i, static_cast<vtkm::Int32>(
+                           this->Input.Get(8*oldCell + i) + offset));
+    }
+  };
+
+  /// Compute the permutation from new to old element ids of elements that
+  /// each own pointsPerElement consecutive points
+  template <typename CoordinateArrayHandle>
+  void Run(const CoordinateArrayHandle& coordinates,
+           vtkm::Id pointsPerElement,
+           IdArrayHandle& elementOrder) const
+  {
+    typedef vtkm::cont::DeviceAdapterAlgorithm<DeviceAdapter> Algorithm;
+    typedef vtkm::Vec<vtkm::Float64,3> ResultType;
+    typedef vtkm::Pair<ResultType,ResultType> MinMaxPairType;
+    typedef typename CoordinateArrayHandle::template
+      ExecutionTypes<DeviceAdapter>::PortalConst CoordinatePortalType;
+    typedef ComputeElementCodes<CoordinatePortalType>
+      ComputeElementCodesWorklet;
+
+    elementOrder = IdArrayHandle();
+    if (pointsPerElement <= 0)
+      return;
+    const vtkm::Id nElements =
+      coordinates.GetNumberOfValues()/pointsPerElement;
+    if (nElements == 0)
+      return;
+
+    MinMaxPairType initialValue =
+      make_Pair(ResultType(vtkm::Infinity64()),
+                ResultType(vtkm::NegativeInfinity64()));
+    vtkm::cont::ArrayHandleTransform<MinMaxPairType,CoordinateArrayHandle,
+      internal::InputToOutputTypeTransform<3> > bounds(coordinates);
+    MinMaxPairType range = Algorithm::Reduce(bounds, initialValue,
+                                             internal::MinMax<3>());
+
+    ResultType scale;
+    for (vtkm::IdComponent j=0;j<3;j++)
+      {
+      vtkm::Float64 extent = range.second[j] - range.first[j];
+      scale[j] = (extent > 0. ? 1023./extent : 0.);
+      }
+
+    IdArrayHandle codes;
+    vtkm::cont::ArrayHandleCounting<vtkm::Id> elements(0, 1, nElements);
+    ComputeElementCodesWorklet computeCodes(
+      coordinates.PrepareForInput(DeviceAdapter()),
+      pointsPerElement,
+      range.first,
+      scale);
+    vtkm::worklet::DispatcherMapField<ComputeElementCodesWorklet,
+      DeviceAdapter>(computeCodes).Invoke(elements, codes);
+
+    Algorithm::Copy(elements, elementOrder);
+    Algorithm::SortByKey(codes, elementOrder);
+  }
+
+  /// Gather the points of each element into the given element order
+  template <typename ArrayHandleType>
+  void ReorderPoints(const IdArrayHandle& elementOrder,
+                     vtkm::Id pointsPerElement,
+                     ArrayHandleType& points) const
+  {
+    typedef typename ArrayHandleType::template
+      ExecutionTypes<DeviceAdapter>::PortalConst InputPortalType;
+    typedef typename ArrayHandleType::template
+      ExecutionTypes<DeviceAdapter>::Portal OutputPortalType;
+    typedef GatherPoints<InputPortalType,OutputPortalType> GatherPointsWorklet;
+
+    const vtkm::Id nPoints = elementOrder.GetNumberOfValues()*pointsPerElement;
+    if (nPoints == 0 || points.GetNumberOfValues() != nPoints)
+      return;
+
+    ArrayHandleType reordered;
+    GatherPointsWorklet gather(elementOrder.PrepareForInput(DeviceAdapter()),
+                               pointsPerElement,
+                               points.PrepareForInput(DeviceAdapter()),
+                               reordered.PrepareForOutput(nPoints,
+                                                          DeviceAdapter()));
+    vtkm::worklet::DispatcherMapField<GatherPointsWorklet,
+      DeviceAdapter>(gather).Invoke(
+        vtkm::cont::ArrayHandleCounting<vtkm::Id>(0, 1, nPoints));
+
+    points = reordered;
+  }
+
+  /// Gather the hexahedra of each element, cellsPerElement consecutive cells
+  /// whose points are the element's, into the given element order
+  void ReorderCells(const IdArrayHandle& elementOrder,
+                    vtkm::Id pointsPerElement,
+                    vtkm::Id cellsPerElement,
+                    Int32ArrayHandle& connectivity) const
+  {
+    typedef typename Int32ArrayHandle::template
+      ExecutionTypes<DeviceAdapter>::PortalConst ConnectivityPortalType;
+    typedef GatherCells<ConnectivityPortalType> GatherCellsWorklet;
+
+    const vtkm::Id nCells = elementOrder.GetNumberOfValues()*cellsPerElement;
+    if (nCells == 0 || connectivity.GetNumberOfValues() != 8*nCells)
+      return;
+
+    Int32ArrayHandle reordered;
+    GatherCellsWorklet gather(elementOrder.PrepareForInput(DeviceAdapter()),
+                              pointsPerElement,
+                              cellsPerElement,
+                              connectivity.PrepareForInput(DeviceAdapter()),
+                              reordered.PrepareForOutput(8*nCells,
+                                                         DeviceAdapter()));
+    vtkm::worklet::DispatcherMapField<GatherCellsWorklet,
+      DeviceAdapter>(gather).Invoke(
+        vtkm::cont::ArrayHandleCounting<vtkm::Id>(0, 1, nCells));
+
+    connectivity = reordered;
+  }
+};
+
+}
+} // namespace vtkm::worklet
+
+#endif
@@ -0,0 +1,331 @@
+#ifndef POINTGRADIENTS_H
+#define POINTGRADIENTS_H
+
+#define BOOST_SP_DISABLE_THREADS
+
+#include <vtkm/VectorAnalysis.h>
+#include <vtkm/cont/ArrayHandle.h>
+#include <vtkm/cont/ArrayHandleConstant.h>
+#include <vtkm/cont/CoordinateSystem.h>
+#include <vtkm/cont/DeviceAdapter.h>
+#include <vtkm/worklet/DispatcherMapField.h>
+#include <vtkm/worklet/DispatcherMapTopology.h>
+#include <vtkm/worklet/WorkletMapField.h>
+#include <vtkm/worklet/WorkletMapTopology.h>
+
+#include "GradientFields.h"
+
+namespace vtkm {
+namespace worklet {
+
+namespace internal {
+
+// Gradient of the cell's trilinear interpolant at one of its corners.
+// Along each of the three cell edges meeting at the corner, the gradient
+// must reproduce the change in the scalar, which gives a 3x3 system that
+// is solved by Cramer's rule.
+template<typename FieldType,typename ScalarsVecType,typename VectorsVecType>
+VTKM_EXEC_EXPORT
+vtkm::Vec<FieldType,3> HexahedronCornerGradient(const int corner,
+                                                const ScalarsVecType &scalars,
+                                                const VectorsVecType &pointCoords)
+{
+  const int neighborsAlong[3][8] = { { 1, 0, 3, 2, 5, 4, 7, 6 },
+                                     { 3, 2, 1, 0, 7, 6, 5, 4 },
+                                     { 4, 5, 6, 7, 0, 1, 2, 3 } };
+
+  vtkm::Vec<FieldType,3> dx[3];
+  FieldType ds[3];
+  for (vtkm::IdComponent i = 0; i < 3; i++)
+    {
+    const int neighbor = neighborsAlong[i][corner];
+    dx[i] = vtkm::Vec<FieldType,3>(pointCoords[neighbor] -
+                                   pointCoords[corner]);
+    ds[i] = (static_cast<FieldType>(scalars[neighbor]) -
+             static_cast<FieldType>(scalars[corner]));
+    }
+
+  const vtkm::Vec<FieldType,3> c0 = vtkm::Cross(dx[1], dx[2]);
+  const vtkm::Vec<FieldType,3> c1 = vtkm::Cross(dx[2], dx[0]);
+  const vtkm::Vec<FieldType,3> c2 = vtkm::Cross(dx[0], dx[1]);
+  const FieldType det = vtkm::dot(dx[0], c0);
+  if (det == FieldType(0))
+    return vtkm::Vec<FieldType,3>(FieldType(0));
+
+  return (FieldType(1)/det)*(ds[0]*c0 + ds[1]*c1 + ds[2]*c2);
+}
+
+}
+
+/// \brief Gradients of a scalar field at the points of a hexahedral cell set
+///
+/// Isosurface normals are interpolated along each cut edge from the
+/// gradients at the edge's two points. These must not depend upon the cell
+/// the edge is cut in, or the (up to four) cells sharing the edge give its
+/// vertex different normals, and lit isosurfaces look faceted across the
+/// cell boundaries.
+///
+/// If the points are those of PyFR's high-order hexahedra (n^3 points per
+/// element on a tensor-product grid, x varying fastest, element by element;
+/// see SetNodesPerEdge()), the gradient at a point is that of its element's
+/// Lagrange interpolant, mapped to physical space with the isoparametric
+/// Jacobian as in GradientFields. It is evaluated on demand, at the points
+/// of the cut edges only. Otherwise, each point's gradient is the average of
+/// the corner gradients of the cells that share it, computed for every point
+/// in a pass over the cells.
+template <typename FieldType, typename DeviceAdapter>
+class PointGradients
+{
+public:
+  typedef vtkm::Vec<FieldType,3> Vec3;
+  typedef vtkm::cont::ArrayHandle<FieldType> FieldHandle;
+  typedef vtkm::cont::ArrayHandle<Vec3> Vec3Handle;
+  typedef vtkm::cont::ArrayHandle<vtkm::Id> IdHandle;
+
+  typedef typename FieldHandle::template ExecutionTypes<DeviceAdapter>
+    ::PortalConst FieldPortalConstType;
+  typedef typename Vec3Handle::template ExecutionTypes<DeviceAdapter>
+    ::PortalConst Vec3PortalConstType;
+  typedef typename Vec3Handle::template ExecutionTypes<DeviceAdapter>
+    ::Portal Vec3PortalType;
+  typedef typename IdHandle::template ExecutionTypes<DeviceAdapter>
+    ::Portal IdPortalType;
+
+  /// The gradient at a point of its element's Lagrange interpolant
+  template<typename FieldPortalType>
+  class BasisGradient
+  {
+  public:
+    VTKM_CONT_EXPORT
+    BasisGradient(FieldPortalType field,
+                  Vec3PortalConstType coordinates,
+                  FieldPortalConstType derivative,
+                  vtkm::Id nodesPerEdge) : Field(field),
+                                           Coordinates(coordinates),
+                                           Derivative(derivative),
+                                           NodesPerEdge(nodesPerEdge) {}
+
+    VTKM_EXEC_EXPORT
+    Vec3 operator()(vtkm::Id point) const
+    {
+      const vtkm::Id n = this->NodesPerEdge;
+      const vtkm::Id nNodes = n*n*n;
+      const vtkm::Id node = point%nNodes;
+      const vtkm::Id ijk[3] = { node%n, (node/n)%n, node/(n*n) };
+      const vtkm::Id stride[3] = { 1, n, n*n };
+
+      // Derivatives of position and of the field with respect to the
+      // reference coordinates, along the lines of nodes through the point
+      Vec3 dXdXi[3];
+      FieldType dSdXi[3];
+      for (vtkm::IdComponent r=0;r<3;r++)
+        {
+        dXdXi[r] = Vec3(0);
+        dSdXi[r] = 0;
+        const vtkm::Id line = point - ijk[r]*stride[r];
+        for (vtkm::Id m=0;m<n;m++)
+          {
+          const FieldType d = this->Derivative.Get(ijk[r]*n + m);
+          const vtkm::Id other = line + m*stride[r];
+          dXdXi[r] = dXdXi[r] + d*this->Coordinates.Get(other);
+          dSdXi[r] += d*static_cast<FieldType>(this->Field.Get(other));
+          }
+        }
+
+      // Invert the Jacobian; row r of the inverse is c_r/det = dxi_r/dx
+      const Vec3 c0 = vtkm::Cross(dXdXi[1],dXdXi[2]);
+      const Vec3 c1 = vtkm::Cross(dXdXi[2],dXdXi[0]);
+      const Vec3 c2 = vtkm::Cross(dXdXi[0],dXdXi[1]);
+      const FieldType det = vtkm::dot(dXdXi[0],c0);
+      if (det == FieldType(0))
+        return Vec3(0);
+
+      return (FieldType(1)/det)*(dSdXi[0]*c0 + dSdXi[1]*c1 + dSdXi[2]*c2);
+    }
+
+  private:
+    FieldPortalType Field;
+    Vec3PortalConstType Coordinates;
+    FieldPortalConstType Derivative;
+    vtkm::Id NodesPerEdge;
+  };
+
+  /// The gradient at a point, averaged over the cells sharing it
+  class StoredGradient
+  {
+  public:
+    VTKM_CONT_EXPORT
+    StoredGradient(Vec3PortalConstType gradients) : Gradients(gradients) {}
+
+    VTKM_EXEC_EXPORT
+    Vec3 operator()(vtkm::Id point) const
+    {
+      return this->Gradients.Get(point);
+    }
+
+  private:
+    Vec3PortalConstType Gradients;
+  };
+
+  /// Write the gradients at each cell's corners, keyed by their points
+  class CornerGradients : public vtkm::worklet::WorkletMapPointToCell
+  {
+  public:
+    typedef void ControlSignature(FieldInFrom<Scalar> scalars,
+                                  FieldInFrom<Vec3> coordinates,
+                                  TopologyIn topology);
+    typedef void ExecutionSignature(WorkIndex, _1, _2, FromIndices);
+    typedef _3 InputDomain;
+
+    IdPortalType Points;
+    Vec3PortalType Gradients;
+
+    VTKM_CONT_EXPORT
+    CornerGradients(IdPortalType points,
+                    Vec3PortalType gradients) : Points(points),
+                                                Gradients(gradients) {}
+
+    template<typename ScalarsVecType,typename VectorsVecType,typename IdVecType>
+    VTKM_EXEC_EXPORT
+    void operator()(const vtkm::Id cell,
+                    const ScalarsVecType& scalars,
+                    const VectorsVecType& pointCoords,
+                    const IdVecType& pointIds) const
+    {
+      for (vtkm::IdComponent i = 0; i < 8; i++)
+        {
+        this->Points.Set(8*cell + i, pointIds[i]);
+        this->Gradients.Set(8*cell + i,
+                            internal::HexahedronCornerGradient<FieldType>(
+                              i, scalars, pointCoords));
+        }
+    }
+  };
+
+  /// Store the average of each point's corner gradients
+  class StoreAverage : public vtkm::worklet::WorkletMapField
+  {
+  public:
+    typedef void ControlSignature(FieldIn<IdType> point,
+                                  FieldIn<Vec3> sum,
+                                  FieldIn<IdType> count);
+    typedef void ExecutionSignature(_1, _2, _3);
+    typedef _1 InputDomain;
+
+    Vec3PortalType Gradients;
+
+    VTKM_CONT_EXPORT
+    StoreAverage(Vec3PortalType gradients) : Gradients(gradients) {}
+
+    VTKM_EXEC_EXPORT
+    void operator()(const vtkm::Id& point,
+                    const Vec3& sum,
+                    const vtkm::Id& count) const
+    {
+      this->Gradients.Set(point, (FieldType(1)/static_cast<FieldType>(count))*
+                          sum);
+    }
+  };
+
+  struct Sum
+  {
+    template<typename T>
+    VTKM_EXEC_CONT_EXPORT
+    T operator()(const T& a, const T& b) const { return a + b; }
+  };
+
+  PointGradients() : NodesPerEdge(0), UseBasis(false) {}
+
+  /// The number of points along each edge of the high-order hexahedra that
+  /// own the points, or 0 if the points are not laid out by element
+  void SetNodesPerEdge(vtkm::Id n) { this->NodesPerEdge = n; }
+  vtkm::Id GetNodesPerEdge() const { return this->NodesPerEdge; }
+
+  /// Prepare the gradients of a field over a cell set's points
+  template<class CellSetType,typename StorageTag>
+  void Update(const CellSetType& cellSet,
+              const vtkm::cont::CoordinateSystem& coords,
+              const vtkm::cont::ArrayHandle<FieldType,StorageTag>& field)
+  {
+    typedef vtkm::cont::DeviceAdapterAlgorithm<DeviceAdapter> Algorithm;
+
+    const vtkm::Id n = this->NodesPerEdge;
+    const vtkm::Id nPoints = field.GetNumberOfValues();
+    this->UseBasis = (n > 1 && nPoints%(n*n*n) == 0 &&
+                      coords.GetData().GetNumberOfValues() == nPoints);
+    if (this->UseBasis)
+      {
+      if (this->Derivative.GetNumberOfValues() != n*n)
+        GradientFields<FieldType,DeviceAdapter>::DerivativeMatrix(
+          n, this->Derivative);
+      this->Coordinates = coords.GetData()
+        .CastToArrayHandle(Vec3(),vtkm::cont::StorageTagBasic());
+      this->Gradients = Vec3Handle();
+      return;
+      }
+
+    const vtkm::Id nCorners = 8*cellSet.GetNumberOfCells();
+    IdHandle points;
+    Vec3Handle cornerGradients;
+    vtkm::worklet::DispatcherMapTopology<CornerGradients,DeviceAdapter>(
+      CornerGradients(points.PrepareForOutput(nCorners,DeviceAdapter()),
+                      cornerGradients.PrepareForOutput(nCorners,
+                                                       DeviceAdapter())))
+      .Invoke(field,coords.GetData(),cellSet);
+
+    Algorithm::SortByKey(points,cornerGradients);
+    IdHandle uniquePoints;
+    Vec3Handle sums;
+    Algorithm::ReduceByKey(points,cornerGradients,uniquePoints,sums,Sum());
+    IdHandle countedPoints;
+    IdHandle counts;
+    Algorithm::ReduceByKey(points,
+                           vtkm::cont::ArrayHandleConstant<vtkm::Id>(1,
+                                                                  nCorners),
+                           countedPoints,counts,Sum());
+
+    // Points outside of every cell are left unset; no edge is cut at them
+    vtkm::worklet::DispatcherMapField<StoreAverage,DeviceAdapter>(
+      StoreAverage(this->Gradients.PrepareForOutput(nPoints,DeviceAdapter())))
+      .Invoke(uniquePoints,sums,counts);
+    this->Coordinates = Vec3Handle();
+  }
+
+  /// Whether the gradients are evaluated from the elements' basis, by
+  /// PrepareBasisGradient(), rather than stored, by PrepareStoredGradient()
+  bool UsesBasis() const { return this->UseBasis; }
+
+  template<typename StorageTag>
+  BasisGradient<typename vtkm::cont::ArrayHandle<FieldType,StorageTag>::
+                template ExecutionTypes<DeviceAdapter>::PortalConst>
+  PrepareBasisGradient(const vtkm::cont::ArrayHandle<FieldType,StorageTag>&
+                       field) const
+  {
+    typedef typename vtkm::cont::ArrayHandle<FieldType,StorageTag>::
+      template ExecutionTypes<DeviceAdapter>::PortalConst FieldPortalType;
+    return BasisGradient<FieldPortalType>(
+      field.PrepareForInput(DeviceAdapter()),
+      this->Coordinates.PrepareForInput(DeviceAdapter()),
+      this->Derivative.PrepareForInput(DeviceAdapter()),
+      this->NodesPerEdge);
+  }
+
+  StoredGradient PrepareStoredGradient() const
+  {
+    return StoredGradient(this->Gradients.PrepareForInput(DeviceAdapter()));
+  }
+
+private:
+  vtkm::Id NodesPerEdge;
+  bool UseBasis;
+  // The derivatives of the Lagrange basis, and the points' coordinates
+  FieldHandle Derivative;
+  Vec3Handle Coordinates;
+  // The averaged gradients, if the points are not laid out by element
+  Vec3Handle Gradients;
+};
+
+}
+} // namespace vtkm::worklet
+
+#endif
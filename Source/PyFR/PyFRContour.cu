@@ -1,19 +1,19 @@
 #include "PyFRContour.h"
 
 #include <vtkm/cont/DeviceAdapter.h>
-#include <vtkm/cont/cuda/DeviceAdapterCuda.h>
+#include "PyFRDeviceAdapter.h"
 
 //----------------------------------------------------------------------------
 PyFRContour::ColorArrayHandle PyFRContour::GetColorData()
 {
-  typedef ::vtkm::cont::DeviceAdapterTagCuda CudaTag;
+  typedef ::PyFRDeviceAdapter DeviceTag;
 
    vtkm::cont::ArrayHandleTransform<FPType,
     ColorArrayHandle,
     ColorTable,
     ColorTable> colorHandle(this->ColorData,this->Table,this->Table);
 
-    vtkm::cont::DeviceAdapterAlgorithm<CudaTag>().
+    vtkm::cont::DeviceAdapterAlgorithm<DeviceTag>().
       Copy(this->ScalarData, colorHandle);
 
     return this->ColorData;
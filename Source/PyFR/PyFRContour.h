@@ -4,6 +4,7 @@
 #define BOOST_SP_DISABLE_THREADS
 
 #include <string>
+#include <vector>
 
 #include "ArrayHandleExposed.h"
 #include "ColorTable.h"
@@ -15,6 +16,8 @@ class PyFRContour
 public:
   typedef vtkm::cont::ArrayHandleExposed<vtkm::Vec<FPType,3> > Vec3ArrayHandle;
   typedef vtkm::cont::ArrayHandleExposed<Color> ColorArrayHandle;
+  typedef vtkm::cont::ArrayHandleExposed<vtkm::Int32> IndexArrayHandle;
+  typedef vtkm::cont::ArrayHandleExposed<FPType> FieldArrayHandle;
   typedef vtkm::cont::ArrayHandleTransform<FPType,
                                            ColorArrayHandle,
                                            ColorTable,
@@ -22,6 +25,7 @@ public:
 
   PyFRContour(const ColorTable& table) : Vertices(),
                                          Normals(),
+                                         Indices(),
                                          ColorData(),
                                          ScalarData(this->ColorData,
                                                     table,
@@ -34,9 +38,16 @@ public:
 
   Vec3ArrayHandle GetVertices()         const { return this->Vertices; }
   Vec3ArrayHandle GetNormals()          const { return this->Normals; }
+  IndexArrayHandle GetIndices()         const { return this->Indices; }
   ScalarDataArrayHandle GetScalarData() const { return this->ScalarData; }
   ColorArrayHandle GetColorData()       const { return this->ColorData; }
   int GetScalarDataType()               const { return this->ScalarDataType; }
+  const std::string& GetScalarDataName() const
+  { return this->ScalarDataName; }
+
+  // An indexed contour shares its vertices between triangles, and holds three
+  // indices per triangle. Otherwise each triangle has its own three vertices.
+  bool IsIndexed() const { return this->Indices.GetNumberOfValues() > 0; }
 
   void ChangeColorTable(const ColorTable& table)
   {
@@ -44,13 +55,37 @@ public:
   }
 
   void SetScalarDataType(int i) { this->ScalarDataType = i; }
+  void SetScalarDataName(const std::string& name)
+  { this->ScalarDataName = name; }
+
+  // Point fields mapped onto the contour in addition to its scalar data, one
+  // array per field
+  void SetNumberOfFields(unsigned nFields)
+  {
+    // NB: Cannot call resize to increase the lengths of vectors of array
+    // handles!
+    for (unsigned i=this->Fields.size();i<nFields;i++)
+      this->Fields.push_back(FieldArrayHandle());
+    this->Fields.resize(nFields);
+    this->FieldNames.resize(nFields);
+  }
+  unsigned GetNumberOfFields() const { return this->Fields.size(); }
+  FieldArrayHandle GetField(unsigned i) const { return this->Fields[i]; }
+  const std::string& GetFieldName(unsigned i) const
+  { return this->FieldNames[i]; }
+  void SetFieldName(unsigned i,const std::string& name)
+  { this->FieldNames[i] = name; }
 
 private:
   Vec3ArrayHandle Vertices;
   Vec3ArrayHandle Normals;
+  IndexArrayHandle Indices;
   ColorArrayHandle ColorData;
   ScalarDataArrayHandle ScalarData;
   int ScalarDataType;
+  std::string ScalarDataName;
+  std::vector<FieldArrayHandle> Fields;
+  std::vector<std::string> FieldNames;
 };
 
 #endif
@@ -7,13 +7,15 @@
 #include <vtkm/Types.h>
 #include <vtkm/VectorAnalysis.h>
 
-#include <vtkm/cont/cuda/DeviceAdapterCuda.h>
+#include "PyFRDeviceAdapter.h"
 #include <vtkm/cont/DeviceAdapter.h>
 #include <vtkm/cont/ArrayHandleTransform.h>
 
 #include <vtkm/cont/ArrayHandleCast.h>
 #include <vtkm/opengl/TransferToOpenGL.h>
+#ifdef PYFR_DEVICE_ADAPTER_CUDA
 #include <vtkm/opengl/cuda/internal/TransferToOpenGL.h>
+#endif
 
 //----------------------------------------------------------------------------
 void PyFRContourData::SetNumberOfContours(unsigned nContours)
@@ -42,11 +44,23 @@ unsigned PyFRContourData::GetContourSize(int contour) const
   return 0;
 }
 
+//----------------------------------------------------------------------------
+unsigned PyFRContourData::GetContourIndexCount(int contour) const
+{
+  if(contour < this->Contours.size())
+    {
+    const PyFRContour& c = this->GetContour(contour);
+    return (c.IsIndexed() ? c.GetIndices().GetNumberOfValues() :
+            c.GetVertices().GetNumberOfValues());
+    }
+  return 0;
+}
+
 //----------------------------------------------------------------------------
 void PyFRContourData::ComputeContourBounds(int contour,FPType* bounds) const
 {
-  typedef ::vtkm::cont::DeviceAdapterTagCuda CudaTag;
-  typedef vtkm::cont::DeviceAdapterAlgorithm<CudaTag> Algorithm;
+  typedef ::PyFRDeviceAdapter DeviceTag;
+  typedef vtkm::cont::DeviceAdapterAlgorithm<DeviceTag> Algorithm;
   typedef vtkm::Vec<vtkm::Float64, 3> ResultType;
   typedef vtkm::Pair<ResultType, ResultType> MinMaxPairType;
   typedef PyFRContour::Vec3ArrayHandle ArrayHandleType;
@@ -105,7 +119,7 @@ void PyFRContourData::SetColorPalette(int preset,FPType min,FPType max)
 namespace transfer
 {
 
-typedef ::vtkm::cont::DeviceAdapterTagCuda CudaTag;
+typedef ::PyFRDeviceAdapter DeviceTag;
 
 //----------------------------------------------------------------------------
 template<typename HandleType>
@@ -116,14 +130,14 @@ void to_gl(vtkm::Vec<vtkm::Float64,3>, const HandleType& handle, unsigned int& g
     vtkm::cont::make_ArrayHandleCast(handle, vtkm::Vec<vtkm::Float32,3>());
 
   //transfer the array to openGL now as a float32 array
-  vtkm::opengl::TransferToOpenGL(asF32, glHandle, CudaTag());
+  vtkm::opengl::TransferToOpenGL(asF32, glHandle, DeviceTag());
 }
 
 //----------------------------------------------------------------------------
 template<typename HandleType>
 void to_gl(vtkm::Float32, const HandleType& handle, unsigned int& glHandle)
 {
-  vtkm::opengl::TransferToOpenGL(handle, glHandle, CudaTag());
+  vtkm::opengl::TransferToOpenGL(handle, glHandle, DeviceTag());
 }
 
 //----------------------------------------------------------------------------
@@ -144,7 +158,16 @@ void colors(PyFRContourData* data, int index, unsigned int& glHandle)
   //no need to worry about conversion, since this is always Vec4 of uint8's
   vtkm::opengl::TransferToOpenGL( data->GetContour(index).GetColorData(),
                                   glHandle,
-                                  CudaTag());
+                                  DeviceTag());
+}
+
+//----------------------------------------------------------------------------
+void indices(PyFRContourData* data, int index, unsigned int& glHandle)
+{
+  //integer arrays are transferred as element array buffers
+  vtkm::opengl::TransferToOpenGL( data->GetContour(index).GetIndices(),
+                                  glHandle,
+                                  DeviceTag());
 }
 
 } //namespace transfer
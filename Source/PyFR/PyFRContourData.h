@@ -19,6 +19,7 @@ public:
   PyFRContour& GetContour(int i)             { return this->Contours[i]; }
   const PyFRContour& GetContour(int i) const { return this->Contours[i]; }
   unsigned GetContourSize(int) const;
+  unsigned GetContourIndexCount(int) const;
   void ComputeContourBounds(int,FPType*) const;
   void ComputeBounds(FPType*) const;
   void SetColorPalette(int,FPType,FPType);
@@ -36,6 +37,7 @@ namespace transfer
   void coords(PyFRContourData* data, int index, unsigned int& glHandle);
   void normals(PyFRContourData* data, int index, unsigned int& glHandle);
   void colors(PyFRContourData* data, int index, unsigned int& glHandle);
+  void indices(PyFRContourData* data, int index, unsigned int& glHandle);
 }
 
 #endif
@@ -1,11 +1,91 @@
 #include "PyFRContourFilter.h"
 
+#include <vtkm/BinaryPredicates.h>
+#include <vtkm/ImplicitFunctions.h>
+#include <vtkm/cont/ArrayHandleConstant.h>
+#include <vtkm/cont/ArrayHandleTransform.h>
+
+#include "AppendArrays.h"
+#include "IsosurfaceFunctors.h"
 #include "CrinkleClip.h"
 #include "PyFRData.h"
 #include "PyFRContourData.h"
 
+namespace
+{
+typedef vtkm::cont::DynamicArrayHandleBase<PyFRData::FieldTypeList,
+  PyFRData::FieldStorageList> FieldArrayHandle;
+typedef std::vector<vtkm::cont::ArrayHandle<FPType> > FieldHandleVec;
+typedef vtkm::worklet::CrinkleClipTraits<PyFRData::CellSet>::CellSet
+  ClippedCellSet;
+
+// Apply a clip deferred by PyFRCrinkleClipFilter to the cells of a data set,
+// for the contouring paths that cannot evaluate the plane themselves
+ClippedCellSet ClipCellSet(const vtkm::cont::DataSet& dataSet,
+                           const vtkm::Vec<FPType,3>& origin,
+                           const vtkm::Vec<FPType,3>& normal)
+{
+  typedef PyFRData::Vec3ArrayHandle CoordinateArrayHandle;
+  typedef vtkm::Plane ImplicitFunction;
+
+  vtkm::ImplicitFunctionValue<ImplicitFunction>
+    function(ImplicitFunction(origin,normal));
+
+  CoordinateArrayHandle coords = dataSet.GetCoordinateSystem().GetData()
+    .CastToArrayHandle(CoordinateArrayHandle::ValueType(),
+                       CoordinateArrayHandle::StorageTag());
+
+  vtkm::cont::ArrayHandleTransform<FPType,CoordinateArrayHandle,
+    vtkm::ImplicitFunctionValue<ImplicitFunction> > dataArray(coords,function);
+
+  vtkm::cont::ArrayHandleConstant<FPType> clipArray(0.,
+                                                    coords.GetNumberOfValues());
+
+  vtkm::cont::DataSet clipped;
+  vtkm::worklet::CrinkleClip< ::PyFRDeviceAdapter>().Run(
+    dataArray,
+    clipArray,
+    vtkm::SortLess(),
+    dataSet.GetCellSet().CastTo(PyFRData::CellSet()),
+    dataSet.GetCoordinateSystem(),
+    clipped);
+  return clipped.GetCellSet().CastTo(ClippedCellSet());
+}
+
+// Map those of the fields held with the given storage, with output[i][iso]
+// receiving fields[i] on isosurface iso
+template<typename StorageTag,typename IsosurfaceFilter>
+void MapFieldsWithStorage(IsosurfaceFilter& filter,
+                          const std::vector<FieldArrayHandle>& fields,
+                          std::vector<FieldHandleVec>& output)
+{
+  std::vector<vtkm::cont::ArrayHandle<FPType,StorageTag> > fieldsIn;
+  std::vector<FieldHandleVec> fieldsOut;
+  for (std::size_t i=0;i<fields.size();i++)
+    {
+    bool gathered = false;
+    fields[i].CastAndCall(GatherFieldFunctor<StorageTag>(fieldsIn,gathered));
+    if (gathered)
+      fieldsOut.push_back(output[i]);
+    }
+
+  if (!fieldsIn.empty())
+    filter.MapFieldsOntoIsosurfaces(fieldsIn,fieldsOut);
+}
+}
+
 //----------------------------------------------------------------------------
-PyFRContourFilter::PyFRContourFilter() : ContourField(0)
+PyFRContourFilter::PyFRContourFilter() : ContourField(0),
+                                         Refinement(0),
+                                         MergeDuplicatePoints(false),
+                                         TemporalCoherence(false),
+                                         DirtyCellFraction(0.25),
+                                         UseBlockIndex(false),
+                                         UseFlyingEdges(false),
+                                         LastInput(NULL),
+                                         LastMeshRevision(0),
+                                         LastSolutionRevision(0),
+                                         LastContourField(-1)
 {
 }
 
@@ -24,13 +104,57 @@ void PyFRContourFilter::operator()(PyFRData* input,
   typedef vtkm::worklet::CrinkleClipTraits<typename PyFRData::CellSet>::CellSet
     CellSet;
 
-  const vtkm::cont::DataSet& dataSet = input->GetDataSet();
+  const unsigned nCellTypes = input->GetNumberOfCellTypes();
+  for (unsigned t=this->isosurfaceFilters.size();t<nCellTypes;t++)
+    this->isosurfaceFilters.push_back(IsosurfaceFilter());
+  this->isosurfaceFilters.resize(nCellTypes);
+  for (unsigned t=this->refinementFilters.size();t<nCellTypes;t++)
+    this->refinementFilters.push_back(RefinementFilter());
+  this->refinementFilters.resize(nCellTypes);
+  for (unsigned t=this->flyingEdgesFilters.size();t<nCellTypes;t++)
+    this->flyingEdgesFilters.push_back(FlyingEdgesFilter());
+  this->flyingEdgesFilters.resize(nCellTypes);
+  for (unsigned t=this->ClippedCellSets.size();t<nCellTypes;t++)
+    this->ClippedCellSets.push_back(ClippedCellSet());
+  this->ClippedCellSets.resize(nCellTypes);
+  this->Refined.assign(nCellTypes,false);
+  this->FlyingEdges.assign(nCellTypes,false);
 
-  vtkm::cont::Field contourField =
-    dataSet.GetField(PyFRData::FieldName(this->ContourField));
-  PyFRData::ScalarDataArrayHandle contourArray = contourField.GetData()
-    .CastToArrayHandle(PyFRData::ScalarDataArrayHandle::ValueType(),
-                       PyFRData::ScalarDataArrayHandle::StorageTag());
+  // The cells classified on the previous call are only valid for the same
+  // mesh
+  const bool meshChanged = (input != this->LastInput ||
+                            input->GetMeshRevision() != this->LastMeshRevision);
+  // The block indices are only valid for the same values of the same field
+  const bool fieldChanged =
+    (meshChanged ||
+     input->GetSolutionRevision() != this->LastSolutionRevision ||
+     this->ContourField != this->LastContourField);
+  this->LastInput = input;
+  this->LastMeshRevision = input->GetMeshRevision();
+  if (meshChanged || this->ClippedCells.size() != nCellTypes)
+    this->ClippedCells.assign(nCellTypes,false);
+  this->LastSolutionRevision = input->GetSolutionRevision();
+  this->LastContourField = this->ContourField;
+
+  for (unsigned t=0;t<nCellTypes;t++)
+    {
+    this->isosurfaceFilters[t].ResetTimings();
+    // Flying edges always merges points, so the cell types contoured with
+    // marching cubes (the refined ones) must be indexed as well
+    this->isosurfaceFilters[t]
+      .SetMergeDuplicatePoints(this->MergeDuplicatePoints ||
+                               this->UseFlyingEdges);
+    this->isosurfaceFilters[t].SetTemporalCoherence(this->TemporalCoherence);
+    this->isosurfaceFilters[t].SetDirtyCellFraction(this->DirtyCellFraction);
+    this->flyingEdgesFilters[t].ResetTimings();
+    if (meshChanged)
+      {
+      this->isosurfaceFilters[t].ResetCoherence();
+      this->flyingEdgesFilters[t].ResetTopology();
+      }
+    if (fieldChanged || !this->UseBlockIndex)
+      this->isosurfaceFilters[t].ClearBlockIndex();
+    }
 
   DataVec dataVec;
   Vec3HandleVec verticesVec;
@@ -43,12 +167,183 @@ void PyFRContourFilter::operator()(PyFRData* input,
     normalsVec.push_back(output->GetContour(i).GetNormals());
     }
 
-  isosurfaceFilter.Run(dataVec,
-                       dataSet.GetCellSet().CastTo(CellSet()),
-                       dataSet.GetCoordinateSystem(),
-                       contourArray,
-                       verticesVec,
-                       normalsVec);
+  // With a single cell type, the isosurfaces are written directly into the
+  // output. Otherwise, each cell type is contoured into its own arrays, which
+  // are then appended.
+  std::vector<Vec3HandleVec> verticesByType(nCellTypes);
+  std::vector<Vec3HandleVec> normalsByType(nCellTypes);
+  for (unsigned t=0;t<nCellTypes;t++)
+    {
+    const vtkm::cont::DataSet& dataSet = input->GetDataSet(t);
+
+    Vec3HandleVec& vertices = (nCellTypes == 1 ? verticesVec :
+                               verticesByType[t]);
+    Vec3HandleVec& normals = (nCellTypes == 1 ? normalsVec :
+                              normalsByType[t]);
+
+    vtkm::cont::DynamicArrayHandleBase<PyFRData::FieldTypeList,
+      PyFRData::FieldStorageList> contourArray =
+      input->GetField(t,this->ContourField).GetData()
+      .ResetTypeList(PyFRData::FieldTypeList())
+      .ResetStorageList(PyFRData::FieldStorageList());
+
+    const int nodesPerEdge = input->GetNodesPerEdge(t);
+    const bool refine = (this->Refinement > 1 && nodesPerEdge > 1);
+
+    // A clip deferred to this filter is evaluated by the marching cubes
+    // classification, directly over the unclipped cells. The refined and
+    // flying edges paths clip the cells first, as the clip filter would have.
+    this->isosurfaceFilters[t].ClearClipPlane();
+    this->isosurfaceFilters[t].SetElementLayout(0,0);
+
+    // The normals are interpolated from the gradients of the elements'
+    // basis; the refined points are laid out as elements of Refinement
+    // points along each edge
+    this->isosurfaceFilters[t].SetNodesPerEdge(refine ? this->Refinement :
+                                               nodesPerEdge);
+    this->flyingEdgesFilters[t].SetNodesPerEdge(nodesPerEdge);
+    if (input->IsClipDeferred() && !refine && !this->UseFlyingEdges)
+      {
+      // The unclipped cells of each element are consecutive, since the
+      // elements are reordered whole
+      if (nodesPerEdge > 1)
+        this->isosurfaceFilters[t].SetElementLayout(
+          nodesPerEdge*nodesPerEdge*nodesPerEdge,
+          (nodesPerEdge - 1)*(nodesPerEdge - 1)*(nodesPerEdge - 1));
+      this->isosurfaceFilters[t].SetClipPlane(input->GetClipOrigin(),
+                                              input->GetClipNormal());
+      PyFRData::CellSet cellSet =
+        dataSet.GetCellSet().CastTo(PyFRData::CellSet());
+
+      if (this->UseBlockIndex && !this->isosurfaceFilters[t].HasBlockIndex())
+        contourArray.CastAndCall(
+          BuildBlockIndexFunctor<IsosurfaceFilter>(
+            &this->isosurfaceFilters[t],cellSet.GetNumberOfCells()));
+
+      RunIsosurfaceFunctor<IsosurfaceFilter,PyFRData::CellSet,Vec3HandleVec>
+        run(&this->isosurfaceFilters[t],
+            dataVec,
+            cellSet,
+            dataSet.GetCoordinateSystem(),
+            vertices,
+            normals);
+      contourArray.CastAndCall(run);
+      continue;
+      }
+
+    if (input->IsClipDeferred() && !this->ClippedCells[t])
+      {
+      this->ClippedCellSets[t] = ClipCellSet(dataSet,input->GetClipOrigin(),
+                                             input->GetClipNormal());
+      this->ClippedCells[t] = true;
+      }
+    CellSet cellSet = (input->IsClipDeferred() ? this->ClippedCellSets[t] :
+                       dataSet.GetCellSet().CastTo(CellSet()));
+
+    if (refine)
+      {
+      // The refinement only resamples the elements that the isovalues cross,
+      // which already skips the isovalues outside of the field's range, and
+      // its cells change with the isovalues, so they are not indexed
+      this->isosurfaceFilters[t].SetTemporalCoherence(false);
+      this->isosurfaceFilters[t].ClearBlockIndex();
+      // The refinement resamples every element that holds a clipped cell,
+      // so its own cells are clipped by the plane as well
+      if (input->HasClipPlane())
+        this->isosurfaceFilters[t].SetClipPlane(input->GetClipOrigin(),
+                                                input->GetClipNormal());
+      PyFRData::Vec3ArrayHandle coords =
+        dataSet.GetCoordinateSystem().GetData()
+        .CastToArrayHandle(PyFRData::Vec3ArrayHandle::ValueType(),
+                           PyFRData::Vec3ArrayHandle::StorageTag());
+      RunRefinedIsosurfaceFunctor<IsosurfaceFilter,RefinementFilter,CellSet,
+        PyFRData::Vec3ArrayHandle,Vec3HandleVec>
+        run(&this->isosurfaceFilters[t],
+            &this->refinementFilters[t],
+            dataVec,
+            cellSet,
+            coords,
+            nodesPerEdge,
+            this->Refinement,
+            vertices,
+            normals);
+      contourArray.CastAndCall(run);
+      this->Refined[t] = true;
+      continue;
+      }
+
+    if (this->UseFlyingEdges)
+      {
+      RunIsosurfaceFunctor<FlyingEdgesFilter,CellSet,Vec3HandleVec>
+        run(&this->flyingEdgesFilters[t],
+            dataVec,
+            cellSet,
+            dataSet.GetCoordinateSystem(),
+            vertices,
+            normals);
+      contourArray.CastAndCall(run);
+      this->FlyingEdges[t] = true;
+      continue;
+      }
+
+    // The cells were clipped upstream, so each element holds only some of
+    // its cells, but they are still in element order, which coherence can
+    // use. Without whole elements there are no blocks to index, but the
+    // field's range still skips the isovalues outside of it.
+    if (nodesPerEdge > 1)
+      this->isosurfaceFilters[t].SetElementLayout(
+        nodesPerEdge*nodesPerEdge*nodesPerEdge,0);
+    if (this->UseBlockIndex && !this->isosurfaceFilters[t].HasBlockIndex())
+      contourArray.CastAndCall(
+        BuildBlockIndexFunctor<IsosurfaceFilter>(
+          &this->isosurfaceFilters[t],cellSet.GetNumberOfCells()));
+    RunIsosurfaceFunctor<IsosurfaceFilter,CellSet,Vec3HandleVec>
+      run(&this->isosurfaceFilters[t],
+          dataVec,
+          cellSet,
+          dataSet.GetCoordinateSystem(),
+          vertices,
+          normals);
+    contourArray.CastAndCall(run);
+    }
+
+  // Gather the triangle indices of each contour, offsetting those of each
+  // cell type by the vertices of the cell types preceding it. Without merged
+  // points or flying edges there are no indices, and the contours are left
+  // unindexed.
+  vtkm::worklet::AppendArrays<DeviceTag> append;
+  for (unsigned i=0;i<output->GetNumberOfContours();i++)
+    {
+    std::vector<vtkm::cont::ArrayHandle<vtkm::Id> > indices;
+    std::vector<vtkm::Id> indexOffsets;
+    vtkm::Id indexOffset = 0;
+    for (unsigned t=0;t<nCellTypes;t++)
+      {
+      indices.push_back(this->ContourFilter(t).GetIndices()[i]);
+      indexOffsets.push_back(indexOffset);
+      indexOffset += (nCellTypes == 1 ? verticesVec[i] :
+                      verticesByType[t][i]).GetNumberOfValues();
+      }
+    PyFRContour::IndexArrayHandle contourIndices =
+      output->GetContour(i).GetIndices();
+    append.RunIndices(indices,indexOffsets,contourIndices);
+    }
+
+  if (nCellTypes == 1)
+    return;
+
+  for (unsigned i=0;i<output->GetNumberOfContours();i++)
+    {
+    Vec3HandleVec vertices;
+    Vec3HandleVec normals;
+    for (unsigned t=0;t<nCellTypes;t++)
+      {
+      vertices.push_back(verticesByType[t][i]);
+      normals.push_back(normalsByType[t][i]);
+      }
+    append.Run(vertices,verticesVec[i]);
+    append.Run(normals,normalsVec[i]);
+    }
 }
 
 //----------------------------------------------------------------------------
@@ -57,26 +352,179 @@ void PyFRContourFilter::MapFieldOntoIsosurfaces(int field,
                                                 PyFRContourData* output)
 {
   typedef std::vector<PyFRContour::ScalarDataArrayHandle> ScalarDataHandleVec;
+  typedef std::vector<vtkm::cont::ArrayHandle<FPType> > FieldHandleVec;
 
-  const vtkm::cont::DataSet& dataSet = input->GetDataSet();
+  const unsigned nCellTypes = input->GetNumberOfCellTypes();
 
   ScalarDataHandleVec scalarDataHandleVec;
   for (unsigned j=0;j<output->GetNumberOfContours();j++)
     {
     output->GetContour(j).SetScalarDataType(field);
+    output->GetContour(j).SetScalarDataName(input->GetFieldName(field));
     PyFRContour::ScalarDataArrayHandle scalars_out =
       output->GetContour(j).GetScalarData();
 
     scalarDataHandleVec.push_back(scalars_out);
     }
 
-  vtkm::cont::Field projectedField =
-    dataSet.GetField(PyFRData::FieldName(field));
+  std::vector<FieldHandleVec> scalarsByType(nCellTypes);
+  for (unsigned t=0;t<nCellTypes;t++)
+    {
+    vtkm::cont::DynamicArrayHandleBase<PyFRData::FieldTypeList,
+      PyFRData::FieldStorageList> projectedArray =
+      input->GetField(t,field).GetData()
+      .ResetTypeList(PyFRData::FieldTypeList())
+      .ResetStorageList(PyFRData::FieldStorageList());
+
+    const bool refined = (t < this->Refined.size() && this->Refined[t]);
+
+    if (nCellTypes == 1)
+      {
+      if (refined)
+        projectedArray.CastAndCall(
+          MapRefinedFieldFunctor<IsosurfaceFilter,RefinementFilter,
+            PyFRContour::ScalarDataArrayHandle>(
+              &this->ContourFilter(t),&this->refinementFilters[t],
+              scalarDataHandleVec));
+      else
+        projectedArray.CastAndCall(
+          MapFieldFunctor<IsosurfaceFilter,PyFRContour::ScalarDataArrayHandle>(
+            &this->ContourFilter(t),scalarDataHandleVec));
+      return;
+      }
+
+    // NB: Cannot call resize to increase the lengths of vectors of array
+    // handles!
+    for (unsigned j=0;j<output->GetNumberOfContours();j++)
+      scalarsByType[t].push_back(vtkm::cont::ArrayHandle<FPType>());
+    if (refined)
+      projectedArray.CastAndCall(
+        MapRefinedFieldFunctor<IsosurfaceFilter,RefinementFilter,
+          vtkm::cont::ArrayHandle<FPType> >(
+            &this->ContourFilter(t),&this->refinementFilters[t],
+            scalarsByType[t]));
+    else
+      projectedArray.CastAndCall(
+        MapFieldFunctor<IsosurfaceFilter,vtkm::cont::ArrayHandle<FPType> >(
+          &this->ContourFilter(t),scalarsByType[t]));
+    }
+
+  vtkm::worklet::AppendArrays<DeviceTag> append;
+  for (unsigned j=0;j<output->GetNumberOfContours();j++)
+    {
+    FieldHandleVec scalars;
+    for (unsigned t=0;t<nCellTypes;t++)
+      scalars.push_back(scalarsByType[t][j]);
+    append.Run(scalars,scalarDataHandleVec[j]);
+    }
+}
+
+//----------------------------------------------------------------------------
+void PyFRContourFilter::MapFieldsOntoIsosurfaces(const std::vector<int>& fields,
+                                                 PyFRData* input,
+                                                 PyFRContourData* output)
+{
+  typedef vtkm::cont::ArrayHandle<FPType> FieldHandle;
+
+  const unsigned nCellTypes = input->GetNumberOfCellTypes();
+  const unsigned nContours = output->GetNumberOfContours();
 
-  PyFRData::ScalarDataArrayHandle projectedArray = projectedField.GetData()
-    .CastToArrayHandle(PyFRData::ScalarDataArrayHandle::ValueType(),
-                       PyFRData::ScalarDataArrayHandle::StorageTag());
+  for (unsigned j=0;j<nContours;j++)
+    {
+    PyFRContour& contour = output->GetContour(j);
+    contour.SetNumberOfFields(fields.size());
+    for (unsigned i=0;i<fields.size();i++)
+      contour.SetFieldName(i,input->GetFieldName(fields[i]));
+    }
 
-  isosurfaceFilter.MapFieldOntoIsosurfaces(projectedArray,
-                                           scalarDataHandleVec);
+  // With a single cell type, the fields are written directly into the
+  // contours. Otherwise, each cell type is mapped into its own arrays, which
+  // are then appended. Either way, mapped[t][i][j] receives field i on
+  // contour j for cell type t.
+  std::vector<std::vector<FieldHandleVec> > mapped(nCellTypes);
+  for (unsigned t=0;t<nCellTypes;t++)
+    {
+    // NB: Cannot call resize to increase the lengths of vectors of array
+    // handles!
+    mapped[t].resize(fields.size());
+    for (unsigned i=0;i<fields.size();i++)
+      for (unsigned j=0;j<nContours;j++)
+        mapped[t][i].push_back(nCellTypes == 1 ?
+                               FieldHandle(output->GetContour(j).GetField(i)) :
+                               FieldHandle());
+
+    std::vector<FieldArrayHandle> fieldArrays;
+    for (unsigned i=0;i<fields.size();i++)
+      fieldArrays.push_back(input->GetField(t,fields[i]).GetData()
+                            .ResetTypeList(PyFRData::FieldTypeList())
+                            .ResetStorageList(PyFRData::FieldStorageList()));
+
+    if (t < this->Refined.size() && this->Refined[t])
+      {
+      // The fields are resampled on the refined elements first, after which
+      // they all share the same storage
+      std::vector<FieldHandle> refinedFields;
+      for (unsigned i=0;i<fields.size();i++)
+        {
+        refinedFields.push_back(FieldHandle());
+        fieldArrays[i].CastAndCall(
+          RefineFieldFunctor<RefinementFilter>(&this->refinementFilters[t],
+                                               refinedFields.back()));
+        }
+      this->ContourFilter(t).MapFieldsOntoIsosurfaces(refinedFields,
+                                                      mapped[t]);
+      continue;
+      }
+
+    MapFieldsWithStorage<PyFRData::ScalarDataArrayHandle::StorageTag>(
+      this->ContourFilter(t),fieldArrays,mapped[t]);
+    MapFieldsWithStorage<PyFRData::VelocityArrayHandle::StorageTag>(
+      this->ContourFilter(t),fieldArrays,mapped[t]);
+    MapFieldsWithStorage<PyFRData::SpeedArrayHandle::StorageTag>(
+      this->ContourFilter(t),fieldArrays,mapped[t]);
+    MapFieldsWithStorage<PyFRData::ThermodynamicArrayHandle::StorageTag>(
+      this->ContourFilter(t),fieldArrays,mapped[t]);
+    MapFieldsWithStorage<PyFRData::MaterializedDataArrayHandle::StorageTag>(
+      this->ContourFilter(t),fieldArrays,mapped[t]);
+    }
+
+  if (nCellTypes == 1)
+    return;
+
+  vtkm::worklet::AppendArrays<DeviceTag> append;
+  for (unsigned i=0;i<fields.size();i++)
+    for (unsigned j=0;j<nContours;j++)
+      {
+      FieldHandleVec byType;
+      for (unsigned t=0;t<nCellTypes;t++)
+        byType.push_back(mapped[t][i][j]);
+      PyFRContour::FieldArrayHandle field = output->GetContour(j).GetField(i);
+      append.Run(byType,field);
+      }
+}
+
+//----------------------------------------------------------------------------
+vtkm::worklet::IsosurfaceTimings PyFRContourFilter::GetTimings() const
+{
+  vtkm::worklet::IsosurfaceTimings timings;
+  for (unsigned t=0;t<this->isosurfaceFilters.size();t++)
+    timings += this->ContourFilter(t).GetTimings();
+  return timings;
+}
+
+//----------------------------------------------------------------------------
+PyFRContourFilter::IsosurfaceFilter& PyFRContourFilter::ContourFilter(unsigned t)
+{
+  if (t < this->FlyingEdges.size() && this->FlyingEdges[t])
+    return this->flyingEdgesFilters[t];
+  return this->isosurfaceFilters[t];
+}
+
+//----------------------------------------------------------------------------
+const PyFRContourFilter::IsosurfaceFilter&
+PyFRContourFilter::ContourFilter(unsigned t) const
+{
+  if (t < this->FlyingEdges.size() && this->FlyingEdges[t])
+    return this->flyingEdgesFilters[t];
+  return this->isosurfaceFilters[t];
 }
@@ -6,19 +6,28 @@
 #include <string>
 #include <vector>
 
-#include <vtkm/cont/cuda/DeviceAdapterCuda.h>
+#include "PyFRDeviceAdapter.h"
+#include "CrinkleClip.h"
+#include "FlyingEdgesHexahedra.h"
+#include "HighOrderRefinement.h"
 #include "IsosurfaceHexahedra.h"
+#include "PyFRData.h"
 
-class PyFRData;
 class PyFRContourData;
 
 class PyFRContourFilter
 {
 private:
-  typedef vtkm::cont::DeviceAdapterTagCuda CudaTag;
+  typedef ::PyFRDeviceAdapter DeviceTag;
 
-  typedef vtkm::worklet::IsosurfaceFilterHexahedra<FPType,CudaTag>
+  typedef vtkm::worklet::IsosurfaceFilterHexahedra<FPType,DeviceTag>
   IsosurfaceFilter;
+  typedef vtkm::worklet::FlyingEdgesHexahedra<FPType,DeviceTag>
+  FlyingEdgesFilter;
+  typedef vtkm::worklet::HighOrderRefinement<FPType,DeviceTag>
+  RefinementFilter;
+  typedef vtkm::worklet::CrinkleClipTraits<PyFRData::CellSet>::CellSet
+  ClippedCellSet;
 
 public:
   PyFRContourFilter();
@@ -29,12 +38,93 @@ public:
 
   void SetContourField(int i) { this->ContourField = i; }
 
+  // Contour the high-order hexahedra by resampling the elements that the
+  // isovalues cross with n points per edge, rather than contouring their
+  // linear subdivision. Values below 2 disable refinement.
+  void SetRefinement(unsigned n) { this->Refinement = n; }
+  unsigned GetRefinement() const { return this->Refinement; }
+
+  // Share the vertices of each contour between its triangles, which are then
+  // given by the contour's indices
+  void SetMergeDuplicatePoints(bool b) { this->MergeDuplicatePoints = b; }
+  bool GetMergeDuplicatePoints() const { return this->MergeDuplicatePoints; }
+
+  // Reuse the previous call's cell classification for the isovalues that no
+  // point has crossed since (see vtkm::worklet::IsosurfaceCoherence). For
+  // the hexahedral cell types, whose cells are in element order (even when
+  // clipped or reordered), only the elements whose points crossed are
+  // classified again. This requires the filter to persist across time steps.
+  // Refined cell types are always contoured in full, since their cells
+  // follow the isovalues.
+  void SetTemporalCoherence(bool b) { this->TemporalCoherence = b; }
+  bool GetTemporalCoherence() const { return this->TemporalCoherence; }
+
+  // With temporal coherence, the fraction of the cells above which the
+  // elements whose points crossed are not classified alone, but with all of
+  // the others (0.25 by default)
+  void SetDirtyCellFraction(double f) { this->DirtyCellFraction = f; }
+  double GetDirtyCellFraction() const { return this->DirtyCellFraction; }
+
+  // Index the contour field's range, so that the isovalues outside of it are
+  // not contoured, and over blocks of elements, so that only the cells of
+  // blocks an isovalue crosses are classified (see
+  // vtkm::worklet::IsosurfaceBlockIndex). The blocks apply to the hexahedral
+  // cell types whose cells are laid out by element (not clipped upstream). The index is rebuilt whenever the solution or contour field
+  // changes, so it only pays off when the same solution is contoured
+  // repeatedly, e.g. while adjusting the isovalues.
+  void SetUseBlockIndex(bool b) { this->UseBlockIndex = b; }
+  bool GetUseBlockIndex() const { return this->UseBlockIndex; }
+
+  // Contour with the edge-centric engine (see
+  // vtkm::worklet::FlyingEdgesHexahedra), which classifies each edge once
+  // and always merges the contours' points. Temporal coherence and the block
+  // index only apply to the default marching cubes engine, and refined cell
+  // types are always contoured with it.
+  void SetUseFlyingEdges(bool b) { this->UseFlyingEdges = b; }
+  bool GetUseFlyingEdges() const { return this->UseFlyingEdges; }
+
   void operator ()(PyFRData*,PyFRContourData*);
   void MapFieldOntoIsosurfaces(int,PyFRData*,PyFRContourData*);
+  // Map several fields onto the isosurfaces as additional contour fields.
+  // Fields that share an array type are interpolated by a single kernel.
+  void MapFieldsOntoIsosurfaces(const std::vector<int>&,PyFRData*,
+                                PyFRContourData*);
+
+  // Time spent in each phase of the last contouring, over all cell types
+  vtkm::worklet::IsosurfaceTimings GetTimings() const;
 
 protected:
-  IsosurfaceFilter isosurfaceFilter;
+  // The filter that last contoured cell type t, whose interpolation weights
+  // map fields onto its portion of the isosurfaces
+  IsosurfaceFilter& ContourFilter(unsigned t);
+  const IsosurfaceFilter& ContourFilter(unsigned t) const;
+
+  // One isosurface filter per cell type, since each holds the interpolation
+  // weights used to map fields onto its portion of the isosurfaces.
+  std::vector<IsosurfaceFilter> isosurfaceFilters;
+  std::vector<FlyingEdgesFilter> flyingEdgesFilters;
+  std::vector<bool> FlyingEdges;
+  // The active elements of each refined cell type, reused when mapping fields
+  std::vector<RefinementFilter> refinementFilters;
+  std::vector<bool> Refined;
+  // The cells of each type kept by a deferred clip, for the paths that
+  // cannot apply the plane themselves. They only depend upon the mesh (the
+  // clip filter marks a new plane as a new mesh revision).
+  std::vector<ClippedCellSet> ClippedCellSets;
+  std::vector<bool> ClippedCells;
   std::vector<FPType> ContourValues;
   int ContourField;
+  unsigned Refinement;
+  bool MergeDuplicatePoints;
+  bool TemporalCoherence;
+  double DirtyCellFraction;
+  bool UseBlockIndex;
+  bool UseFlyingEdges;
+  // The input and mesh that the coherence of the isosurface filters refers to
+  const PyFRData* LastInput;
+  unsigned long LastMeshRevision;
+  // The solution and field that the block indices were built from
+  unsigned long LastSolutionRevision;
+  int LastContourField;
 };
 #endif
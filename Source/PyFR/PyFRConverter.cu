@@ -1,7 +1,9 @@
+#include <algorithm>
 #include <cmath>
 #include <iomanip>
 #include <string>
 #include <sstream>
+#include <vector>
 
 #include "PyFRConverter.h"
 
@@ -18,7 +20,6 @@
 #include "vtkErrorCode.h"
 #include "vtkExecutive.h"
 #include <vtkFloatArray.h>
-#include <vtkHexahedron.h>
 #include <vtkIdTypeArray.h>
 #include <vtkNew.h>
 #include <vtkObjectFactory.h>
@@ -33,8 +34,7 @@
 #include <vtkm/cont/DeviceAdapterAlgorithm.h>
 #include <vtkm/cont/DeviceAdapterSerial.h>
 #include <vtkm/cont/DynamicArrayHandle.h>
-#include <vtkm/cont/cuda/ArrayHandleCuda.h>
-#include <vtkm/cont/cuda/DeviceAdapterCuda.h>
+#include "PyFRDeviceAdapter.h"
 
 #include "ArrayHandleExposed.h"
 #include "PyFRData.h"
@@ -67,89 +67,178 @@ PyFRConverter::~PyFRConverter()
 }
 
 //----------------------------------------------------------------------------
-void PyFRConverter::operator ()(const PyFRData* pyfrData,vtkUnstructuredGrid* grid) const
+namespace
+{
+class CopyToHost
+{
+public:
+  CopyToHost(FPType* destination) : Destination(destination) {}
+
+  template<typename StorageTag>
+  void operator()(const vtkm::cont::ArrayHandle<FPType,StorageTag>& array) const
+  {
+    vtkm::cont::ArrayHandleExposed<FPType> host;
+    vtkm::cont::DeviceAdapterAlgorithm< ::PyFRDeviceAdapter>().
+      Copy(array, host);
+    std::copy(host.Storage().GetArray(),
+              host.Storage().GetArray() + host.GetNumberOfValues(),
+              this->Destination);
+  }
+
+private:
+  FPType* Destination;
+};
+
+// Non-hexahedral cells are stored as degenerate hexahedra (see PyFRData.cu).
+// Recover the original cell from the pattern of repeated vertices.
+int CollapseHexahedron(const vtkIdType hex[8], vtkIdType& nIds, vtkIdType* ids)
 {
-  const vtkm::cont::DataSet& dataSet = pyfrData->GetDataSet();
+  static const int tet[4] = { 0, 1, 2, 4 };
+  static const int pyramid[5] = { 0, 1, 2, 3, 4 };
+  static const int wedge[6] = { 0, 1, 2, 4, 5, 6 };
 
+  bool apex = (hex[4] == hex[5] && hex[5] == hex[6] && hex[6] == hex[7]);
+  if (hex[2] == hex[3] && apex)
+    {
+    nIds = 4;
+    for (int i=0;i<nIds;i++) ids[i] = hex[tet[i]];
+    return VTK_TETRA;
+    }
+  if (apex)
+    {
+    nIds = 5;
+    for (int i=0;i<nIds;i++) ids[i] = hex[pyramid[i]];
+    return VTK_PYRAMID;
+    }
+  if (hex[2] == hex[3] && hex[6] == hex[7])
+    {
+    nIds = 6;
+    for (int i=0;i<nIds;i++) ids[i] = hex[wedge[i]];
+    return VTK_WEDGE;
+    }
+  nIds = 8;
+  for (int i=0;i<nIds;i++) ids[i] = hex[i];
+  return VTK_HEXAHEDRON;
+}
+}
+
+//----------------------------------------------------------------------------
+void PyFRConverter::operator ()(const PyFRData* pyfrData,vtkUnstructuredGrid* grid) const
+{
   namespace vtkmc = vtkm::cont;
-  typedef vtkmc::ArrayHandleExposed<FPType> ScalarDataArrayHandleExposed;
   typedef vtkmc::ArrayHandleExposed<vtkm::Vec<FPType,3> >
     Vec3ArrayHandleExposed;
-  typedef ::vtkm::cont::DeviceAdapterTagCuda CudaTag;
+  typedef ::PyFRDeviceAdapter DeviceTag;
 
-  Vec3ArrayHandleExposed vertices;
+  // Each cell type is held in its own data set, so the points, fields and
+  // cells of every cell type are appended into the single output grid.
+  const unsigned nCellTypes = pyfrData->GetNumberOfCellTypes();
+
+  vtkIdType nVerts = 0;
+  vtkIdType nCells = 0;
+  for (unsigned t=0;t<nCellTypes;t++)
     {
-    PyFRData::Vec3ArrayHandle tmp = dataSet.GetCoordinateSystem().GetData()
-      .CastToArrayHandle(PyFRData::Vec3ArrayHandle::ValueType(),
-                         PyFRData::Vec3ArrayHandle::StorageTag());
-    vtkm::cont::DeviceAdapterAlgorithm<CudaTag>().
-      Copy(tmp,vertices);
+    const vtkm::cont::DataSet& dataSet = pyfrData->GetDataSet(t);
+    nVerts += dataSet.GetCoordinateSystem().GetData().GetNumberOfValues();
+    PyFRData::CellSet cellSet =
+      dataSet.GetCellSet().CastTo(PyFRData::CellSet());
+    nCells += cellSet.GetConnectivityArray(vtkm::TopologyElementTagPoint(),
+                                         vtkm::TopologyElementTagCell())
+      .GetNumberOfValues()/8;
     }
 
   vtkSmartPointer<ArrayChoice<FPType>::type> pointData =
     vtkSmartPointer<ArrayChoice<FPType>::type>::New();
-
-  vtkIdType nVerts = vertices.GetNumberOfValues();
-  FPType* vertsArray = reinterpret_cast<FPType*>(vertices.Storage().StealArray());
-  pointData->SetArray(vertsArray, nVerts*3,
-                      0, // give VTK control of the data
-                      0);// delete using "free"
   pointData->SetNumberOfComponents(3);
-
-  vtkSmartPointer<vtkPoints> points = vtkSmartPointer<vtkPoints>::New();
-  points->SetData(pointData);
-
-  vtkSmartPointer<ArrayChoice<FPType>::type> solutionData[5];
-  for (unsigned i=0;i<5;i++)
+  pointData->SetNumberOfTuples(nVerts);
+
+  // Only the fields requested of the data are converted; the others are
+  // bound to empty arrays (see PyFRData::SetRequestedFields())
+  std::vector<unsigned> fields;
+  for (unsigned i=0;i<pyfrData->GetNumberOfFields();i++)
+    if (pyfrData->IsFieldRequested(i))
+      fields.push_back(i);
+
+  const unsigned nFields = fields.size();
+  std::vector<vtkSmartPointer<ArrayChoice<FPType>::type> > solutionData;
+  for (unsigned i=0;i<nFields;i++)
     {
-    vtkmc::Field solution = dataSet.GetField(PyFRData::FieldName(i));
-    PyFRData::ScalarDataArrayHandle solutionArray = solution.GetData()
-      .CastToArrayHandle(PyFRData::ScalarDataArrayHandle::ValueType(),
-                         PyFRData::ScalarDataArrayHandle::StorageTag());
-    ScalarDataArrayHandleExposed solutionArrayHost;
-    vtkm::cont::DeviceAdapterAlgorithm<CudaTag>().
-      Copy(solutionArray, solutionArrayHost);
-
-    solutionData[i] = vtkSmartPointer<ArrayChoice<FPType>::type>::New();
-    vtkIdType nSolution = solutionArrayHost.GetNumberOfValues();
-    FPType* solutionArr = solutionArrayHost.Storage().StealArray();
-    solutionData[i]->SetArray(solutionArr, nSolution,
-                           0, // give VTK control of the data
-                           0);// delete using "free"
+    solutionData.push_back(vtkSmartPointer<ArrayChoice<FPType>::type>::New());
     solutionData[i]->SetNumberOfComponents(1);
-    solutionData[i]->SetName(PyFRData::FieldName(i).c_str());
+    solutionData[i]->SetNumberOfTuples(nVerts);
+    solutionData[i]->SetName(pyfrData->GetFieldName(fields[i]).c_str());
     }
 
-  PyFRData::CellSet cellSet = dataSet.GetCellSet().CastTo(PyFRData::CellSet());
+  grid->Allocate(nCells);
+
+  vtkIdType pointOffset = 0;
+  for (unsigned t=0;t<nCellTypes;t++)
+    {
+    const vtkm::cont::DataSet& dataSet = pyfrData->GetDataSet(t);
+
+    Vec3ArrayHandleExposed vertices;
+      {
+      PyFRData::Vec3ArrayHandle tmp = dataSet.GetCoordinateSystem().GetData()
+        .CastToArrayHandle(PyFRData::Vec3ArrayHandle::ValueType(),
+                           PyFRData::Vec3ArrayHandle::StorageTag());
+      vtkm::cont::DeviceAdapterAlgorithm<DeviceTag>().
+        Copy(tmp,vertices);
+      }
+
+    vtkIdType nTypeVerts = vertices.GetNumberOfValues();
+    std::copy(reinterpret_cast<FPType*>(vertices.Storage().GetArray()),
+              reinterpret_cast<FPType*>(vertices.Storage().GetArray()) +
+              nTypeVerts*3,
+              pointData->GetPointer(pointOffset*3));
+
+    for (unsigned i=0;i<nFields;i++)
+      {
+      pyfrData->GetField(t,fields[i]).GetData()
+        .ResetTypeList(PyFRData::FieldTypeList())
+        .ResetStorageList(PyFRData::FieldStorageList())
+        .CastAndCall(CopyToHost(solutionData[i]->GetPointer(pointOffset)));
+      }
 
-    vtkm::cont::ArrayHandle<vtkm::Id> connectivity =
+    PyFRData::CellSet cellSet =
+      dataSet.GetCellSet().CastTo(PyFRData::CellSet());
+
+    PyFRData::ConnectivityArrayHandle connectivity =
       cellSet.GetConnectivityArray(vtkm::TopologyElementTagPoint(),
                                    vtkm::TopologyElementTagCell());
-    vtkm::cont::ArrayHandle<vtkm::Id>::PortalConstControl portal =
+    PyFRData::ConnectivityArrayHandle::PortalConstControl portal =
       connectivity.GetPortalConstControl();
 
-  grid->Allocate(connectivity.GetNumberOfValues()/8);
+    vtkIdType hex[8];
+    vtkIdType nIds;
+    vtkIdType ids[8];
+    vtkIdType counter = 0;
+    while (counter < connectivity.GetNumberOfValues())
+      {
+      for (vtkIdType j=0;j<8;j++)
+        {
+        hex[j] = pointOffset + portal.Get(counter++);
+        }
+      int cellType = CollapseHexahedron(hex,nIds,ids);
+      grid->InsertNextCell(cellType,nIds,ids);
+      }
+
+    pointOffset += nTypeVerts;
+    }
+
+  vtkSmartPointer<vtkPoints> points = vtkSmartPointer<vtkPoints>::New();
+  points->SetData(pointData);
+
   grid->SetPoints(points);
-  for (unsigned i=0;i<5;i++)
+  for (unsigned i=0;i<nFields;i++)
     {
     grid->GetPointData()->AddArray(solutionData[i]);
     }
-  vtkIdType counter = 0;
-  while (counter < connectivity.GetNumberOfValues())
-    {
-    vtkSmartPointer<vtkHexahedron> hex = vtkSmartPointer<vtkHexahedron>::New();
-    for (vtkIdType j=0;j<8;j++)
-      {
-      hex->GetPointIds()->SetId(j,portal.Get(counter++));
-      }
-    grid->InsertNextCell(hex->GetCellType(),hex->GetPointIds());
-    }
 }
 
 //----------------------------------------------------------------------------
 void PyFRConverter::operator ()(const PyFRContour& contour,vtkPolyData* polydata) const
 {
-  typedef ::vtkm::cont::DeviceAdapterTagCuda CudaTag;
+  typedef ::PyFRDeviceAdapter DeviceTag;
 
   typedef vtkm::cont::ArrayHandleExposed<vtkm::Vec<FPType,3> > Vec3ArrayHandle;
 
@@ -159,7 +248,7 @@ void PyFRConverter::operator ()(const PyFRContour& contour,vtkPolyData* polydata
     }
 
   PyFRContour::Vec3ArrayHandle verts_out;
-  vtkm::cont::DeviceAdapterAlgorithm<CudaTag>().
+  vtkm::cont::DeviceAdapterAlgorithm<DeviceTag>().
     Copy(contour.GetVertices(),verts_out);
 
   vtkSmartPointer<ArrayChoice<FPType>::type> pointData =
@@ -176,7 +265,7 @@ void PyFRConverter::operator ()(const PyFRContour& contour,vtkPolyData* polydata
   points->SetData(pointData);
 
   PyFRContour::Vec3ArrayHandle normals_out;
-  vtkm::cont::DeviceAdapterAlgorithm<CudaTag>().
+  vtkm::cont::DeviceAdapterAlgorithm<DeviceTag>().
     Copy(contour.GetNormals(),normals_out);
 
   vtkSmartPointer<ArrayChoice<FPType>::type> normalsData =
@@ -192,13 +281,32 @@ void PyFRConverter::operator ()(const PyFRContour& contour,vtkPolyData* polydata
   vtkSmartPointer<vtkCellArray> polys =
         vtkSmartPointer<vtkCellArray>::New();
   vtkIdType indices[3];
-  for (vtkIdType i=0;i<points->GetNumberOfPoints();i+=3)
+  if (contour.IsIndexed())
+    {
+    PyFRContour::IndexArrayHandle indices_out;
+    vtkm::cont::DeviceAdapterAlgorithm<DeviceTag>().
+      Copy(contour.GetIndices(),indices_out);
+    PyFRContour::IndexArrayHandle::PortalConstControl indicesPortal =
+      indices_out.GetPortalConstControl();
+    for (vtkIdType i=0;i<indices_out.GetNumberOfValues();i+=3)
+      {
+      for (vtkIdType j=0;j<3;j++)
+        {
+        indices[j] = indicesPortal.Get(i+j);
+        }
+      polys->InsertNextCell(3,indices);
+      }
+    }
+  else
     {
-    for (vtkIdType j=0;j<3;j++)
+    for (vtkIdType i=0;i<points->GetNumberOfPoints();i+=3)
       {
-      indices[j] = i+j;
+      for (vtkIdType j=0;j<3;j++)
+        {
+        indices[j] = i+j;
+        }
+      polys->InsertNextCell(3,indices);
       }
-    polys->InsertNextCell(3,indices);
     }
 
   polydata->SetPoints(points);
@@ -207,7 +315,7 @@ void PyFRConverter::operator ()(const PyFRContour& contour,vtkPolyData* polydata
 
   PyFRContour::ScalarDataArrayHandle scalarsOut = contour.GetScalarData();
   vtkm::cont::ArrayHandleExposed<FPType> scalarsOutHost;
-  vtkm::cont::DeviceAdapterAlgorithm<CudaTag>().
+  vtkm::cont::DeviceAdapterAlgorithm<DeviceTag>().
     Copy(scalarsOut,scalarsOutHost);
 
   vtkSmartPointer<ArrayChoice<FPType>::type> solutionData =
@@ -218,9 +326,28 @@ void PyFRConverter::operator ()(const PyFRContour& contour,vtkPolyData* polydata
                          0, // give VTK control of the data
                          0);// delete using "free"
   solutionData->SetNumberOfComponents(1);
-  solutionData->SetName(PyFRData::FieldName(contour.GetScalarDataType()).c_str());
+  solutionData->SetName(contour.GetScalarDataName().c_str());
 
   polydata->GetPointData()->AddArray(solutionData);
+
+  for (unsigned i=0;i<contour.GetNumberOfFields();i++)
+    {
+    PyFRContour::FieldArrayHandle fieldOutHost;
+    vtkm::cont::DeviceAdapterAlgorithm<DeviceTag>().
+      Copy(contour.GetField(i),fieldOutHost);
+
+    vtkSmartPointer<ArrayChoice<FPType>::type> fieldData =
+      vtkSmartPointer<ArrayChoice<FPType>::type>::New();
+    vtkIdType nField = fieldOutHost.GetNumberOfValues();
+    FPType* fieldArray = fieldOutHost.Storage().StealArray();
+    fieldData->SetArray(fieldArray, nField,
+                        0, // give VTK control of the data
+                        0);// delete using "free"
+    fieldData->SetNumberOfComponents(1);
+    fieldData->SetName(contour.GetFieldName(i).c_str());
+
+    polydata->GetPointData()->AddArray(fieldData);
+    }
 }
 
 //----------------------------------------------------------------------------
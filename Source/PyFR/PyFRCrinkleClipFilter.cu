@@ -5,12 +5,13 @@
 
 #include <vtkm/BinaryPredicates.h>
 #include <vtkm/ImplicitFunctions.h>
-#include <vtkm/cont/cuda/DeviceAdapterCuda.h>
+#include "PyFRDeviceAdapter.h"
 
 #include "CrinkleClip.h"
 #include "PyFRData.h"
 
-PyFRCrinkleClipFilter::PyFRCrinkleClipFilter()
+PyFRCrinkleClipFilter::PyFRCrinkleClipFilter() : ResolutionLevel(0),
+                                                 Deferred(false)
 {
   this->Origin[0] = this->Origin[1] = this->Origin[2] = 0.;
   this->Normal[0] = this->Normal[1] = 0.;
@@ -35,8 +36,8 @@ void PyFRCrinkleClipFilter::SetPlane(FPType origin_x,
 void PyFRCrinkleClipFilter::operator ()(PyFRData* inputData,
                                         PyFRData* outputData) const
 {
-  typedef ::vtkm::cont::DeviceAdapterTagCuda CudaTag;
-  typedef vtkm::worklet::CrinkleClip<CudaTag> CrinkleClip;
+  typedef ::PyFRDeviceAdapter DeviceTag;
+  typedef vtkm::worklet::CrinkleClip<DeviceTag> CrinkleClip;
   typedef PyFRData::Vec3ArrayHandle CoordinateArrayHandle;
   typedef vtkm::ListTagBase<PyFRData::CellSet> CellSetTag;
   typedef vtkm::Plane ImplicitFunction;
@@ -48,30 +49,87 @@ void PyFRCrinkleClipFilter::operator ()(PyFRData* inputData,
                                             this->Normal[1],
                                             this->Normal[2]));
 
-  const vtkm::cont::DataSet& input = inputData->GetDataSet();
-  vtkm::cont::DataSet& output = outputData->GetDataSet();
-  output.Clear();
+  vtkm::ImplicitFunctionValue<ImplicitFunction> function(func);
 
-  CoordinateArrayHandle coords = input.GetCoordinateSystem().GetData()
-    .CastToArrayHandle(CoordinateArrayHandle::ValueType(),
-                       CoordinateArrayHandle::StorageTag());
+  CrinkleClip crinkleClip;
 
-  vtkm::ImplicitFunctionValue<ImplicitFunction> function(func);
+  outputData->SetNumberOfCellTypes(inputData->GetNumberOfCellTypes());
+  outputData->SetFieldNames(inputData->GetFieldNames());
+  if (inputData->GetAllFieldsRequested())
+    outputData->RequestAllFields();
+  else
+    outputData->SetRequestedFields(inputData->GetRequestedFields());
+  outputData->SetNodesPerEdge(inputData->GetNodesPerEdge());
+  outputData->SetClipPlane(vtkm::Vec<FPType,3>(this->Origin[0],
+                                               this->Origin[1],
+                                               this->Origin[2]),
+                           vtkm::Vec<FPType,3>(this->Normal[0],
+                                               this->Normal[1],
+                                               this->Normal[2]),
+                           this->Deferred);
+  for (unsigned t=0;t<inputData->GetNumberOfCellTypes();t++)
+    {
+    const vtkm::cont::DataSet& input = inputData->GetDataSet(t);
+    vtkm::cont::DataSet& output = outputData->GetDataSet(t);
+    output.Clear();
 
-  vtkm::cont::ArrayHandleTransform<FPType,CoordinateArrayHandle,
-    vtkm::ImplicitFunctionValue<ImplicitFunction> > dataArray(coords,function);
+    if (this->Deferred)
+      {
+      output.AddCoordinateSystem(input.GetCoordinateSystem());
+      output.AddCellSet(inputData->GetCellSet(t,this->ResolutionLevel));
+      for (vtkm::IdComponent i=0;i<input.GetNumberOfFields();i++)
+        output.AddField(input.GetField(i));
+      continue;
+      }
 
-  vtkm::cont::ArrayHandleConstant<FPType> clipArray(0.,coords.GetNumberOfValues());
+    CoordinateArrayHandle coords = input.GetCoordinateSystem().GetData()
+      .CastToArrayHandle(CoordinateArrayHandle::ValueType(),
+                         CoordinateArrayHandle::StorageTag());
 
-  CrinkleClip crinkleClip;
+    vtkm::cont::ArrayHandleTransform<FPType,CoordinateArrayHandle,
+      vtkm::ImplicitFunctionValue<ImplicitFunction> > dataArray(coords,function);
+
+    vtkm::cont::ArrayHandleConstant<FPType> clipArray(0.,
+                                                      coords.GetNumberOfValues());
+
+    crinkleClip.Run(dataArray,
+                    clipArray,
+                    vtkm::SortLess(),
+                    inputData->GetCellSet(t,this->ResolutionLevel)
+                    .ResetCellSetList(CellSetTag()),
+                    input.GetCoordinateSystem(),
+                    output);
+
+    for (vtkm::IdComponent i=0;i<input.GetNumberOfFields();i++)
+      output.AddField(input.GetField(i));
+    }
+  outputData->IncrementMeshRevision();
+  outputData->IncrementSolutionRevision();
+}
+
+void PyFRCrinkleClipFilter::MapFields(PyFRData* inputData,
+                                      PyFRData* outputData) const
+{
+  outputData->SetFieldNames(inputData->GetFieldNames());
+  if (inputData->GetAllFieldsRequested())
+    outputData->RequestAllFields();
+  else
+    outputData->SetRequestedFields(inputData->GetRequestedFields());
+  for (unsigned t=0;t<inputData->GetNumberOfCellTypes();t++)
+    {
+    const vtkm::cont::DataSet& input = inputData->GetDataSet(t);
+    vtkm::cont::DataSet& output = outputData->GetDataSet(t);
 
-  crinkleClip.Run(dataArray,
-                  clipArray,
-                  vtkm::SortLess(),
-                  input.GetCellSet().ResetCellSetList(CellSetTag()),
-                  input.GetCoordinateSystem(),
-                  output);
+    // Data sets do not support replacing fields, so rebuild the output
+    // around its existing coordinates and clipped cell set.
+    vtkm::cont::CoordinateSystem coords = output.GetCoordinateSystem();
+    vtkm::cont::DynamicCellSet cellSet = output.GetCellSet();
+    output.Clear();
+    output.AddCoordinateSystem(coords);
+    output.AddCellSet(cellSet);
 
-  for (vtkm::IdComponent i=0;i<input.GetNumberOfFields();i++)
-    output.AddField(input.GetField(i));
+    for (vtkm::IdComponent i=0;i<input.GetNumberOfFields();i++)
+      output.AddField(input.GetField(i));
+    }
+  outputData->IncrementSolutionRevision();
 }
@@ -13,11 +13,29 @@ public:
 
   void SetPlane(FPType,FPType,FPType,FPType,FPType,FPType);
 
+  // Clip the cell set of the given resolution level (0 is the full
+  // resolution; see PyFRData::GetCellSet)
+  void SetResolutionLevel(unsigned level) { this->ResolutionLevel = level; }
+
+  // Rather than classifying the cells, pass them through unclipped and mark
+  // the plane recorded on the output (see PyFRData::SetClipPlane) as
+  // deferred, so that the contour filter applies it in its own
+  // classification pass. Only use this when every consumer of the output
+  // honors the plane.
+  void SetDeferred(bool b) { this->Deferred = b; }
+  bool GetDeferred() const { return this->Deferred; }
+
   void operator ()(PyFRData*,PyFRData*) const;
 
+  // Forward the input's current fields onto an already-clipped output, for
+  // time steps where only the solution has changed.
+  void MapFields(PyFRData*,PyFRData*) const;
+
   protected:
   FPType Origin[3];
   FPType Normal[3];
+  unsigned ResolutionLevel;
+  bool Deferred;
 };
 
 #endif
@@ -11,139 +11,741 @@
 #include <vtkm/CellShape.h>
 #include <vtkm/CellTraits.h>
 #include <vtkm/TopologyElementTag.h>
+#include <vtkm/cont/ArrayPortalToIterators.h>
 #include <vtkm/cont/CellSetSingleType.h>
 #include <vtkm/cont/CoordinateSystem.h>
 #include <vtkm/cont/DeviceAdapter.h>
 #include <vtkm/cont/DataSet.h>
 #include <vtkm/cont/Field.h>
-#include <vtkm/cont/cuda/DeviceAdapterCuda.h>
+#include "PyFRDeviceAdapter.h"
 
 #include "ArrayHandleExposed.h"
+#include "GradientFields.h"
+#include "MortonReorder.h"
 
 //------------------------------------------------------------------------------
-std::map<int,std::string> PyFRData::fieldName;
-std::map<std::string,int> PyFRData::fieldIndex;
-bool PyFRData::mapsPopulated = PyFRData::PopulateMaps();
+PyFRData::PyFRData() : catalystData(NULL),
+                       AllFieldsRequested(true),
+                       NumberOfVariables(0),
+                       ZeroCopyMesh(true),
+                       ReorderCells(false),
+                       MaterializeFields(false),
+                       Gamma(1.4),
+                       GasConstant(1.),
+                       MeshModified(true),
+                       MeshRevision(0),
+                       SolutionRevision(0),
+                       Clipped(false),
+                       ClipDeferred(false)
+{
+
+}
 
 //------------------------------------------------------------------------------
-bool PyFRData::PopulateMaps()
+PyFRData::~PyFRData()
 {
-  fieldName[0] = "density";
-  fieldName[1] = "pressure";
-  fieldName[2] = "velocity_u";
-  fieldName[3] = "velocity_v";
-  fieldName[4] = "velocity_w";
+}
 
-  for (unsigned i=0;i<5;i++)
-    fieldIndex[fieldName[i]] = i;
+//------------------------------------------------------------------------------
+void PyFRData::SetNumberOfCellTypes(unsigned n)
+{
+  this->dataSets.resize(n);
+}
 
+//------------------------------------------------------------------------------
+namespace
+{
+// Interpolation order of the solution fields
+enum ElemType { CONSTANT=0, LINEAR=1, QUADRATIC=2 };
+
+struct ZeroFunctor
+{
+  VTKM_EXEC_CONT_EXPORT
+  FPType operator()(vtkm::Id) const { return FPType(0); }
+};
+
+// PyFR describes its linear subcells using VTK cell type identifiers.
+enum VTKCellType { VTK_TETRA=10, VTK_HEXAHEDRON=12, VTK_WEDGE=13,
+                   VTK_PYRAMID=14 };
+
+// All of our worklets operate on hexahedra, so the other linear cell types
+// are promoted to degenerate hexahedra by repeating vertices. Marching cubes
+// on a collapsed hexahedron yields the same surface as on the original cell
+// (plus some zero-area triangles), and the converter recovers the original
+// cell type from the repeated vertices.
+const int tetToHex[8]     = { 0, 1, 2, 2, 3, 3, 3, 3 };
+const int wedgeToHex[8]   = { 0, 1, 2, 2, 3, 4, 5, 5 };
+const int pyramidToHex[8] = { 0, 1, 2, 3, 4, 4, 4, 4 };
+const int hexToHex[8]     = { 0, 1, 2, 3, 4, 5, 6, 7 };
+
+#ifdef PYFR_DEVICE_ADAPTER_CUDA
+bool IsDevicePointer(const void* ptr)
+{
+  cudaPointerAttributes attributes;
+  if (cudaPointerGetAttributes(&attributes, ptr) != cudaSuccess)
+    {
+    // Plain host allocations are reported as an error; clear it.
+    cudaGetLastError();
+    return false;
+    }
+  return attributes.memoryType == cudaMemoryTypeDevice;
+}
+
+// The length of a connectivity array of mixed linear cells, from the
+// offset and node count of each cell
+std::size_t ConnectivityLength(const MeshDataForCellType* meshData)
+{
+  std::size_t length = 0;
+  for (int32_t i=0;i<meshData->nSubdividedCells;i++)
+    {
+    int nodes = 0;
+    switch (meshData->type[i])
+      {
+      case VTK_TETRA:      nodes = 4; break;
+      case VTK_WEDGE:      nodes = 6; break;
+      case VTK_PYRAMID:    nodes = 5; break;
+      case VTK_HEXAHEDRON: nodes = 8; break;
+      }
+    length = std::max(length,
+                      static_cast<std::size_t>(meshData->off[i] + nodes));
+    }
+  return length;
+}
+#endif
+
+bool AllHexahedra(const MeshDataForCellType* meshData)
+{
+  for (int32_t i=0;i<meshData->nSubdividedCells;i++)
+    {
+    if (meshData->type[i] != VTK_HEXAHEDRON ||
+        meshData->off[i] != 8*i)
+      return false;
+    }
   return true;
 }
 
-//------------------------------------------------------------------------------
-PyFRData::PyFRData() : catalystData(NULL)
+// The number of solution points along each edge of a high-order hexahedron,
+// or 0 if the elements are not hexahedra.
+int HexahedronNodesPerEdge(const MeshDataForCellType* meshData)
 {
+  if (!AllHexahedra(meshData))
+    return 0;
+  int n = 2;
+  while (n*n*n < meshData->nVerticesPerCell)
+    n++;
+  return (n*n*n == meshData->nVerticesPerCell ? n : 0);
+}
 
+// Vertices in the pipeline's precision are wrapped in place or copied
+void LoadVertices(const PyFRData::Vec3ArrayHandle& input,
+                  PyFRData::Vec3ArrayHandle& vertices,
+                  bool zeroCopy)
+{
+  if (zeroCopy)
+    vertices = input;
+  else
+    vtkm::cont::DeviceAdapterAlgorithm< ::PyFRDeviceAdapter>().
+      Copy(input, vertices);
 }
 
-//------------------------------------------------------------------------------
-PyFRData::~PyFRData()
+// Other vertex arrays are converted to the pipeline's precision as they are
+// copied, once per mesh
+template<typename ArrayHandleType>
+void LoadVertices(const ArrayHandleType& input,
+                  PyFRData::Vec3ArrayHandle& vertices,
+                  bool)
+{
+  vtkm::cont::DeviceAdapterAlgorithm< ::PyFRDeviceAdapter>().
+    Copy(vtkm::cont::ArrayHandleCastForInput<PyFRData::Vec3ArrayHandle::
+         ValueType,ArrayHandleType>(input), vertices);
+}
+
+// Subdivide each hexahedron with n nodes per edge into m^3 linear cells
+// whose corners are the nodes nearest to an even m-way split of each edge
+void SubdivideHexahedra(int nCells, int n, int m,
+                        PyFRData::Int32ArrayHandle& connectivity)
+{
+  std::vector<int> split(m + 1);
+  for (int i=0;i<=m;i++)
+    split[i] = (2*i*(n - 1) + m)/(2*m);
+
+  connectivity.Allocate(static_cast<vtkm::Id>(nCells)*m*m*m*8);
+  PyFRData::Int32ArrayHandle::PortalControl portal =
+    connectivity.GetPortalControl();
+
+  static const int corner[8][3] = { {0,0,0}, {1,0,0}, {1,1,0}, {0,1,0},
+                                    {0,0,1}, {1,0,1}, {1,1,1}, {0,1,1} };
+  vtkm::Id counter = 0;
+  for (int cell=0;cell<nCells;cell++)
+    for (int k=0;k<m;k++)
+      for (int j=0;j<m;j++)
+        for (int i=0;i<m;i++)
+          for (int c=0;c<8;c++)
+            portal.Set(counter++, cell*n*n*n +
+                       split[i + corner[c][0]] +
+                       split[j + corner[c][1]]*n +
+                       split[k + corner[c][2]]*n*n);
+}
+
+// The connectivity is read on the host, so con is the host's copy of
+// meshData->con
+void PromoteToHexahedra(const MeshDataForCellType* meshData,
+                        const int32_t* con,
+                        PyFRData::Int32ArrayHandle& connectivity)
 {
+  connectivity.Allocate(meshData->nSubdividedCells*8);
+  PyFRData::Int32ArrayHandle::PortalControl portal =
+    connectivity.GetPortalControl();
+
+  for (int32_t i=0;i<meshData->nSubdividedCells;i++)
+    {
+    const int* map;
+    switch (meshData->type[i])
+      {
+      case VTK_TETRA:   map = tetToHex; break;
+      case VTK_WEDGE:   map = wedgeToHex; break;
+      case VTK_PYRAMID: map = pyramidToHex; break;
+      case VTK_HEXAHEDRON: map = hexToHex; break;
+      default:
+        {
+        std::stringstream s;
+        s << "PyFRData: unsupported cell type "
+          << static_cast<int>(meshData->type[i]);
+        throw std::runtime_error(s.str());
+        }
+      }
+    const int32_t* cell = con + meshData->off[i];
+    for (vtkm::IdComponent j=0;j<8;j++)
+      portal.Set(8*i + j, cell[map[j]]);
+    }
+}
 }
 
 //------------------------------------------------------------------------------
 void PyFRData::Init(void* data)
 {
   this->catalystData = static_cast<struct CatalystData*>(data);
+  this->MeshModified = true;
+  this->Update();
+}
 
-  // we only take data from the first stored cell type (i.e. hexahedra)
-  MeshDataForCellType* meshData = &(this->catalystData->meshData[0]);
-  SolutionDataForCellType* solutionData =
-    &(this->catalystData->solutionData[0]);
+//------------------------------------------------------------------------------
+void PyFRData::Update()
+{
+  if (!this->catalystData)
+    return;
+
+  if (this->MeshModified)
+    this->UpdateMesh();
+
+  for (unsigned i=0;i<this->dataSets.size();i++)
+    {
+    vtkm::cont::DataSet& dataSet = this->dataSets[i];
+    dataSet.Clear();
+    dataSet.AddCoordinateSystem(
+      vtkm::cont::CoordinateSystem("coordinates",1,this->Coordinates[i]));
+    dataSet.AddCellSet(this->CellSets[i]);
+    for (unsigned j=0;j<this->CoarseCellSets[i].size();j++)
+      dataSet.AddCellSet(this->CoarseCellSets[i][j]);
+    this->UpdateSolution(i);
+    }
+  this->SolutionRevision++;
+}
+
+//------------------------------------------------------------------------------
+void PyFRData::UpdateMesh()
+{
+  this->CellTypeIndex.clear();
+  this->NodesPerEdge.clear();
+  this->ElementOrders.clear();
+  this->Coordinates.clear();
+  this->CellSets.clear();
+  this->CoarseCellSets.clear();
+
+  for (int i=0;i<this->catalystData->nCellTypes;i++)
+    {
+    MeshDataForCellType* meshData = &(this->catalystData->meshData[i]);
+    if (meshData->nSubdividedCells == 0)
+      continue;
+
+    Vec3ArrayHandle vertices;
+    CellSet cellSet(vtkm::CellShapeTagHexahedron(), "cells");
+    vtkm::cont::ArrayHandle<vtkm::Id> elementOrder;
+    this->BuildMesh(meshData,vertices,cellSet,elementOrder);
+
+    this->CellTypeIndex.push_back(i);
+    this->NodesPerEdge.push_back(HexahedronNodesPerEdge(meshData));
+    this->ElementOrders.push_back(elementOrder);
+    this->Coordinates.push_back(vertices);
+    this->CellSets.push_back(cellSet);
+    this->CoarseCellSets.push_back(std::vector<CellSet>());
+    this->BuildCoarseCellSets(meshData,elementOrder,this->NodesPerEdge.back(),
+                              this->CoarseCellSets.back());
+    }
+
+  this->SetNumberOfCellTypes(this->CellTypeIndex.size());
+  this->MaterializedFields.clear();
+  this->MaterializedFields.resize(this->CellTypeIndex.size());
+  // Every cell type carries the same variables, starting with the five
+  // conservative ones that the standard fields are built from
+  int nVariables = 5;
+  for (unsigned i=0;i<this->CellTypeIndex.size();i++)
+    {
+    const int nvars =
+      this->catalystData->solutionData[this->CellTypeIndex[i]].nvars;
+    if (nvars < 5 || (i > 0 && nvars != nVariables))
+      {
+      std::stringstream s;
+      s << "PyFRData: invalid number of solution variables " << nvars
+        << " (expected at least 5, equal for every cell type)";
+      throw std::runtime_error(s.str());
+      }
+    nVariables = nvars;
+    }
+  this->BuildFieldRegistry(nVariables);
+  this->MeshModified = false;
+  this->MeshRevision++;
+}
+
+//------------------------------------------------------------------------------
+void PyFRData::BuildMesh(MeshDataForCellType* meshData,
+                         Vec3ArrayHandle& vertices,
+                         CellSet& cellSet,
+                         vtkm::cont::ArrayHandle<vtkm::Id>& elementOrder)
+{
+  typedef ::PyFRDeviceAdapter DeviceTag;
+  typedef vtkm::Vec<SolverFPType,3> SolverVec3;
+  typedef vtkm::cont::internal::Storage<SolverVec3,
+                                        vtkm::cont::StorageTagBasic> Vec3Storage;
+
+  const vtkm::Id nVertices = meshData->nCells*meshData->nVerticesPerCell;
+#ifdef PYFR_DEVICE_ADAPTER_CUDA
+  if (IsDevicePointer(meshData->vertices))
+    {
+    // The coordinate array type uses basic storage, which cannot adopt a
+    // device allocation, so vertices that already live on the device are
+    // copied once, device to device.
+    LoadVertices(vtkm::cont::cuda::make_ArrayHandle(
+                   static_cast<SolverVec3*>(meshData->vertices),nVertices),
+                 vertices,false);
+    }
+  else
+#endif
+    {
+    // Wrap the solver's vertex array in place if ZeroCopyMesh is on. On the
+    // CPU device adapters it is used directly; on CUDA it is transferred to
+    // the device on first use.
+    LoadVertices(vtkm::cont::ArrayHandle<SolverVec3>(Vec3Storage(
+                   static_cast<const SolverVec3*>(meshData->vertices),
+                   nVertices)),
+                 vertices,this->ZeroCopyMesh);
+    }
 
-  typedef ::vtkm::cont::DeviceAdapterTagCuda CudaTag;
+  // The connectivity may live on the device as well. Its offsets and cell
+  // types are always read on the host.
+  const vtkm::Id nConnectivity = meshData->nSubdividedCells*
+    vtkm::CellTraits<vtkm::CellShapeTagHexahedron>::NUM_POINTS;
+  Int32ArrayHandle connectivity;
+#ifdef PYFR_DEVICE_ADAPTER_CUDA
+  const bool deviceConnectivity = IsDevicePointer(meshData->con);
+#endif
+  if (AllHexahedra(meshData))
+    {
+#ifdef PYFR_DEVICE_ADAPTER_CUDA
+    if (deviceConnectivity)
+      {
+      // Like the vertices, it is copied once, device to device
+      vtkm::cont::DeviceAdapterAlgorithm<DeviceTag>().Copy(
+        vtkm::cont::cuda::make_ArrayHandle(
+          static_cast<vtkm::Int32*>(meshData->con),nConnectivity),
+        connectivity);
+      }
+    else
+#endif
+      {
+      Int32ArrayHandle tmp =
+        vtkm::cont::make_ArrayHandle(
+          static_cast<const vtkm::Int32*>(meshData->con),nConnectivity);
+      if (this->ZeroCopyMesh)
+        connectivity = tmp;
+      else
+        vtkm::cont::DeviceAdapterAlgorithm<DeviceTag>().Copy(tmp,
+                                                             connectivity);
+      }
+    }
+  else
+    {
+    const int32_t* con = meshData->con;
+#ifdef PYFR_DEVICE_ADAPTER_CUDA
+    std::vector<int32_t> hostCon;
+    if (deviceConnectivity)
+      {
+      hostCon.resize(std::max(ConnectivityLength(meshData),std::size_t(1)));
+      cudaMemcpy(&hostCon[0],meshData->con,hostCon.size()*sizeof(int32_t),
+                 cudaMemcpyDeviceToHost);
+      con = &hostCon[0];
+      }
+#endif
+    PromoteToHexahedra(meshData, con, connectivity);
+    }
 
-  Vec3ArrayHandle vertices;
+  // Whole elements are reordered, so each must own as many subdivided cells.
+  // The reordered vertices and connectivity are new arrays, so the solver's
+  // are untouched.
+  elementOrder = vtkm::cont::ArrayHandle<vtkm::Id>();
+  if (this->ReorderCells && meshData->nCells > 0 &&
+      meshData->nSubdividedCells % meshData->nCells == 0)
     {
-    const vtkm::Vec<FPType,3> *vecData =
-      reinterpret_cast<const vtkm::Vec<FPType,3>*>(meshData->vertices);
-    typedef vtkm::cont::internal::Storage<vtkm::Vec<FPType,3>,
-                                       vtkm::cont::StorageTagBasic> Vec3Storage;
-    Vec3ArrayHandle tmp =
-      Vec3ArrayHandle(Vec3Storage(vecData,
-                                  meshData->nCells*meshData->nVerticesPerCell));
-    vtkm::cont::DeviceAdapterAlgorithm<CudaTag>().
-      Copy(tmp, vertices);
+    vtkm::worklet::MortonReorder<DeviceTag> reorder;
+    reorder.Run(vertices,meshData->nVerticesPerCell,elementOrder);
+    reorder.ReorderCells(elementOrder,meshData->nVerticesPerCell,
+                         meshData->nSubdividedCells/meshData->nCells,
+                         connectivity);
+    reorder.ReorderPoints(elementOrder,meshData->nVerticesPerCell,vertices);
     }
 
-  vtkm::cont::ArrayHandle<vtkm::Id> connectivity;
+  cellSet.Fill(ConnectivityArrayHandle(connectivity));
+}
+
+//------------------------------------------------------------------------------
+void PyFRData::BuildCoarseCellSets(
+  MeshDataForCellType* meshData,
+  const vtkm::cont::ArrayHandle<vtkm::Id>& elementOrder,
+  int nodesPerEdge,
+  std::vector<CellSet>& cellSets)
+{
+  // Level l splits each edge of a hexahedron into (n-1)/2^l cells, down to
+  // one cell per element spanning its corners. Other cell types only have
+  // their full resolution cell set.
+  for (int m=(nodesPerEdge - 1)/2;m>=1;m/=2)
     {
-    vtkm::cont::ArrayHandle<int32_t> tmp =
-      vtkm::cont::make_ArrayHandle(meshData->con,
-                                   (meshData->nSubdividedCells*
-                   vtkm::CellTraits<vtkm::CellShapeTagHexahedron>::NUM_POINTS));
-    vtkm::cont::ArrayHandleCastForInput<vtkm::Id,
-      vtkm::cont::ArrayHandle<int32_t> > cast(tmp);
-    vtkm::cont::DeviceAdapterAlgorithm<CudaTag>().
-      Copy(cast, connectivity);
+    Int32ArrayHandle connectivity;
+    SubdivideHexahedra(meshData->nCells,nodesPerEdge,m,connectivity);
+
+    // Follow the elements of the full resolution cell set
+    if (elementOrder.GetNumberOfValues() > 0)
+      vtkm::worklet::MortonReorder< ::PyFRDeviceAdapter>().
+        ReorderCells(elementOrder,nodesPerEdge*nodesPerEdge*nodesPerEdge,
+                     m*m*m,connectivity);
+
+    std::stringstream name;
+    name << "cells_level" << cellSets.size() + 1;
+    CellSet cellSet(vtkm::CellShapeTagHexahedron(), name.str());
+    cellSet.Fill(ConnectivityArrayHandle(connectivity));
+    cellSets.push_back(cellSet);
     }
+}
 
-  vtkm::cont::CellSetSingleType<> cset(vtkm::CellShapeTagHexahedron(), "cells");
-  cset.Fill(connectivity);
+//------------------------------------------------------------------------------
+unsigned PyFRData::GetNumberOfResolutionLevels() const
+{
+  std::size_t nLevels = 0;
+  for (unsigned i=0;i<this->CoarseCellSets.size();i++)
+    nLevels = std::max(nLevels,this->CoarseCellSets[i].size());
+  return nLevels + 1;
+}
+
+//------------------------------------------------------------------------------
+vtkm::cont::DynamicCellSet PyFRData::GetCellSet(unsigned i,
+                                                unsigned level) const
+{
+  const vtkm::cont::DataSet& dataSet = this->dataSets[i];
+  const vtkm::IdComponent nCellSets = dataSet.GetNumberOfCellSets();
+  return dataSet.GetCellSet(level < nCellSets ? level : nCellSets - 1);
+}
 
-  StridedDataFunctor stridedDataFunctor[5];
-  for (unsigned i=0;i<5;i++)
+//------------------------------------------------------------------------------
+int PyFRData::GetFieldIndex(const std::string& name) const
+{
+  for (unsigned i=0;i<this->FieldNames.size();i++)
+    if (this->FieldNames[i] == name)
+      return i;
+  return -1;
+}
+
+//------------------------------------------------------------------------------
+bool PyFRData::IsFieldRequested(unsigned i) const
+{
+  if (this->AllFieldsRequested)
+    return true;
+  return std::find(this->RequestedFields.begin(),this->RequestedFields.end(),
+                   this->FieldNames[i]) != this->RequestedFields.end();
+}
+
+//------------------------------------------------------------------------------
+void PyFRData::BuildFieldRegistry(int nVariables)
+{
+  this->NumberOfVariables = nVariables;
+  this->FieldNames.clear();
+
+  static const char* standardFieldNames[NUMBER_OF_STANDARD_FIELDS] =
+    { "density", "pressure", "velocity_u", "velocity_v", "velocity_w",
+      "momentum_u", "momentum_v", "momentum_w", "energy",
+      "velocity_magnitude", "temperature", "mach", "total_pressure",
+      "vorticity_magnitude", "q_criterion", "lambda2" };
+  this->FieldNames.assign(standardFieldNames,
+                          standardFieldNames + NUMBER_OF_STANDARD_FIELDS);
+
+  for (int i=5;i<nVariables;i++)
     {
-    stridedDataFunctor[i].NumberOfCells = meshData->nCells;
-    stridedDataFunctor[i].NVerticesPerCell = meshData->nVerticesPerCell;
-    stridedDataFunctor[i].NSolutionTypes = 5;
-    stridedDataFunctor[i].SolutionType = i;
-    stridedDataFunctor[i].CellStride = solutionData->lsdim;
-    stridedDataFunctor[i].VertexStride = solutionData->ldim;
+    std::stringstream s;
+    s << "variable_" << i;
+    this->FieldNames.push_back(s.str());
     }
+}
+
+//------------------------------------------------------------------------------
+template<typename ArrayHandleType>
+vtkm::cont::DynamicArrayHandle PyFRData::BindField(unsigned index, int field,
+                                                   const ArrayHandleType& array)
+{
+  if (!this->MaterializeFields)
+    return vtkm::cont::DynamicArrayHandle(array);
+
+  MaterializedDataArrayHandle& materialized =
+    this->MaterializedFields[index][field];
+  vtkm::cont::DeviceAdapterAlgorithm< ::PyFRDeviceAdapter>().
+    Copy(array, materialized);
+  return vtkm::cont::DynamicArrayHandle(materialized);
+}
 
+//------------------------------------------------------------------------------
+void PyFRData::UpdateSolution(unsigned index)
+{
+  MeshDataForCellType* meshData =
+    &(this->catalystData->meshData[this->CellTypeIndex[index]]);
+  SolutionDataForCellType* solutionData =
+    &(this->catalystData->solutionData[this->CellTypeIndex[index]]);
+
+  const vtkm::Id nPoints = meshData->nCells*meshData->nVerticesPerCell;
+  const int nVariables = this->NumberOfVariables;
+
+#ifdef PYFR_DEVICE_ADAPTER_CUDA
   RawDataArrayHandle rawSolutionArray = vtkm::cont::cuda::make_ArrayHandle(
-    static_cast<FPType*>(solutionData->solution),
+    static_cast<SolverFPType*>(solutionData->solution),
     solutionData->ldim*meshData->nVerticesPerCell);
+#else
+  RawDataArrayHandle rawSolutionArray = vtkm::cont::make_ArrayHandle(
+    static_cast<const SolverFPType*>(solutionData->solution),
+    solutionData->ldim*meshData->nVerticesPerCell);
+#endif
+  SolutionArrayHandle solutionArray(rawSolutionArray);
+
+  // NB: Cannot call resize to increase the lengths of vectors of array
+  // handles!
+  std::vector<MaterializedDataArrayHandle>& materialized =
+    this->MaterializedFields[index];
+  for (unsigned i=materialized.size();i<this->GetNumberOfFields();i++)
+    materialized.push_back(MaterializedDataArrayHandle());
+
+  std::vector<vtkm::cont::DynamicArrayHandle> arrays(this->GetNumberOfFields());
 
-  DataIndexArrayHandle densityIndexArray(stridedDataFunctor[0],
-                                   meshData->nCells*meshData->nVerticesPerCell);
-  ScalarDataArrayHandle densityArray(densityIndexArray, rawSolutionArray);
+  // PyFR stores the conservative variables (rho, rhou, rhov, rhow, E) first,
+  // followed by any additional variables of the solver.
+  enum { RHO=0, RHOU=1, RHOV=2, RHOW=3, E=4 };
+  const int conservativeFields[5] = { DENSITY, MOMENTUM_U, MOMENTUM_V,
+                                      MOMENTUM_W, ENERGY };
 
-  DataIndexArrayHandle velocity_uIndexArray(stridedDataFunctor[1],
-                                   meshData->nCells*meshData->nVerticesPerCell);
-  ScalarDataArrayHandle velocity_uArray(velocity_uIndexArray, rawSolutionArray);
+  // Reordered elements read the solution of the solver's element
+  const bool reordered =
+    (this->ElementOrders[index].GetNumberOfValues() > 0);
+  StridedDataFunctor::ElementOrderPortal elementOrder;
+  if (reordered)
+    elementOrder =
+      this->ElementOrders[index].PrepareForInput(::PyFRDeviceAdapter());
+
+  std::vector<ScalarDataArrayHandle> variables;
+  for (int i=0;i<nVariables;i++)
+    {
+    const int field = (i < 5 ? conservativeFields[i] :
+                       NUMBER_OF_STANDARD_FIELDS + i - 5);
 
-  DataIndexArrayHandle velocity_vIndexArray(stridedDataFunctor[2],
-                                   meshData->nCells*meshData->nVerticesPerCell);
-  ScalarDataArrayHandle velocity_vArray(velocity_vIndexArray, rawSolutionArray);
+    StridedDataFunctor stridedDataFunctor;
+    stridedDataFunctor.NumberOfCells = meshData->nCells;
+    stridedDataFunctor.NVerticesPerCell = meshData->nVerticesPerCell;
+    stridedDataFunctor.NSolutionTypes = nVariables;
+    stridedDataFunctor.SolutionType = i;
+    stridedDataFunctor.CellStride = solutionData->lsdim;
+    stridedDataFunctor.VertexStride = solutionData->ldim;
+    stridedDataFunctor.Reordered = reordered;
+    stridedDataFunctor.ElementOrder = elementOrder;
 
-  DataIndexArrayHandle velocity_wIndexArray(stridedDataFunctor[3],
-                                   meshData->nCells*meshData->nVerticesPerCell);
-  ScalarDataArrayHandle velocity_wArray(velocity_wIndexArray, rawSolutionArray);
+    DataIndexArrayHandle indexArray(stridedDataFunctor,nPoints);
+    variables.push_back(ScalarDataArrayHandle(indexArray,solutionArray));
 
-  DataIndexArrayHandle pressureIndexArray(stridedDataFunctor[4],
-                                   meshData->nCells*meshData->nVerticesPerCell);
-  ScalarDataArrayHandle pressureArray(pressureIndexArray, rawSolutionArray);
+    // The strided views are free, and feed the derived fields
+    if (!this->IsFieldRequested(field))
+      continue;
+
+#ifndef PYFR_DEVICE_ADAPTER_CUDA
+    if (this->MaterializeFields && !reordered)
+      {
+      // On the host, walk the solution in its stored order so that the
+      // reads are unit-stride and vectorize; only the writes are strided.
+      // Mixed precision values are converted as they are copied.
+      MaterializedDataArrayHandle& out = materialized[field];
+      out.Allocate(nPoints);
+      FPType* outData =
+        vtkm::cont::ArrayPortalToIteratorBegin(out.GetPortalControl());
+      const SolverFPType* in =
+        static_cast<const SolverFPType*>(solutionData->solution) +
+        i*solutionData->lsdim;
+      const vtkm::Id nCells = meshData->nCells;
+      const vtkm::Id nVerticesPerCell = meshData->nVerticesPerCell;
+      for (vtkm::Id vertex=0;vertex<nVerticesPerCell;vertex++)
+        {
+        const SolverFPType* inVertex = in + vertex*solutionData->ldim;
+        FPType* outVertex = outData + vertex;
+        for (vtkm::Id cell=0;cell<nCells;cell++)
+          outVertex[cell*nVerticesPerCell] =
+            static_cast<FPType>(inVertex[cell]);
+        }
+      arrays[field] = vtkm::cont::DynamicArrayHandle(out);
+      continue;
+      }
+#endif
+    arrays[field] = this->BindField(index,field,variables[i]);
+    }
+
+  // The primitive variables are computed lazily from the conservative ones
+  // as they are read, so only the points that a filter visits are
+  // evaluated.
+  MomentumSquaredArrayHandle momentumSquared(
+    vtkm::cont::make_ArrayHandleCompositeVector(variables[RHOU],0,
+                                                variables[RHOV],0,
+                                                variables[RHOW],0),
+    MomentumSquaredFunctor());
+
+  const int velocityFields[3] = { VELOCITY_U, VELOCITY_V, VELOCITY_W };
+  for (unsigned i=0;i<3;i++)
+    {
+    if (!this->IsFieldRequested(velocityFields[i]))
+      continue;
+    VelocityArrayHandle array(
+      vtkm::cont::make_ArrayHandleCompositeVector(variables[RHO],0,
+                                                  variables[RHOU + i],0),
+      VelocityFunctor());
+    arrays[velocityFields[i]] =
+      this->BindField(index,velocityFields[i],array);
+    }
+
+  if (this->IsFieldRequested(VELOCITY_MAGNITUDE))
+    {
+    SpeedArrayHandle array(
+      vtkm::cont::make_ArrayHandleCompositeVector(variables[RHO],0,
+                                                  momentumSquared,0),
+      SpeedFunctor());
+    arrays[VELOCITY_MAGNITUDE] =
+      this->BindField(index,VELOCITY_MAGNITUDE,array);
+    }
 
-  enum ElemType { CONSTANT=0, LINEAR=1, QUADRATIC=2 };
-  vtkm::cont::Field density("density",LINEAR,vtkm::cont::Field::ASSOC_POINTS,vtkm::cont::DynamicArrayHandle(densityArray));
-  vtkm::cont::Field velocity_u("velocity_u",LINEAR,vtkm::cont::Field::ASSOC_POINTS,vtkm::cont::DynamicArrayHandle(velocity_uArray));
-  vtkm::cont::Field velocity_v("velocity_v",LINEAR,vtkm::cont::Field::ASSOC_POINTS,vtkm::cont::DynamicArrayHandle(velocity_vArray));
-  vtkm::cont::Field velocity_w("velocity_w",LINEAR,vtkm::cont::Field::ASSOC_POINTS,vtkm::cont::DynamicArrayHandle(velocity_wArray));
-  vtkm::cont::Field pressure("pressure",LINEAR,vtkm::cont::Field::ASSOC_POINTS,vtkm::cont::DynamicArrayHandle(pressureArray));
+  ThermodynamicFunctor thermodynamic;
+  thermodynamic.Gamma = this->Gamma;
+  thermodynamic.GasConstant = this->GasConstant;
 
-  this->dataSet.AddCoordinateSystem(vtkm::cont::CoordinateSystem("coordinates",
-                                                                 1,vertices));
-  this->dataSet.AddField(density);
-  this->dataSet.AddField(velocity_u);
-  this->dataSet.AddField(velocity_v);
-  this->dataSet.AddField(velocity_w);
-  this->dataSet.AddField(pressure);
-  this->dataSet.AddCellSet(cset);
+  // (field, quantity)
+  const int thermodynamicFields[4][2] =
+    { { PRESSURE,       ThermodynamicFunctor::PRESSURE },
+      { TEMPERATURE,    ThermodynamicFunctor::TEMPERATURE },
+      { MACH,           ThermodynamicFunctor::MACH },
+      { TOTAL_PRESSURE, ThermodynamicFunctor::TOTAL_PRESSURE } };
+
+  for (unsigned i=0;i<4;i++)
+    {
+    const int field = thermodynamicFields[i][0];
+    if (!this->IsFieldRequested(field))
+      continue;
+    thermodynamic.Quantity = thermodynamicFields[i][1];
+    ThermodynamicArrayHandle array(
+      vtkm::cont::make_ArrayHandleCompositeVector(variables[RHO],0,
+                                                  variables[E],0,
+                                                  momentumSquared,0),
+      thermodynamic);
+    arrays[field] = this->BindField(index,field,array);
+    }
+
+  this->UpdateGradients(index,solutionArray,arrays);
+
+  // Fields that were not requested are bound to empty arrays, releasing any
+  // storage they held on previous updates
+  for (unsigned i=0;i<arrays.size();i++)
+    if (!this->IsFieldRequested(i))
+      {
+      materialized[i] = MaterializedDataArrayHandle();
+      arrays[i] = vtkm::cont::DynamicArrayHandle(materialized[i]);
+      }
+
+  // Add the fields in index order, so that they can be looked up by index
+  for (unsigned i=0;i<arrays.size();i++)
+    this->dataSets[index].AddField(
+      vtkm::cont::Field(this->FieldNames[i],LINEAR,
+                        vtkm::cont::Field::ASSOC_POINTS,arrays[i]));
 }
 
 //------------------------------------------------------------------------------
-void PyFRData::Update()
+void PyFRData::UpdateGradients(
+  unsigned index,
+  const SolutionArrayHandle& solutionArray,
+  std::vector<vtkm::cont::DynamicArrayHandle>& arrays)
 {
+  typedef ::PyFRDeviceAdapter DeviceTag;
+  typedef vtkm::worklet::GradientFields<FPType,DeviceTag> GradientFields;
+
+  MeshDataForCellType* meshData =
+    &(this->catalystData->meshData[this->CellTypeIndex[index]]);
+  SolutionDataForCellType* solutionData =
+    &(this->catalystData->solutionData[this->CellTypeIndex[index]]);
+  std::vector<MaterializedDataArrayHandle>& materialized =
+    this->MaterializedFields[index];
+
+  const int gradientFields[3] = { VORTICITY_MAGNITUDE, Q_CRITERION, LAMBDA2 };
+  const vtkm::Id nPoints = meshData->nCells*meshData->nVerticesPerCell;
+
+  // The three fields share one pass over the elements, which is skipped
+  // entirely if none of them is requested
+  if (!this->IsFieldRequested(gradientFields[0]) &&
+      !this->IsFieldRequested(gradientFields[1]) &&
+      !this->IsFieldRequested(gradientFields[2]))
+    return;
+
+  if (this->NodesPerEdge[index] > 0)
+    {
+    GradientFields::SolutionLayout layout;
+    layout.CellStride = solutionData->lsdim;
+    layout.VertexStride = solutionData->ldim;
+
+    if (this->ElementOrders[index].GetNumberOfValues() > 0)
+      GradientFields().Run(meshData->nCells,
+                           this->NodesPerEdge[index],
+                           this->Coordinates[index],
+                           solutionArray,
+                           layout,
+                           this->ElementOrders[index],
+                           materialized[gradientFields[0]],
+                           materialized[gradientFields[1]],
+                           materialized[gradientFields[2]]);
+    else
+      GradientFields().Run(meshData->nCells,
+                           this->NodesPerEdge[index],
+                           this->Coordinates[index],
+                           solutionArray,
+                           layout,
+                           materialized[gradientFields[0]],
+                           materialized[gradientFields[1]],
+                           materialized[gradientFields[2]]);
+    }
+  else
+    {
+    // Gradients are only computed on hexahedra; other cell types report
+    // zero so that every data set carries the same fields.
+    for (unsigned i=0;i<3;i++)
+      vtkm::cont::DeviceAdapterAlgorithm<DeviceTag>().
+        Copy(vtkm::cont::make_ArrayHandleImplicit<FPType>(ZeroFunctor(),
+                                                          nPoints),
+             materialized[gradientFields[i]]);
+    }
+
+  for (unsigned i=0;i<3;i++)
+    arrays[gradientFields[i]] =
+      vtkm::cont::DynamicArrayHandle(materialized[gradientFields[i]]);
 }
@@ -1,43 +1,143 @@
 #ifndef PYFRDATA_H
 #define PYFRDATA_H
 
-//State that the default backend for this code is CUDA
-//not serial
-// #define VTKM_DEVICE_ADAPTER VTKM_DEVICE_ADAPTER_CUDA
 //Disable treading support in our array handle
 //needed for nvcc to stop complaining.
 #define BOOST_SP_DISABLE_THREADS
 
+#include <vtkm/Math.h>
+#include <vtkm/VectorAnalysis.h>
 #include <vtkm/cont/ArrayHandle.h>
 #include <vtkm/cont/ArrayHandleCast.h>
 #include <vtkm/cont/ArrayHandleCompositeVector.h>
 #include <vtkm/cont/ArrayHandleImplicit.h>
 #include <vtkm/cont/ArrayHandlePermutation.h>
-#include <vtkm/cont/cuda/ArrayHandleCuda.h>
-#include <vtkm/cont/cuda/DeviceAdapterCuda.h>
+#include <vtkm/cont/ArrayHandleTransform.h>
+#include <vtkm/cont/CellSetSingleType.h>
 #include <vtkm/cont/DataSet.h>
+#ifdef PYFR_DEVICE_ADAPTER_CUDA
+#include <vtkm/cont/cuda/ArrayHandleCuda.h>
+#endif
+
+#include "PyFRDeviceAdapter.h"
+
+#include <boost/type_traits/is_same.hpp>
+
+#include <stdexcept>
+#include <string>
+#include <vector>
 
 #include "CatalystData.h"
 
 struct StridedDataFunctor
 {
+  typedef vtkm::cont::ArrayHandle<vtkm::Id>::ExecutionTypes<
+    ::PyFRDeviceAdapter>::PortalConst ElementOrderPortal;
+
   vtkm::Id NumberOfCells;
   vtkm::Id NVerticesPerCell;
   vtkm::Id NSolutionTypes;
   vtkm::Id SolutionType;
   vtkm::Id CellStride;
   vtkm::Id VertexStride;
+  // The solver's element of each element, if they were reordered (see
+  // PyFRData::SetReorderCells). The portal is only valid in the execution
+  // environment.
+  bool Reordered;
+  ElementOrderPortal ElementOrder;
+
+  VTKM_EXEC_CONT_EXPORT
+  StridedDataFunctor() : Reordered(false) {}
 
   VTKM_EXEC_CONT_EXPORT
   vtkm::Id operator()(vtkm::Id index) const
   {
     vtkm::Id cell = index/NVerticesPerCell;
     vtkm::Id vertex = index%NVerticesPerCell;
+    if (Reordered)
+      cell = ElementOrder.Get(cell);
 
     return cell + CellStride*SolutionType + VertexStride*vertex;
   }
 };
 
+struct MomentumSquaredFunctor
+{
+  VTKM_EXEC_CONT_EXPORT
+  FPType operator()(const vtkm::Vec<FPType,3>& momentum) const
+  {
+    return vtkm::dot(momentum,momentum);
+  }
+};
+
+// Velocity component from (rho, the component of rho*u)
+struct VelocityFunctor
+{
+  VTKM_EXEC_CONT_EXPORT
+  FPType operator()(const vtkm::Vec<FPType,2>& state) const
+  {
+    return state[1]/state[0];
+  }
+};
+
+// Velocity magnitude from (rho, |rho*u|^2)
+struct SpeedFunctor
+{
+  VTKM_EXEC_CONT_EXPORT
+  FPType operator()(const vtkm::Vec<FPType,2>& state) const
+  {
+    return vtkm::Sqrt(state[1])/state[0];
+  }
+};
+
+// Thermodynamic quantities from (rho, E, |rho*u|^2)
+struct ThermodynamicFunctor
+{
+  enum QuantityType { PRESSURE, TEMPERATURE, MACH, TOTAL_PRESSURE };
+
+  vtkm::Int32 Quantity;
+  FPType Gamma;
+  FPType GasConstant;
+
+  VTKM_EXEC_CONT_EXPORT
+  FPType operator()(const vtkm::Vec<FPType,3>& state) const
+  {
+    const FPType rho = state[0];
+    const FPType E = state[1];
+    const FPType momentumSquared = state[2];
+
+    const FPType p = (this->Gamma - 1)*(E - FPType(0.5)*momentumSquared/rho);
+    if (this->Quantity == PRESSURE)
+      return p;
+    if (this->Quantity == TEMPERATURE)
+      return p/(rho*this->GasConstant);
+
+    const FPType machSquared = momentumSquared/(rho*this->Gamma*p);
+    if (this->Quantity == MACH)
+      return vtkm::Sqrt(machSquared);
+
+    return p*vtkm::Pow(1 + FPType(0.5)*(this->Gamma - 1)*machSquared,
+                       this->Gamma/(this->Gamma - 1));
+  }
+};
+
+// Presents an array of the solver's precision in the pipeline's precision,
+// converting each value as it is read. Arrays that are already in the
+// pipeline's precision are used as is.
+template<typename ValueType, typename ArrayHandleType,
+         bool SamePrecision = boost::is_same<ValueType,
+                              typename ArrayHandleType::ValueType>::value>
+struct PipelinePrecision
+{
+  typedef vtkm::cont::ArrayHandleCastForInput<ValueType,ArrayHandleType> type;
+};
+
+template<typename ValueType, typename ArrayHandleType>
+struct PipelinePrecision<ValueType,ArrayHandleType,true>
+{
+  typedef ArrayHandleType type;
+};
+
 /*
  * This class was adapted from the Isosurface class from Tom Fogal's
  * visualization plugin.
@@ -53,31 +153,263 @@ public:
   typedef vtkm::cont::ArrayHandleImplicit<vtkm::Id, StridedDataFunctor>
   DataIndexArrayHandle;
 
-  typedef vtkm::cont::cuda::ArrayHandleCuda<FPType>::type RawDataArrayHandle;
+  // The solution array is a device pointer when running on CUDA, and a host
+  // pointer when running on one of the CPU device adapters.
+#ifdef PYFR_DEVICE_ADAPTER_CUDA
+  typedef vtkm::cont::cuda::ArrayHandleCuda<SolverFPType>::type
+  RawDataArrayHandle;
+#else
+  typedef vtkm::cont::ArrayHandle<SolverFPType> RawDataArrayHandle;
+#endif
+
+  // The solution as seen by the pipeline. In mixed precision builds each
+  // value is converted to FPType by the first worklet that reads it.
+  typedef PipelinePrecision<FPType,RawDataArrayHandle>::type
+  SolutionArrayHandle;
 
   typedef vtkm::cont::ArrayHandlePermutation<DataIndexArrayHandle,
-    RawDataArrayHandle> ScalarDataArrayHandle;
+    SolutionArrayHandle> ScalarDataArrayHandle;
+
+  // PyFR stores the conservative variables. The primitive variables are
+  // exposed as transforms of them that are evaluated as they are read, so
+  // they cost neither memory nor a pass over the solution. Each one only
+  // gathers the variables its formula uses: (rho, rho*u_i) for a velocity
+  // component, (rho, |rho*u|^2) for the speed and (rho, E, |rho*u|^2) for the
+  // thermodynamic quantities.
+  typedef vtkm::cont::ArrayHandleCompositeVectorType<ScalarDataArrayHandle,
+                                                     ScalarDataArrayHandle,
+                                                     ScalarDataArrayHandle>
+  ::type MomentumArrayHandle;
+  typedef vtkm::cont::ArrayHandleTransform<FPType,MomentumArrayHandle,
+                                           MomentumSquaredFunctor>
+  MomentumSquaredArrayHandle;
+  typedef vtkm::cont::ArrayHandleTransform<FPType,
+    vtkm::cont::ArrayHandleCompositeVectorType<ScalarDataArrayHandle,
+                                               ScalarDataArrayHandle>::type,
+    VelocityFunctor> VelocityArrayHandle;
+  typedef vtkm::cont::ArrayHandleTransform<FPType,
+    vtkm::cont::ArrayHandleCompositeVectorType<ScalarDataArrayHandle,
+                                               MomentumSquaredArrayHandle>::type,
+    SpeedFunctor> SpeedArrayHandle;
+  typedef vtkm::cont::ArrayHandleTransform<FPType,
+    vtkm::cont::ArrayHandleCompositeVectorType<ScalarDataArrayHandle,
+                                               ScalarDataArrayHandle,
+                                               MomentumSquaredArrayHandle>::type,
+    ThermodynamicFunctor> ThermodynamicArrayHandle;
+
+  typedef vtkm::cont::ArrayHandle<FPType> MaterializedDataArrayHandle;
 
-  typedef vtkm::cont::CellSetSingleType<> CellSet;
+  // Fields are either views into the solver's solution array or, if
+  // MaterializeFields is on, contiguous copies of it. Use these lists to
+  // cast a field's DynamicArrayHandle to its concrete type.
+  typedef vtkm::ListTagBase<FPType> FieldTypeList;
+  typedef vtkm::ListTagBase<ScalarDataArrayHandle::StorageTag,
+                            VelocityArrayHandle::StorageTag,
+                            SpeedArrayHandle::StorageTag,
+                            ThermodynamicArrayHandle::StorageTag,
+                            MaterializedDataArrayHandle::StorageTag>
+  FieldStorageList;
+
+  // The connectivity is kept in the solver's 32-bit form and widened to
+  // vtkm::Id as it is read, halving its footprint and the bandwidth of every
+  // topology traversal.
+  typedef vtkm::cont::ArrayHandle<vtkm::Int32> Int32ArrayHandle;
+  typedef vtkm::cont::ArrayHandleCastForInput<vtkm::Id,Int32ArrayHandle>
+  ConnectivityArrayHandle;
+
+  typedef vtkm::cont::CellSetSingleType<ConnectivityArrayHandle::StorageTag>
+  CellSet;
 
   void Init(void* field);
 
-  vtkm::cont::DataSet& GetDataSet() { return dataSet; }
-  const vtkm::cont::DataSet& GetDataSet() const { return dataSet; }
+  // Each cell type stored in the CatalystData (hexahedra, prisms, pyramids,
+  // tetrahedra) has its own vertex and solution arrays, so it is held in its
+  // own data set. Cell types with no cells on this rank are omitted.
+  void SetNumberOfCellTypes(unsigned);
+  unsigned GetNumberOfCellTypes() const { return dataSets.size(); }
+  vtkm::cont::DataSet& GetDataSet(int i) { return dataSets[i]; }
+  const vtkm::cont::DataSet& GetDataSet(int i) const { return dataSets[i]; }
 
+  // Rebind the fields to the solver's current solution arrays. The mesh is
+  // only rebuilt if SetMeshModified() has been called since the last update.
   void Update();
 
-  static int FieldIndex(std::string name) { return PyFRData::fieldIndex[name]; }
-  static std::string FieldName(int i) { return PyFRData::fieldName[i]; }
+  // Besides its full resolution cell set, each data set of hexahedra holds
+  // coarser cell sets built from a subset of the element nodes, down to one
+  // cell per element. They share the data set's points and fields, so a
+  // filter selects a resolution level simply by picking a cell set; levels
+  // beyond those of a data set fall back to its coarsest cell set.
+  unsigned GetNumberOfResolutionLevels() const;
+  vtkm::cont::DynamicCellSet GetCellSet(unsigned i, unsigned level) const;
+
+  void SetMeshModified() { this->MeshModified = true; }
+  unsigned long GetMeshRevision() const { return this->MeshRevision; }
+  // Filters that build the cell sets of their output directly mark it as a
+  // new mesh revision, so that caches keyed on the mesh are invalidated
+  void IncrementMeshRevision() { this->MeshRevision++; }
+  // Incremented by each update, since the solution arrays are rebound and
+  // the solver may have advanced them; likewise for the filters' outputs
+  unsigned long GetSolutionRevision() const { return this->SolutionRevision; }
+  void IncrementSolutionRevision() { this->SolutionRevision++; }
+
+  // The plane of the crinkle clip that produced the data sets, which keeps
+  // the cells with a point on its negative side. If the clip was deferred
+  // (see PyFRCrinkleClipFilter::SetDeferred), the data sets hold the
+  // unclipped cells, and filters that cannot apply the plane themselves must
+  // clip the cells first. Otherwise the cells are already clipped, and the
+  // plane lets filters that resample them clip their own cells likewise.
+  void SetClipPlane(const vtkm::Vec<FPType,3>& origin,
+                    const vtkm::Vec<FPType,3>& normal,
+                    bool deferred)
+  {
+    this->Clipped = true;
+    this->ClipDeferred = deferred;
+    this->ClipOrigin = origin;
+    this->ClipNormal = normal;
+  }
+  void ClearClipPlane() { this->Clipped = this->ClipDeferred = false; }
+  bool HasClipPlane() const { return this->Clipped; }
+  bool IsClipDeferred() const { return this->ClipDeferred; }
+  const vtkm::Vec<FPType,3>& GetClipOrigin() const { return this->ClipOrigin; }
+  const vtkm::Vec<FPType,3>& GetClipNormal() const { return this->ClipNormal; }
+
+  // When enabled (the default), the host vertex and connectivity arrays are
+  // wrapped in place rather than copied. The solver must keep them alive
+  // until the mesh is next modified. In mixed precision builds the vertices
+  // are always converted into a copy.
+  void SetZeroCopyMesh(bool b) { this->ZeroCopyMesh = b; }
+  bool GetZeroCopyMesh() const { return this->ZeroCopyMesh; }
+
+  // When enabled, the elements of each data set are sorted along a Morton
+  // curve when the mesh is built, so that elements close in space are close
+  // in memory. Each element's points and subdivided cells move together and
+  // stay consecutive, so the layout by element is kept. The vertices and
+  // connectivity are then always copied, and the fields read the solution
+  // through the element order (see GetElementOrder).
+  void SetReorderCells(bool b)
+  {
+    if (this->ReorderCells != b)
+      this->MeshModified = true;
+    this->ReorderCells = b;
+  }
+  bool GetReorderCells() const { return this->ReorderCells; }
+
+  // The solver's element of each element of a data set, computed once per
+  // mesh, or an empty array if its elements were not reordered
+  const vtkm::cont::ArrayHandle<vtkm::Id>& GetElementOrder(unsigned i) const
+  { return this->ElementOrders[i]; }
+
+  // When enabled, each update gathers the solution variables from the
+  // solver's padded layout into contiguous arrays, so that the filters read
+  // them directly rather than through StridedDataFunctor. This trades one
+  // copy per time step for cheaper reads in every filter.
+  void SetMaterializeFields(bool b) { this->MaterializeFields = b; }
+  bool GetMaterializeFields() const { return this->MaterializeFields; }
+
+  // Ratio of specific heats and specific gas constant used to compute the
+  // derived fields
+  void SetGamma(FPType gamma) { this->Gamma = gamma; }
+  FPType GetGamma() const { return this->Gamma; }
+  void SetGasConstant(FPType r) { this->GasConstant = r; }
+  FPType GetGasConstant() const { return this->GasConstant; }
+
+  // Field registry. Every data set holds the same fields, stored in index
+  // order, so a field is looked up by index without touching its name.
+  //
+  // The solver must provide at least five variables (rho, rhou, rhov, rhow,
+  // E and any turbulence or species variables), which is checked when the
+  // mesh is built. The first fields are the StandardFields below, whose
+  // indices match the enumerations in PyFR.xml; the remaining solution
+  // variables follow as "variable_<n>".
+  enum StandardField { DENSITY, PRESSURE, VELOCITY_U, VELOCITY_V, VELOCITY_W,
+                       MOMENTUM_U, MOMENTUM_V, MOMENTUM_W, ENERGY,
+                       VELOCITY_MAGNITUDE, TEMPERATURE, MACH, TOTAL_PRESSURE,
+                       VORTICITY_MAGNITUDE, Q_CRITERION, LAMBDA2,
+                       NUMBER_OF_STANDARD_FIELDS };
+
+  unsigned GetNumberOfFields() const { return this->FieldNames.size(); }
+  const std::string& GetFieldName(unsigned i) const
+  { return this->FieldNames[i]; }
+  int GetFieldIndex(const std::string& name) const;
+  const vtkm::cont::Field& GetField(unsigned dataSet, unsigned i) const
+  {
+    if (i >= this->FieldNames.size())
+      throw std::out_of_range("PyFRData: field index out of range");
+    return this->dataSets[dataSet].GetField(i);
+  }
+
+  // Used by filters whose output carries the fields of their input
+  const std::vector<std::string>& GetFieldNames() const
+  { return this->FieldNames; }
+  void SetFieldNames(const std::vector<std::string>& names)
+  { this->FieldNames = names; }
+
+  // Fields that downstream filters consume. Fields that are not requested
+  // are bound to empty arrays on update, so derived and converted fields that
+  // nobody reads are neither computed nor copied. All fields are requested
+  // by default.
+  void RequestAllFields()
+  { this->AllFieldsRequested = true; this->RequestedFields.clear(); }
+  void SetRequestedFields(const std::vector<std::string>& names)
+  { this->AllFieldsRequested = false; this->RequestedFields = names; }
+  bool GetAllFieldsRequested() const { return this->AllFieldsRequested; }
+  const std::vector<std::string>& GetRequestedFields() const
+  { return this->RequestedFields; }
+  bool IsFieldRequested(unsigned i) const;
+
+  // Number of nodes along each edge of a data set's high-order hexahedra, or
+  // 0 if its elements are not hexahedra
+  int GetNodesPerEdge(unsigned i) const
+  { return i < this->NodesPerEdge.size() ? this->NodesPerEdge[i] : 0; }
+  const std::vector<int>& GetNodesPerEdge() const
+  { return this->NodesPerEdge; }
+  void SetNodesPerEdge(const std::vector<int>& nodesPerEdge)
+  { this->NodesPerEdge = nodesPerEdge; }
 
 private:
-  static std::map<int,std::string> fieldName;
-  static std::map<std::string,int> fieldIndex;
-  static bool mapsPopulated;
-  static bool PopulateMaps();
+  void UpdateMesh();
+  void BuildMesh(MeshDataForCellType*,Vec3ArrayHandle&,CellSet&,
+                 vtkm::cont::ArrayHandle<vtkm::Id>&);
+  void BuildCoarseCellSets(MeshDataForCellType*,
+                           const vtkm::cont::ArrayHandle<vtkm::Id>&,int,
+                           std::vector<CellSet>&);
+  void BuildFieldRegistry(int);
+  void UpdateSolution(unsigned);
+  template<typename ArrayHandleType>
+  vtkm::cont::DynamicArrayHandle BindField(unsigned,int,
+                                           const ArrayHandleType&);
+  void UpdateGradients(unsigned,const SolutionArrayHandle&,
+                       std::vector<vtkm::cont::DynamicArrayHandle>&);
 
   struct CatalystData* catalystData;
-  vtkm::cont::DataSet dataSet;
+  std::vector<vtkm::cont::DataSet> dataSets;
+
+  // Cached mesh for each data set, the index of its cell type in the
+  // CatalystData, the number of nodes along each edge of its hexahedra
+  // (0 for other cell types) and the order of its elements
+  std::vector<int> CellTypeIndex;
+  std::vector<int> NodesPerEdge;
+  std::vector<vtkm::cont::ArrayHandle<vtkm::Id> > ElementOrders;
+  std::vector<Vec3ArrayHandle> Coordinates;
+  std::vector<CellSet> CellSets;
+  std::vector<std::vector<CellSet> > CoarseCellSets;
+  std::vector<std::vector<MaterializedDataArrayHandle> > MaterializedFields;
+  std::vector<std::string> FieldNames;
+  std::vector<std::string> RequestedFields;
+  bool AllFieldsRequested;
+  int NumberOfVariables;
+  bool ZeroCopyMesh;
+  bool ReorderCells;
+  bool MaterializeFields;
+  FPType Gamma;
+  FPType GasConstant;
+  bool MeshModified;
+  unsigned long MeshRevision;
+  unsigned long SolutionRevision;
+  bool Clipped;
+  bool ClipDeferred;
+  vtkm::Vec<FPType,3> ClipOrigin;
+  vtkm::Vec<FPType,3> ClipNormal;
 };
 
 #endif
@@ -0,0 +1,26 @@
+#ifndef PYFRDEVICEADAPTER_H
+#define PYFRDEVICEADAPTER_H
+
+#define BOOST_SP_DISABLE_THREADS
+
+// The device adapter used by the PyFR filters is chosen when the project is
+// configured (see PYFR_DEVICE_ADAPTER in the top-level CMakeLists.txt), which
+// defines exactly one of the PYFR_DEVICE_ADAPTER_* macros below. The CPU
+// adapters run the same worklets as the CUDA adapter; they only differ in
+// where the solver's arrays are expected to live.
+#if defined(PYFR_DEVICE_ADAPTER_CUDA)
+#include <vtkm/cont/cuda/DeviceAdapterCuda.h>
+typedef vtkm::cont::DeviceAdapterTagCuda PyFRDeviceAdapter;
+#elif defined(PYFR_DEVICE_ADAPTER_TBB)
+#include <vtkm/cont/tbb/DeviceAdapterTBB.h>
+typedef vtkm::cont::DeviceAdapterTagTBB PyFRDeviceAdapter;
+#elif defined(PYFR_DEVICE_ADAPTER_SERIAL)
+#include <vtkm/cont/DeviceAdapterSerial.h>
+typedef vtkm::cont::DeviceAdapterTagSerial PyFRDeviceAdapter;
+#else
+// Every translation unit that shares the PyFR types must agree on the
+// adapter, so a missing define is an error rather than a silent default
+#error "No PYFR_DEVICE_ADAPTER_* define: the compile flags were overridden"
+#endif
+
+#endif
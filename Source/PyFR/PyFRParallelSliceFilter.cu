@@ -1,15 +1,18 @@
 #include "PyFRParallelSliceFilter.h"
 
 #include <vtkm/ImplicitFunctions.h>
-#include <vtkm/cont/cuda/DeviceAdapterCuda.h>
+#include "PyFRDeviceAdapter.h"
 
+#include "AppendArrays.h"
 #include "CrinkleClip.h"
+#include "IsosurfaceFunctors.h"
 #include "IsosurfaceHexahedra.h"
 #include "PyFRData.h"
 #include "PyFRContourData.h"
 
 //----------------------------------------------------------------------------
-PyFRParallelSliceFilter::PyFRParallelSliceFilter() : NPlanes(1), Spacing(1.)
+PyFRParallelSliceFilter::PyFRParallelSliceFilter() : NPlanes(1), Spacing(1.),
+                                                     ResolutionLevel(0)
 {
   this->Origin[0] = this->Origin[1] = this->Origin[2] = 0.;
   this->Normal[0] = this->Normal[1] = 0.;
@@ -47,11 +50,10 @@ void PyFRParallelSliceFilter::operator()(PyFRData* input,
   typedef std::vector<FPType> DataVec;
   typedef PyFRData::CellSet CellSet;
 
-  const vtkm::cont::DataSet& dataSet = input->GetDataSet();
-
-  CoordinateArrayHandle coords = dataSet.GetCoordinateSystem().GetData()
-    .CastToArrayHandle(CoordinateArrayHandle::ValueType(),
-                       CoordinateArrayHandle::StorageTag());
+  const unsigned nCellTypes = input->GetNumberOfCellTypes();
+  for (unsigned t=this->isosurfaceFilters.size();t<nCellTypes;t++)
+    this->isosurfaceFilters.push_back(IsosurfaceFilter());
+  this->isosurfaceFilters.resize(nCellTypes);
 
   vtkm::Plane func(vtkm::Vec<FPType,3>(this->Origin[0],
                                        this->Origin[1],
@@ -62,9 +64,6 @@ void PyFRParallelSliceFilter::operator()(PyFRData* input,
 
   vtkm::ImplicitFunctionValue<vtkm::Plane> function(func);
 
-  vtkm::cont::ArrayHandleTransform<FPType,CoordinateArrayHandle,
-    vtkm::ImplicitFunctionValue<vtkm::Plane> > dataArray(coords,function);
-
   DataVec dataVec;
   Vec3HandleVec verticesVec;
   Vec3HandleVec normalsVec;
@@ -76,12 +75,47 @@ void PyFRParallelSliceFilter::operator()(PyFRData* input,
     normalsVec.push_back(output->GetContour(i).GetNormals());
     }
 
-  isosurfaceFilter.Run(dataVec,
-                       dataSet.GetCellSet().CastTo(CellSet()),
-                       dataSet.GetCoordinateSystem(),
-                       dataArray,
-                       verticesVec,
-                       normalsVec);
+  std::vector<Vec3HandleVec> verticesByType(nCellTypes);
+  std::vector<Vec3HandleVec> normalsByType(nCellTypes);
+  for (unsigned t=0;t<nCellTypes;t++)
+    {
+    const vtkm::cont::DataSet& dataSet = input->GetDataSet(t);
+
+    CoordinateArrayHandle coords = dataSet.GetCoordinateSystem().GetData()
+      .CastToArrayHandle(CoordinateArrayHandle::ValueType(),
+                         CoordinateArrayHandle::StorageTag());
+
+    vtkm::cont::ArrayHandleTransform<FPType,CoordinateArrayHandle,
+      vtkm::ImplicitFunctionValue<vtkm::Plane> > dataArray(coords,function);
+
+    this->isosurfaceFilters[t].SetNodesPerEdge(input->GetNodesPerEdge(t));
+    this->isosurfaceFilters[t].Run(dataVec,
+                                   input->GetCellSet(t,this->ResolutionLevel)
+                                   .CastTo(CellSet()),
+                                   dataSet.GetCoordinateSystem(),
+                                   dataArray,
+                                   nCellTypes == 1 ? verticesVec :
+                                   verticesByType[t],
+                                   nCellTypes == 1 ? normalsVec :
+                                   normalsByType[t]);
+    }
+
+  if (nCellTypes == 1)
+    return;
+
+  vtkm::worklet::AppendArrays<DeviceTag> append;
+  for (unsigned i=0;i<output->GetNumberOfContours();i++)
+    {
+    Vec3HandleVec vertices;
+    Vec3HandleVec normals;
+    for (unsigned t=0;t<nCellTypes;t++)
+      {
+      vertices.push_back(verticesByType[t][i]);
+      normals.push_back(normalsByType[t][i]);
+      }
+    append.Run(vertices,verticesVec[i]);
+    append.Run(normals,normalsVec[i]);
+    }
 }
 
 //----------------------------------------------------------------------------
@@ -90,27 +124,52 @@ void PyFRParallelSliceFilter::MapFieldOntoSlices(int field,
                                                  PyFRContourData* output)
 {
   typedef std::vector<PyFRContour::ScalarDataArrayHandle> ScalarDataHandleVec;
+  typedef std::vector<vtkm::cont::ArrayHandle<FPType> > FieldHandleVec;
 
-  const vtkm::cont::DataSet& dataSet = input->GetDataSet();
+  const unsigned nCellTypes = input->GetNumberOfCellTypes();
 
   ScalarDataHandleVec scalarDataHandleVec;
   for (unsigned j=0;j<output->GetNumberOfContours();j++)
     {
     output->GetContour(j).SetScalarDataType(field);
+    output->GetContour(j).SetScalarDataName(input->GetFieldName(field));
     PyFRContour::ScalarDataArrayHandle scalars_out =
       output->GetContour(j).GetScalarData();
     scalarDataHandleVec.push_back(scalars_out);
     }
 
-  vtkm::cont::Field projectedField =
-    dataSet.GetField(PyFRData::FieldName(field));
-
-  PyFRData::ScalarDataArrayHandle projectedArray = projectedField.GetData()
-    .CastToArrayHandle(PyFRData::ScalarDataArrayHandle::ValueType(),
-                       PyFRData::ScalarDataArrayHandle::StorageTag());
+  std::vector<FieldHandleVec> scalarsByType(nCellTypes);
+  for (unsigned t=0;t<nCellTypes;t++)
+    {
+    vtkm::cont::DynamicArrayHandleBase<PyFRData::FieldTypeList,
+      PyFRData::FieldStorageList> projectedArray =
+      input->GetField(t,field).GetData()
+      .ResetTypeList(PyFRData::FieldTypeList())
+      .ResetStorageList(PyFRData::FieldStorageList());
+
+    if (nCellTypes == 1)
+      {
+      projectedArray.CastAndCall(
+        MapFieldFunctor<IsosurfaceFilter,PyFRContour::ScalarDataArrayHandle>(
+          &this->isosurfaceFilters[t],scalarDataHandleVec));
+      return;
+      }
+
+    // NB: Cannot call resize to increase the lengths of vectors of array
+    // handles!
+    for (unsigned j=0;j<output->GetNumberOfContours();j++)
+      scalarsByType[t].push_back(vtkm::cont::ArrayHandle<FPType>());
+    projectedArray.CastAndCall(
+      MapFieldFunctor<IsosurfaceFilter,vtkm::cont::ArrayHandle<FPType> >(
+        &this->isosurfaceFilters[t],scalarsByType[t]));
+    }
 
-  isosurfaceFilter.MapFieldOntoIsosurfaces<
-    PyFRData::ScalarDataArrayHandle,
-      PyFRContour::ScalarDataArrayHandle>(projectedArray,
-                                          scalarDataHandleVec);
+  vtkm::worklet::AppendArrays<DeviceTag> append;
+  for (unsigned j=0;j<output->GetNumberOfContours();j++)
+    {
+    FieldHandleVec scalars;
+    for (unsigned t=0;t<nCellTypes;t++)
+      scalars.push_back(scalarsByType[t][j]);
+    append.Run(scalars,scalarDataHandleVec[j]);
+    }
 }
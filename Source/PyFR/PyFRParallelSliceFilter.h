@@ -6,7 +6,7 @@
 #include <string>
 #include <vector>
 
-#include <vtkm/cont/cuda/DeviceAdapterCuda.h>
+#include "PyFRDeviceAdapter.h"
 #include "IsosurfaceHexahedra.h"
 
 class PyFRData;
@@ -15,9 +15,9 @@ class PyFRContourData;
 class PyFRParallelSliceFilter
 {
 private:
-  typedef vtkm::cont::DeviceAdapterTagCuda CudaTag;
+  typedef ::PyFRDeviceAdapter DeviceTag;
 
-  typedef vtkm::worklet::IsosurfaceFilterHexahedra<FPType,CudaTag>
+  typedef vtkm::worklet::IsosurfaceFilterHexahedra<FPType,DeviceTag>
   IsosurfaceFilter;
 
 public:
@@ -27,15 +27,17 @@ public:
   void SetPlane(FPType,FPType,FPType,FPType,FPType,FPType);
   void SetSpacing(FPType spacing) { this->Spacing = spacing; }
   void SetNumberOfPlanes(unsigned n) { this->NPlanes = n; }
+  void SetResolutionLevel(unsigned level) { this->ResolutionLevel = level; }
 
   void operator ()(PyFRData*,PyFRContourData*);
   void MapFieldOntoSlices(int,PyFRData*,PyFRContourData*);
 
 protected:
-  IsosurfaceFilter isosurfaceFilter;
+  std::vector<IsosurfaceFilter> isosurfaceFilters;
   FPType Origin[3];
   FPType Normal[3];
   FPType Spacing;
   unsigned NPlanes;
+  unsigned ResolutionLevel;
 };
 #endif
@@ -1,6 +1,8 @@
 #ifndef PYFRCONTOURFILTER_H
 #define PYFRCONTOURFILTER_H
 
+#include <vector>
+
 class PyFRData;
 class PyFRContourData;
 
@@ -8,11 +10,19 @@ struct PyFRContourFilter
 {
   void operator ()(PyFRData*,PyFRContourData*) const {}
   void MapFieldOntoIsosurfaces(int,PyFRData*,PyFRContourData*) {}
+  void MapFieldsOntoIsosurfaces(const std::vector<int>&,PyFRData*,
+                                PyFRContourData*) {}
 
   void AddContourValue(FPType) {}
   void ClearContourValues() {}
 
   void SetContourField(int) {}
+  void SetRefinement(unsigned) {}
+  void SetMergeDuplicatePoints(bool) {}
+  void SetTemporalCoherence(bool) {}
+  void SetDirtyCellFraction(double) {}
+  void SetUseBlockIndex(bool) {}
+  void SetUseFlyingEdges(bool) {}
 }
 ;
 #endif
@@ -6,7 +6,10 @@ class PyFRData;
 struct PyFRCrinkleClipFilter
 {
   void SetPlane(FPType,FPType,FPType,FPType,FPType,FPType) {}
+  void SetResolutionLevel(unsigned) {}
+  void SetDeferred(bool) {}
 
   void operator ()(PyFRData*,PyFRData*) const {}
+  void MapFields(PyFRData*,PyFRData*) const {}
 };
 #endif
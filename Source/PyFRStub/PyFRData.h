@@ -1,6 +1,21 @@
 #ifndef PYFRDATA_H
 #define PYFRDATA_H
 
-struct PyFRData {};
+#include <string>
+#include <vector>
+
+struct PyFRData
+{
+  void SetMeshModified() {}
+  void SetMaterializeFields(bool) {}
+  void SetReorderCells(bool) {}
+  void SetGamma(double) {}
+  void SetGasConstant(double) {}
+  unsigned long GetMeshRevision() const { return 0; }
+  void RequestAllFields() {}
+  void SetRequestedFields(const std::vector<std::string>&) {}
+  unsigned GetNumberOfFields() const { return 0; }
+  std::string GetFieldName(unsigned) const { return std::string(); }
+};
 
 #endif
@@ -11,6 +11,7 @@ struct PyFRParallelSliceFilter
   void SetPlane(FPType,FPType,FPType,FPType,FPType,FPType) {}
   void SetSpacing(FPType) {}
   void SetNumberOfPlanes(unsigned) {}
+  void SetResolutionLevel(unsigned) {}
 
   void operator ()(PyFRData*,PyFRContourData*) const {}
   void MapFieldOntoSlices(int,PyFRData*,PyFRContourData*) {}
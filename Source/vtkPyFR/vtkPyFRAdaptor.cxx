@@ -1,6 +1,7 @@
 #include <cstdio>
 #include <iostream>
 #include <string>
+#include <vector>
 #include "vtkPyFRAdaptor.h"
 
 #include <vtkCPDataDescription.h>
@@ -80,11 +81,39 @@ void CatalystFinalize(void* p)
     }
 }
 
+//----------------------------------------------------------------------------
+void CatalystMeshChanged(void* p)
+{
+  vtkPyFRData* data = static_cast<vtkPyFRData*>(p);
+  data->GetData()->SetMeshModified();
+}
+
+//----------------------------------------------------------------------------
+void CatalystMaterializeFields(void* p, bool materialize)
+{
+  vtkPyFRData* data = static_cast<vtkPyFRData*>(p);
+  data->GetData()->SetMaterializeFields(materialize);
+}
+
+//----------------------------------------------------------------------------
+void CatalystReorderCells(void* p, bool reorder)
+{
+  vtkPyFRData* data = static_cast<vtkPyFRData*>(p);
+  data->GetData()->SetReorderCells(reorder);
+}
+
+//----------------------------------------------------------------------------
+void CatalystSetGasConstants(void* p, double gamma, double r)
+{
+  vtkPyFRData* data = static_cast<vtkPyFRData*>(p);
+  data->GetData()->SetGamma(gamma);
+  data->GetData()->SetGasConstant(r);
+}
+
 //----------------------------------------------------------------------------
 void CatalystCoProcess(double time,unsigned int timeStep, void* p,bool lastTimeStep)
 {
   vtkPyFRData* data = static_cast<vtkPyFRData*>(p);
-  data->GetData()->Update();
   vtkNew<vtkCPDataDescription> dataDescription;
   dataDescription->AddInput("input");
   dataDescription->SetTimeData(time, timeStep);
@@ -96,7 +125,25 @@ void CatalystCoProcess(double time,unsigned int timeStep, void* p,bool lastTimeS
     }
   if(Processor->RequestDataDescription(dataDescription.GetPointer()) != 0)
     {
-    dataDescription->GetInputDescriptionByName("input")->SetGrid(data);
+    vtkCPInputDataDescription* input =
+      dataDescription->GetInputDescriptionByName("input");
+
+    // Bind only the fields that the pipelines asked for
+    if (input->GetAllFields())
+      data->GetData()->RequestAllFields();
+    else
+      {
+      std::vector<std::string> fields;
+      for (unsigned i=0;i<input->GetNumberOfFields();i++)
+        fields.push_back(input->GetFieldName(i));
+      data->GetData()->SetRequestedFields(fields);
+      }
+
+    // Rebind the fields to the current solution arrays; the mesh is only
+    // rebuilt if CatalystMeshChanged() has been called.
+    data->GetData()->Update();
+    data->Modified();
+    input->SetGrid(data);
     Processor->CoProcess(dataDescription.GetPointer());
     }
 }
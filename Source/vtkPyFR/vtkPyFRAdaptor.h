@@ -9,6 +9,23 @@ extern "C"
 
   void CatalystFinalize(void* p);
 
+  /* Flag the mesh as having moved, so it is rebuilt at the next
+     CatalystCoProcess call. */
+  void CatalystMeshChanged(void* p);
+
+  /* Gather the solution into contiguous arrays at each time step, rather
+     than reading it in place from the solver's padded layout. */
+  void CatalystMaterializeFields(void* p, bool materialize);
+
+  /* Sort the elements, with their points and subdivided cells, along a
+     Morton curve when the mesh is built, improving the memory locality of
+     the filters. */
+  void CatalystReorderCells(void* p, bool reorder);
+
+  /* Set the ratio of specific heats and the specific gas constant used to
+     compute the derived fields (pressure, temperature, Mach number, ...). */
+  void CatalystSetGasConstants(void* p, double gamma, double r);
+
   void CatalystCoProcess(double time, unsigned int timeStep, void* p, bool lastTimeStep=false);
 #ifdef __cplusplus
 }
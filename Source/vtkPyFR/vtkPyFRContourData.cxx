@@ -63,6 +63,16 @@ std::size_t vtkPyFRContourData::GetSizeOfContour(int i) const
   return 0;
 }
 
+//----------------------------------------------------------------------------
+std::size_t vtkPyFRContourData::GetNumberOfContourIndices(int i) const
+{
+  if (this->data)
+    {
+    return this->data->GetContourIndexCount(i);
+    }
+  return 0;
+}
+
 //----------------------------------------------------------------------------
 void vtkPyFRContourData::ReleaseResources()
 {
@@ -146,6 +156,16 @@ bool vtkPyFRContourData::HasData(int i) const
   return false;
 }
 
+//----------------------------------------------------------------------------
+bool vtkPyFRContourData::HasNormals(int i) const
+{
+  if (this->HasData(i))
+    {
+    return this->data->GetContour(i).GetNormals().GetNumberOfValues() > 0;
+    }
+  return false;
+}
+
 //----------------------------------------------------------------------------
 void vtkPyFRContourData::SetColorPalette(int i,double* range)
 {
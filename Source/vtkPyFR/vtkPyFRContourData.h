@@ -20,6 +20,7 @@ public:
   int GetNumberOfContours() const;
 
   std::size_t GetSizeOfContour(int i) const;
+  std::size_t GetNumberOfContourIndices(int i) const;
 
   void ReleaseResources();
 
@@ -28,6 +29,7 @@ public:
 
   bool HasData() const;
   bool HasData(int i) const;
+  bool HasNormals(int i) const;
 
   double* GetColorRange() { return this->ColorRange; }
   void SetColorPalette(int,double*);
@@ -30,8 +30,15 @@ int vtkPyFRContourFilter::PyFRDataTypesRegistered =
 vtkStandardNewMacro(vtkPyFRContourFilter);
 
 //----------------------------------------------------------------------------
-vtkPyFRContourFilter::vtkPyFRContourFilter() : ContourField(0)
+vtkPyFRContourFilter::vtkPyFRContourFilter() : ContourField(0),
+                                               Refinement(0),
+                                               MergePoints(0),
+                                               TemporalCoherence(0),
+                                               DirtyCellFraction(0.25),
+                                               BlockIndex(0),
+                                               FlyingEdges(0)
 {
+  this->Filter = new PyFRContourFilter();
   this->ColorPalette = 1;
   this->ColorRange[0] = 0.;
   this->ColorRange[1] = 1.;
@@ -40,6 +47,7 @@ vtkPyFRContourFilter::vtkPyFRContourFilter() : ContourField(0)
 //----------------------------------------------------------------------------
 vtkPyFRContourFilter::~vtkPyFRContourFilter()
 {
+  delete this->Filter;
 }
 
 //----------------------------------------------------------------------------
@@ -58,16 +66,27 @@ int vtkPyFRContourFilter::RequestData(
   vtkPyFRContourData *output = vtkPyFRContourData::SafeDownCast(
     outInfo->Get(vtkDataObject::DATA_OBJECT()));
 
-  PyFRContourFilter filter;
+  // The filter persists across time steps, so that it may reuse the
+  // previous step's classification of the cells
+  PyFRContourFilter& filter = *this->Filter;
+  filter.ClearContourValues();
   for (unsigned i=0;i<this->ContourValues.size();i++)
     {
     filter.AddContourValue(this->ContourValues[i]);
     }
   filter.SetContourField(this->ContourField);
+  filter.SetRefinement(this->Refinement > 0 ? this->Refinement : 0);
+  filter.SetMergeDuplicatePoints(this->MergePoints != 0);
+  filter.SetTemporalCoherence(this->TemporalCoherence != 0);
+  filter.SetDirtyCellFraction(this->DirtyCellFraction);
+  filter.SetUseBlockIndex(this->BlockIndex != 0);
+  filter.SetUseFlyingEdges(this->FlyingEdges != 0);
   filter(input->GetData(),output->GetData());
   output->SetColorPalette(this->ColorPalette,this->ColorRange);
   filter.MapFieldOntoIsosurfaces(this->MappedField,input->GetData(),
                                  output->GetData());
+  filter.MapFieldsOntoIsosurfaces(this->MappedFields,input->GetData(),
+                                  output->GetData());
   output->Modified();
   return 1;
 }
@@ -118,11 +137,41 @@ void vtkPyFRContourFilter::SetMappedField(int i)
 }
 //----------------------------------------------------------------------------
 
+void vtkPyFRContourFilter::SetNumberOfMappedFields(int n)
+{
+  if (this->MappedFields.size() != static_cast<unsigned>(n))
+    {
+    this->MappedFields.resize(n,0);
+    this->Modified();
+    }
+}
+//----------------------------------------------------------------------------
+
+void vtkPyFRContourFilter::SetMappedFields(int i,int field)
+{
+  if (i < this->MappedFields.size() && this->MappedFields[i] != field)
+    {
+    this->MappedFields[i] = field;
+    this->Modified();
+    }
+}
+//----------------------------------------------------------------------------
+
 void vtkPyFRContourFilter::PrintSelf(ostream& os, vtkIndent indent)
 {
   this->Superclass::PrintSelf(os, indent);
   os << indent << "ContourField: " << this->ContourField << "\n";
   os << indent << "MappedField: " << this->MappedField << "\n";
+  os << indent << "MappedFields: ";
+  for (unsigned i=0;i<this->MappedFields.size();i++)
+    os << this->MappedFields[i] << " ";
+  os << "\n";
+  os << indent << "Refinement: " << this->Refinement << "\n";
+  os << indent << "MergePoints: " << this->MergePoints << "\n";
+  os << indent << "TemporalCoherence: " << this->TemporalCoherence << "\n";
+  os << indent << "DirtyCellFraction: " << this->DirtyCellFraction << "\n";
+  os << indent << "BlockIndex: " << this->BlockIndex << "\n";
+  os << indent << "FlyingEdges: " << this->FlyingEdges << "\n";
   os << indent << "ContourValues: ";
   for (unsigned i=0;i<this->ContourValues.size();i++)
     os << this->ContourValues[i] << "\n";
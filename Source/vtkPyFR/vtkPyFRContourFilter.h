@@ -6,6 +6,8 @@
 
 #include "vtkPyFRContourDataAlgorithm.h"
 
+class PyFRContourFilter;
+
 class VTK_EXPORT vtkPyFRContourFilter : public vtkPyFRContourDataAlgorithm
 {
 public:
@@ -23,6 +25,50 @@ public:
   void SetContourField(int i);
   void SetMappedField(int i);
 
+  // Description:
+  // Additional fields interpolated onto the isosurfaces alongside the color
+  // field, and written out with them. Fields of the same array type share a
+  // single interpolation pass.
+  void SetNumberOfMappedFields(int n);
+  void SetMappedFields(int i,int field);
+  int GetNumberOfMappedFields() const { return this->MappedFields.size(); }
+  int GetMappedFields(int i) const { return this->MappedFields[i]; }
+
+  vtkSetMacro(Refinement,int);
+  vtkGetMacro(Refinement,int);
+
+  vtkSetMacro(MergePoints,int);
+  vtkGetMacro(MergePoints,int);
+
+  // Description:
+  // When on, the contour filter persists across time steps, and reuses its
+  // previous classification of the cells for the isovalues that no point has
+  // crossed since.
+  vtkSetMacro(TemporalCoherence,int);
+  vtkGetMacro(TemporalCoherence,int);
+
+  // Description:
+  // With TemporalCoherence, when more than this fraction of the cells belong
+  // to elements whose points crossed an isovalue, all of the cells are
+  // classified again instead of just theirs.
+  vtkSetClampMacro(DirtyCellFraction,double,0.,1.);
+  vtkGetMacro(DirtyCellFraction,double);
+
+  // Description:
+  // When on, the contour field's range is indexed over blocks of elements,
+  // and only the blocks that the isovalues cross are contoured. The index is
+  // kept until the solution changes, so it only helps when the same solution
+  // is contoured more than once.
+  vtkSetMacro(BlockIndex,int);
+  vtkGetMacro(BlockIndex,int);
+
+  // Description:
+  // When on, contour with the edge-centric engine, which classifies each
+  // mesh edge once and always merges the contours' points. It keeps the
+  // mesh's edges, about 144 bytes per cell with 64-bit ids.
+  vtkSetMacro(FlyingEdges,int);
+  vtkGetMacro(FlyingEdges,int);
+
   vtkSetMacro(ColorPalette,int);
   vtkGetMacro(ColorPalette,int);
 
@@ -36,6 +82,14 @@ protected:
   std::vector<double> ContourValues;
   int ContourField;
   int MappedField;
+  std::vector<int> MappedFields;
+  int Refinement;
+  int MergePoints;
+  int TemporalCoherence;
+  double DirtyCellFraction;
+  int BlockIndex;
+  int FlyingEdges;
+  PyFRContourFilter* Filter;
   int ColorPalette;
   double ColorRange[2];
 
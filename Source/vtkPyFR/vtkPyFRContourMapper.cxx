@@ -59,7 +59,7 @@ vtkPyFRContourMapper::vtkPyFRContourMapper():
   this->ContourData = NULL;
 
   this->ColorVBO = vtkPyFRVertexBufferObject::New();
-  // this->NormalVBO = vtkPyFRVertexBufferObject::New();
+  this->NormalVBO = vtkPyFRVertexBufferObject::New();
 
   //Important override the default VBO with our own custom VBO Implementation
   //Likewise the same needs
@@ -77,8 +77,8 @@ vtkPyFRContourMapper::~vtkPyFRContourMapper()
   this->ColorVBO->Delete();
   this->ColorVBO = NULL;
 
-  // this->NormalVBO->Delete();
-  // this->NormalVBO = NULL;
+  this->NormalVBO->Delete();
+  this->NormalVBO = NULL;
 }
 
 
@@ -86,7 +86,7 @@ vtkPyFRContourMapper::~vtkPyFRContourMapper()
 void vtkPyFRContourMapper::ReleaseGraphicsResources(vtkWindow* win)
 {
   this->ColorVBO->ReleaseGraphicsResources();
-  // this->NormalVBO->ReleaseGraphicsResources();
+  this->NormalVBO->ReleaseGraphicsResources();
   this->Superclass::ReleaseGraphicsResources(win);
 }
 
@@ -199,7 +199,7 @@ void vtkPyFRContourMapper::RenderPieceStart(vtkRenderer* ren, vtkActor *actor)
   // Bind the OpenGL, this is shared between the different primitive/cell types.
   this->VBO->Bind();
   this->ColorVBO->Bind();
-  // this->NormalVBO->Bind();
+  this->NormalVBO->Bind();
 
   this->LastBoundBO = NULL;
 }
@@ -258,13 +258,13 @@ void vtkPyFRContourMapper::RenderPieceDraw(vtkRenderer* ren, vtkActor *actor)
       (representation == VTK_WIREFRAME) ? GL_LINES : GL_TRIANGLES;
     glDrawRangeElements(mode, 0,
                         static_cast<GLuint>(this->VBO->VertexCount - 1),
-                        static_cast<GLuint>(this->ContourData->
-                                            GetSizeOfContour(this->
-                                                             ActiveContour)-1),
+                        static_cast<GLsizei>(this->ContourData->
+                                             GetNumberOfContourIndices(this->
+                                                             ActiveContour)),
                       GL_UNSIGNED_INT,
                       reinterpret_cast<const GLvoid *>(NULL));
     this->Tris.IBO->Release();
-    this->PrimitiveIDOffset += this->ContourData->GetSizeOfContour(this->ActiveContour)/3;
+    this->PrimitiveIDOffset += this->ContourData->GetNumberOfContourIndices(this->ActiveContour)/3;
     }
 
   if (selector && (
@@ -324,7 +324,7 @@ bool vtkPyFRContourMapper::GetNeedToRebuildShaders(
   // three that mix in a complex way are representation POINT, Interpolation FLAT
   // and having normals or not.
   bool needLighting = false;
-  bool haveNormals = false;
+  bool haveNormals = (this->VBO->NormalOffset != 0);
   bool isTrisOrStrips = (&cellBO == &this->Tris || &cellBO == &this->TriStrips);
   needLighting = (isTrisOrStrips ||
     (!isTrisOrStrips && actor->GetProperty()->GetInterpolation() != VTK_FLAT && haveNormals));
@@ -463,6 +463,22 @@ void vtkPyFRContourMapper::BuildBufferObjects(vtkRenderer *ren, vtkActor *act)
     coordsVBO->CreateVerticesVBO(this->ContourData, this->ActiveContour);
     this->ColorVBO->CreateColorsVBO(this->ContourData, this->ActiveContour);
 
+    //the superclass only declares the normalMC attribute in its shaders
+    //when the vertex VBO reports an offset for normals. Ours are held in
+    //their own VBO, which is bound to the attribute in
+    //SetMapperShaderParameters, so the offset itself is never used
+    if (this->ContourData->HasNormals(this->ActiveContour))
+      {
+      this->NormalVBO->CreateNormalsVBO(this->ContourData, this->ActiveContour);
+      coordsVBO->NormalOffset = sizeof(float) * 3;
+      }
+    else
+      {
+      //otherwise the attribute would stay bound to the previous contour's
+      //normals
+      coordsVBO->NormalOffset = 0;
+      }
+
     this->BuildIBO(ren, act, this->ContourData);
     }
 }
@@ -503,14 +519,14 @@ void vtkPyFRContourMapper::SetMapperShaderParameters(vtkOpenGLHelper &cellBO,
       vtkErrorMacro(<< "Error setting 'vertexMC' in shader VAO.");
       }
 
-    // if (this->LastLightComplexity[&cellBO] > 0)
-    //   {
-    //   if (!cellBO.VAO->AddAttributeArray(cellBO.Program, this->NormalVBO,
-    //                                      "normalMC", offset, stride, VTK_FLOAT, 3, false))
-    //     {
-    //     vtkErrorMacro(<< "Error setting 'normalMC' in shader VAO.");
-    //     }
-    //   }
+    if (this->LastLightComplexity[&cellBO] > 0 && this->VBO->NormalOffset)
+      {
+      if (!cellBO.VAO->AddAttributeArray(cellBO.Program, this->NormalVBO,
+                                         "normalMC", offset, stride, VTK_FLOAT, 3, false))
+        {
+        vtkErrorMacro(<< "Error setting 'normalMC' in shader VAO.");
+        }
+      }
 
     if (!this->DrawingEdges)
       {
@@ -28,7 +28,10 @@ int vtkPyFRCrinkleClipFilter::PyFRDataTypeRegistered =
 vtkStandardNewMacro(vtkPyFRCrinkleClipFilter);
 
 //----------------------------------------------------------------------------
-vtkPyFRCrinkleClipFilter::vtkPyFRCrinkleClipFilter() : LastExecuteTime(0)
+vtkPyFRCrinkleClipFilter::vtkPyFRCrinkleClipFilter() : LastExecuteTime(0),
+                                                       LastMeshRevision(0),
+                                                       ResolutionLevel(0),
+                                                       Deferred(0)
 {
 }
 
@@ -65,15 +68,24 @@ int vtkPyFRCrinkleClipFilter::RequestData(
   vtkPyFRData *output = vtkPyFRData::SafeDownCast(
     outInfo->Get(vtkDataObject::DATA_OBJECT()));
 
-  if (this->GetMTime() > this->LastExecuteTime)
+  // The clip only depends upon the mesh, so it is recomputed when either the
+  // clip plane or the mesh changes. Otherwise, the input's fields (which are
+  // rebound to the solver's arrays every time step) are forwarded.
+  PyFRCrinkleClipFilter filter;
+  if (this->GetMTime() > this->LastExecuteTime ||
+      input->GetData()->GetMeshRevision() != this->LastMeshRevision)
     {
     this->LastExecuteTime = this->GetMTime();
-    PyFRCrinkleClipFilter filter;
+    this->LastMeshRevision = input->GetData()->GetMeshRevision();
     filter.SetPlane(this->Origin[0],this->Origin[1],this->Origin[2],
                     this->Normal[0],this->Normal[1],this->Normal[2]);
+    filter.SetResolutionLevel(this->ResolutionLevel);
+    filter.SetDeferred(this->Deferred != 0);
     filter(input->GetData(),output->GetData());
-    output->Modified();
     }
+  else
+    filter.MapFields(input->GetData(),output->GetData());
+  output->Modified();
 
   return 1;
 }
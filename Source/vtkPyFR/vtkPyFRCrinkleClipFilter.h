@@ -31,11 +31,27 @@ public:
   vtkSetVector3Macro(Origin,double);
   vtkGetVectorMacro(Origin,double,3);
 
+  // Description:
+  // Set/get the resolution level of the cells that are clipped. Level 0
+  // is the full resolution mesh.
+  vtkSetMacro(ResolutionLevel,int);
+  vtkGetMacro(ResolutionLevel,int);
+
+  // Description:
+  // When on, the cells are passed through unclipped along with the plane,
+  // which the contour filter then applies as it classifies the cells. Only
+  // use this when the output feeds contour filters alone.
+  vtkSetMacro(Deferred,int);
+  vtkGetMacro(Deferred,int);
+
 protected:
   unsigned long LastExecuteTime;
+  unsigned long LastMeshRevision;
 
   double Normal[3];
   double Origin[3];
+  int ResolutionLevel;
+  int Deferred;
 
   vtkPyFRCrinkleClipFilter();
   virtual ~vtkPyFRCrinkleClipFilter();
@@ -14,6 +14,8 @@
 #include "vtkPyFRIndexBufferObject.h"
 #include "vtkObjectFactory.h"
 
+#include "PyFRContourData.h"
+
 vtkStandardNewMacro(vtkPyFRIndexBufferObject)
 
 //-----------------------------------------------------------------------------
@@ -37,6 +39,15 @@ vtkPyFRIndexBufferObject::~vtkPyFRIndexBufferObject()
 std::size_t vtkPyFRIndexBufferObject::CreateIndexBuffer(vtkPyFRContourData* data,
                                                              int index)
 {
+  //contours with merged points carry their own indices, which vtkm
+  //transfers to opengl without going through main memory
+  if(data->GetData()->GetContour(index).IsIndexed())
+    {
+    this->SetType(vtkOpenGLIndexBufferObject::ElementArrayBuffer);
+    transfer::indices(data->GetData(),index,this->GetHandleRef());
+    return this->IndexCount = data->GetNumberOfContourIndices(index);
+    }
+
   const unsigned int numPoints =
       static_cast<unsigned int>(data->GetSizeOfContour(index) * 3);
 
@@ -32,7 +32,9 @@ vtkStandardNewMacro(vtkPyFRParallelSliceFilter);
 //----------------------------------------------------------------------------
 vtkPyFRParallelSliceFilter::vtkPyFRParallelSliceFilter() : Spacing(1.),
                                                            NumberOfPlanes(1),
-                                                           LastExecuteTime(0)
+                                                           ResolutionLevel(0),
+                                                           LastExecuteTime(0),
+                                                           LastMeshRevision(0)
 {
   this->Origin[0] = this->Origin[1] = this->Origin[2] = 0.;
   this->Normal[1] = this->Normal[2] = 0.;
@@ -65,13 +67,16 @@ int vtkPyFRParallelSliceFilter::RequestData(
   vtkPyFRContourData *output = vtkPyFRContourData::SafeDownCast(
     outInfo->Get(vtkDataObject::DATA_OBJECT()));
 
-  if (this->GetMTime() > this->LastExecuteTime)
+  if (this->GetMTime() > this->LastExecuteTime ||
+      input->GetData()->GetMeshRevision() != this->LastMeshRevision)
     {
     this->LastExecuteTime = this->GetMTime();
+    this->LastMeshRevision = input->GetData()->GetMeshRevision();
     Filter->SetPlane(this->Origin[0],this->Origin[1],this->Origin[2],
                      this->Normal[0],this->Normal[1],this->Normal[2]);
     Filter->SetSpacing(this->Spacing);
     Filter->SetNumberOfPlanes(this->NumberOfPlanes);
+    Filter->SetResolutionLevel(this->ResolutionLevel);
     Filter->operator()(input->GetData(),output->GetData());
     }
   output->SetColorPalette(this->ColorPalette,this->ColorRange);
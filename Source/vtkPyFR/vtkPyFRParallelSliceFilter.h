@@ -31,6 +31,9 @@ public:
   vtkSetMacro(NumberOfPlanes,int);
   vtkGetMacro(NumberOfPlanes,int);
 
+  vtkSetMacro(ResolutionLevel,int);
+  vtkGetMacro(ResolutionLevel,int);
+
   vtkSetMacro(MappedField,int);
   vtkGetMacro(MappedField,int);
 
@@ -48,11 +51,13 @@ protected:
   double Normal[3];
   double Spacing;
   int NumberOfPlanes;
+  int ResolutionLevel;
   int MappedField;
   int ColorPalette;
   double ColorRange[2];
 
   unsigned long LastExecuteTime;
+  unsigned long LastMeshRevision;
 
   PyFRParallelSliceFilter* Filter;
 
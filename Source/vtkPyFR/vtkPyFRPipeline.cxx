@@ -58,8 +58,10 @@
 #define STRINGIFY(s) TOSTRING(s)
 #define TOSTRING(s) #s
 
-#ifdef SINGLE
+#if defined(SINGLE)
 PV_PLUGIN_IMPORT_INIT(pyfr_plugin_fp32)
+#elif defined(MIXED)
+PV_PLUGIN_IMPORT_INIT(pyfr_plugin_mixed)
 #else
 PV_PLUGIN_IMPORT_INIT(pyfr_plugin_fp64)
 #endif
@@ -89,10 +91,28 @@ void vtkUpdateFilter(vtkSMSourceProxy* filter, double time)
   filter->UpdatePipeline(time);
 }
 
+// Only the contour filter applies a deferred clip plane, so the clip is
+// deferred while the contour filter is the sole consumer of its output. Any
+// other consumer (a live client's extract or representation, or a slice or
+// writer fed from the clip) gets the clipped cells.
+void vtkUpdateClipDeferral(vtkSMSourceProxy* clip, vtkSMProxy* contour)
+{
+  int deferred = 1;
+  for (unsigned int i=0;i<clip->GetNumberOfConsumers();i++)
+    if (clip->GetConsumerProxy(i) != contour)
+      deferred = 0;
+
+  if (vtkSMPropertyHelper(clip,"Deferred").GetAsInt() != deferred)
+    {
+    vtkSMPropertyHelper(clip,"Deferred").Set(deferred);
+    clip->UpdateVTKObjects();
+    }
+}
+
 vtkStandardNewMacro(vtkPyFRPipeline);
 
 //----------------------------------------------------------------------------
-vtkPyFRPipeline::vtkPyFRPipeline() : InsituLink(NULL)
+vtkPyFRPipeline::vtkPyFRPipeline() : InsituLink(NULL), Data(NULL)
 {
 }
 
@@ -112,8 +132,10 @@ void vtkPyFRPipeline::Initialize(char* hostName, int port, char* fileName,
   vtkSMProxyManager* proxyManager = vtkSMProxyManager::GetProxyManager();
 
   // Load PyFR plugin
-#ifdef SINGLE
+#if defined(SINGLE)
 PV_PLUGIN_IMPORT(pyfr_plugin_fp32)
+#elif defined(MIXED)
+PV_PLUGIN_IMPORT(pyfr_plugin_mixed)
 #else
 PV_PLUGIN_IMPORT(pyfr_plugin_fp64)
 #endif
@@ -154,6 +176,7 @@ PV_PLUGIN_IMPORT(pyfr_plugin_fp64)
   vtkPVTrivialProducer* realProducer =
     vtkPVTrivialProducer::SafeDownCast(clientSideObject);
   realProducer->SetOutput(pyfrData);
+  this->Data = pyfrData;
   controller->InitializeProxy(producer);
   controller->RegisterPipelineProxy(producer,"Source");
 
@@ -257,6 +280,7 @@ PV_PLUGIN_IMPORT(pyfr_plugin_fp64)
   this->Contour->UpdateVTKObjects();
   controller->PostInitializeProxy(this->Contour);
   controller->RegisterPipelineProxy(this->Contour,"Contour");
+  vtkUpdateClipDeferral(this->Clip,this->Contour);
 
   // Create a view
   vtkSmartPointer<vtkSMViewProxy> polydataViewer;
@@ -381,11 +405,90 @@ int vtkPyFRPipeline::RequestDataDescription(
     return 0;
     }
 
-  dataDescription->GetInputDescriptionByName("input")->AllFieldsOn();
-  dataDescription->GetInputDescriptionByName("input")->GenerateMeshOn();
+  vtkCPInputDataDescription* input =
+    dataDescription->GetInputDescriptionByName("input");
+  input->GenerateMeshOn();
+
+  // Request only the fields that the consumers of the source read, or all of
+  // them if some consumer may read any field
+  vtkSMSessionProxyManager* sessionProxyManager =
+    vtkSMProxyManager::GetProxyManager()->GetActiveSessionProxyManager();
+  vtkSMSourceProxy* source =
+    vtkSMSourceProxy::SafeDownCast(sessionProxyManager->GetProxy("Source"));
+  std::vector<int> fields;
+  if (!source || !this->AddConsumedFields(source,fields))
+    {
+    input->AllFieldsOn();
+    return 1;
+    }
+
+  PyFRData* data = this->Data->GetData();
+  for (unsigned i=0;i<fields.size();i++)
+    if (fields[i] >= 0 &&
+        static_cast<unsigned>(fields[i]) < data->GetNumberOfFields() &&
+        !input->IsFieldNeeded(data->GetFieldName(fields[i]).c_str()))
+      input->AddField(data->GetFieldName(fields[i]).c_str());
   return 1;
 }
 
+//----------------------------------------------------------------------------
+bool vtkPyFRPipeline::AddConsumedFields(vtkSMProxy* proxy,
+                                        std::vector<int>& fields)
+{
+  for (unsigned int i=0;i<proxy->GetNumberOfConsumers();i++)
+    {
+    vtkSMProxy* consumer = proxy->GetConsumerProxy(i);
+    if (consumer == this->Contour)
+      {
+      fields.push_back(
+        vtkSMPropertyHelper(this->Contour,"ContourField").GetAsInt());
+      fields.push_back(
+        vtkSMPropertyHelper(this->Contour,"ColorField").GetAsInt());
+      vtkSMPropertyHelper mappedFields(this->Contour,"MappedFields");
+      for (unsigned int j=0;j<mappedFields.GetNumberOfElements();j++)
+        fields.push_back(mappedFields.GetAsInt(j));
+      }
+    else if (consumer == this->Slice)
+      fields.push_back(
+        vtkSMPropertyHelper(this->Slice,"ColorField").GetAsInt());
+    else if (consumer == this->Clip)
+      {
+      if (!this->AddConsumedFields(this->Clip,fields))
+        return false;
+      }
+    else
+      return false;
+    }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+void vtkPyFRPipeline::BindConsumedFields()
+{
+  PyFRData* data = this->Data->GetData();
+  if (data->GetAllFieldsRequested())
+    return;
+
+  vtkSMSessionProxyManager* sessionProxyManager =
+    vtkSMProxyManager::GetProxyManager()->GetActiveSessionProxyManager();
+  vtkSMProxy* source = sessionProxyManager->GetProxy("Source");
+  std::vector<int> fields;
+  bool bound = this->AddConsumedFields(source,fields);
+  for (unsigned i=0;bound && i<fields.size();i++)
+    if (fields[i] >= 0 &&
+        static_cast<unsigned>(fields[i]) < data->GetNumberOfFields() &&
+        !data->IsFieldRequested(fields[i]))
+      bound = false;
+  if (bound)
+    return;
+
+  // The next step requests the new consumers' fields through
+  // RequestDataDescription
+  data->RequestAllFields();
+  data->Update();
+  this->Data->Modified();
+}
+
 //----------------------------------------------------------------------------
 int vtkPyFRPipeline::CoProcess(vtkCPDataDescription* dataDescription)
 {
@@ -458,6 +561,8 @@ int vtkPyFRPipeline::CoProcess(vtkCPDataDescription* dataDescription)
     {
     this->InsituLink->InsituUpdate(dataDescription->GetTime(),
                                    dataDescription->GetTimeStep());
+    vtkUpdateClipDeferral(this->Clip,this->Contour);
+    this->BindConsumedFields();
 
     vtkUpdateFilter(this->Contour, dataDescription->GetTime());
     vtkUpdateFilter(this->Slice, dataDescription->GetTime());
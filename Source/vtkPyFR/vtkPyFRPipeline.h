@@ -4,11 +4,14 @@
 #include <vtkCPPipeline.h>
 #include <vtkSmartPointer.h>
 #include <string>
+#include <vector>
 
 class vtkCPDataDescription;
 class vtkLiveInsituLink;
 class vtkPyFRContourData;
+class vtkPyFRData;
 class vtkPyFRMapper;
+class vtkSMProxy;
 class vtkSMSourceProxy;
 class vtkSMPVRepresentationProxy;
 class vtkTextActor;
@@ -38,10 +41,24 @@ private:
   vtkPyFRPipeline(const vtkPyFRPipeline&); // Not implemented
   void operator=(const vtkPyFRPipeline&); // Not implemented
 
+  // Add the fields that the consumers of a proxy read, walking through the
+  // clip (which only reads the coordinates). Returns false if a consumer
+  // that may read any field, e.g. a writer or a live client's extract, is
+  // found.
+  bool AddConsumedFields(vtkSMProxy* proxy, std::vector<int>& fields);
+
+  // Rebind all fields if a consumer attached since the fields were requested
+  // (by a live client, mid-step) reads a field that is not bound
+  void BindConsumedFields();
+
   vtkLiveInsituLink* InsituLink;
 
   std::string FileName;
 
+  // The adaptor's data object, whose field registry names the fields that
+  // the filters request
+  vtkPyFRData* Data;
+
   vtkSmartPointer<vtkSMSourceProxy> Clip;
   vtkSmartPointer<vtkSMSourceProxy> Contour;
   vtkSmartPointer<vtkSMSourceProxy> Slice;